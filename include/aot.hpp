@@ -0,0 +1,136 @@
+//------------------------------------//
+// Copyright 2024 Nam Nguyen
+// Licensed under Apache License v2.0
+//------------------------------------//
+
+#ifndef AOT_HPP
+#define AOT_HPP
+
+#pragma once
+#include <map>
+#include <memory>
+#include <set>
+#include <sstream>
+#include <string>
+#include <vector>
+
+#include "expr.hpp"
+#include "stmt.hpp"
+#include "runtime.hpp"
+
+// translates a resolved program into C++ that links against the runtime in bin/libnimble.a,
+// locals nothing closes over become C++ locals and calls to global functions become C++ calls
+class AotCompiler
+{
+    private:
+        // what a scope of the resolver is, methods get their "this" and "super" scopes to themselves
+        enum Role { BODY, THIS, SUPER };
+
+        struct Scope
+        {
+            int id;
+            const void* frame; // the function or module it belongs to
+            std::vector<std::string> names;
+            std::vector<bool> captured; // read or written by a nested function, lives in an Environment
+
+            bool has_environment() const;
+        };
+
+        // the C++ function being generated
+        struct Frame
+        {
+            const void* key;
+            size_t base; // first scope on the stack that belongs to it
+            bool is_function = false;
+            bool is_initializer = false;
+            int loops = 0;
+            std::string label; // where a break outside of any loop goes at the top level
+            bool label_used = false;
+            std::string name; // of the C++ function
+            std::vector<std::string> parameters;
+            bool restartable = false; // a tail call to itself can assign the parameters and jump back to the start
+            bool restarts = false;
+        };
+
+        struct Operand
+        {
+            std::string code;
+            bool place = false; // names a variable, something evaluated later could change it
+        };
+
+        struct Module
+        {
+            std::vector<std::shared_ptr<Stmt>> statements;
+            std::string name;
+            bool analyzed = false;
+            bool compiled = false;
+        };
+
+        Runtime natives; // only asked which globals are natives
+        std::map<std::pair<const void*, int>, Scope> scopes;
+        std::vector<Scope*> stack;
+        const void* frame_key = nullptr; // frame being analyzed
+        Frame* frame = nullptr; // frame being generated
+
+        std::map<std::string, Module> modules;
+        std::set<std::string> globals;
+        std::map<std::string, int> definitions; // how often each global is assigned, a fun counts once
+        std::map<std::string, FunctionExpr*> global_functions;
+        std::map<FunctionExpr*, std::string> functions; // C++ name of every function named so far
+        std::set<FunctionExpr*> generated;
+        std::map<std::string, std::string> names; // property names
+        std::vector<std::string> constants;
+
+        std::ostringstream prototypes;
+        std::ostringstream definitions_out;
+        std::ostringstream* out = nullptr;
+        int indent = 0;
+        int counter = 0;
+
+        Module* module(const std::string& path);
+        Scope& enter(const void* node, Role role, int slot_count);
+        bool is_native(const std::string& name);
+
+        void analyze(const std::vector<std::shared_ptr<Stmt>>& statements);
+        void analyze(Stmt* stmt);
+        void analyze(Expr* expr);
+        void analyze_function(FunctionExpr* fn, bool is_method, bool has_super);
+        void reference(const Binding& binding, const std::string& name);
+        void declare(int slot, const std::string& name);
+
+        void line(const std::string& text);
+        std::string temp(const std::string& init);
+        Operand stable(Operand operand);
+        std::string constant(const std::string& text);
+        std::string name_of(const std::string& property);
+        std::string environment(Scope* scope);
+        std::string local(Scope* scope, int slot);
+        std::string storage(Scope* scope, int slot);
+        std::string closure();
+        void open(Scope& scope, const std::string& enclosing, int first_local);
+        std::string direct(CallExpr* expr);
+        bool restart(CallExpr* expr);
+
+        void emit_frame(const std::string& name, const void* key, const std::vector<std::shared_ptr<Stmt>>& statements);
+        std::string emit_function(FunctionExpr* fn, const std::string& name, bool is_method, bool has_super, bool is_initializer);
+        void emit(Stmt* stmt);
+        void emit_branch(Stmt* stmt);
+        void emit_class(ClassStmt* stmt);
+        void define(int slot, const std::string& name, const std::string& value);
+        Operand expression(Expr* expr);
+        Operand variable(const Binding& binding, const Token& name);
+        Operand binary(BinaryExpr* expr);
+        Operand call(CallExpr* expr);
+        std::vector<Operand> arguments(const std::vector<std::shared_ptr<Expr>>& expressions);
+        std::string pass(const std::vector<Operand>& operands);
+
+    public:
+        size_t max_stack = 1000000; // --max-stack, the compiled program stops at the same call depth as the interpreter
+
+        // lexes, parses and resolves a file the way run_file does, empty if it had errors
+        static std::vector<std::shared_ptr<Stmt>> parse(const std::string& path);
+
+        std::string compile(const std::vector<std::shared_ptr<Stmt>>& statements);
+};
+
+#endif
@@ -0,0 +1,67 @@
+//------------------------------------//
+// Copyright 2024 Nam Nguyen
+// Licensed under Apache License v2.0
+//------------------------------------//
+
+#ifndef ASSEMBLER_HPP
+#define ASSEMBLER_HPP
+
+#pragma once
+#include <cstdint>
+#include <cstring>
+#include <initializer_list>
+#include <vector>
+
+#include "jit.hpp"
+
+// machine code is only generated for x86-64 System V
+#if defined(__x86_64__) && (defined(__linux__) || defined(__APPLE__))
+#define NBL_JIT 1
+#endif
+
+// byte buffer the JIT and the trace compiler emit x86-64 into
+class Assembler
+{
+    protected:
+        std::vector<uint8_t> code;
+
+        void emit(std::initializer_list<uint8_t> bytes) { code.insert(code.end(), bytes); }
+        void emit32(int32_t value) { emit_raw(&value, 4); }
+        void emit64(uint64_t value) { emit_raw(&value, 8); }
+        void emit_raw(const void* data, size_t size)
+        {
+            const uint8_t* bytes = static_cast<const uint8_t*>(data);
+            code.insert(code.end(), bytes, bytes + size);
+        }
+
+        // rel32 jumps are emitted with a zero offset and patched once the target is known
+        size_t jump(std::initializer_list<uint8_t> opcode)
+        {
+            emit(opcode);
+            emit32(0);
+            return code.size() - 4;
+        }
+
+        void patch(size_t at, size_t target)
+        {
+            int32_t offset = static_cast<int32_t>(target - (at + 4));
+            std::memcpy(&code[at], &offset, 4);
+        }
+
+        void patch_all(const std::vector<size_t>& jumps, size_t target)
+        {
+            for (size_t at : jumps)
+                patch(at, target);
+        }
+
+        void call_absolute(const void* target)
+        {
+            emit({0x48, 0xB8}); emit64(reinterpret_cast<uint64_t>(target)); // mov rax, imm64
+            emit({0xFF, 0xD0}); // call rax
+        }
+
+        // copies the code into an executable mapping owned by result
+        bool install(JitCode& result);
+};
+
+#endif
@@ -13,58 +13,82 @@
 #include <ctime>
 #include <cstring>
 #include <cmath>
+#include <span>
 
 #include "list.hpp"
+#include "number.hpp"
 #include "callable.hpp"
+#include "error.hpp"
 
-class NativeClock : public NblCallable
+// a builtin function, adding one to the table in builtins.cpp makes it a global on every engine
+struct NativeDef
 {
-    public:
-        int arity() override;
-        std::any call(Interpreter& interpreter, std::vector<std::any> args) override;
-        std::string to_string() override;
+    const char* name;
+    int min_arity;
+    int max_arity;
+    Value (*function)(Interpreter& interpreter, const Token& paren, std::span<Value> arguments);
+    Intrinsic intrinsic = Intrinsic::NONE; // when calls to it can run inline
 };
 
-class NativeTime : public NblCallable
+std::span<const NativeDef> natives();
+
+// the builtin a call to the global name with that many arguments runs inline, NONE for anything else
+Intrinsic find_intrinsic(const std::string& name, size_t argument_count);
+
+class NblNative final : public NblCallable
 {
+    private:
+        const NativeDef& def;
+
     public:
+        NblNative(const NativeDef& def) : NblCallable(ObjectType::NATIVE), def(def) {}
+        Intrinsic intrinsic() const { return def.intrinsic; }
         int arity() override;
-        std::any call(Interpreter& interpreter, std::vector<std::any> args) override;
+        int max_arity() override;
+        Value call(Interpreter& interpreter, const Token& paren, std::span<Value> arguments) override;
         std::string to_string() override;
 };
 
-class NativeInput : public NblCallable
+// builtins with an intrinsic, their natives call these too so both give the same result
+
+inline Value builtin_clock()
 {
-    public:
-        int arity() override;
-        std::any call(Interpreter& interpreter, std::vector<std::any> args) override;
-        std::string to_string() override;
-};
+    auto ticks = std::chrono::system_clock::now().time_since_epoch();
+    return std::chrono::duration<double>{ticks}.count() / 100.0;
+}
 
-class NativeExit : public NblCallable
+inline Value builtin_floordiv(const Token& paren, const Value& left, const Value& right)
 {
-    public:
-        int param_count;
-        
-        int arity() override;
-        std::any call(Interpreter& interpreter, std::vector<std::any> args) override;
-        std::string to_string() override;
-};
+    if (!left.is_number() || !right.is_number())
+        throw RuntimeError(paren, "Arguments to floordiv must be numbers");
+
+    return num_floordiv(left, right);
+}
 
-class NativeFloorDiv : public NblCallable
+inline Value builtin_len(const Token& paren, const Value& list)
 {
-    public:
-        int arity() override;
-        std::any call(Interpreter& interpreter, std::vector<std::any> args) override;
-        std::string to_string() override;
-};
+    if (!list.is_object(ObjectType::LIST))
+        throw RuntimeError(paren, "Argument to len must be a list");
+
+    return Value::integer(list.as<ListType>()->get_length());
+}
 
-class NativeArrayLen : public NblCallable
+// whether callee is still the builtin intrinsic stands for, its global may have been redefined
+inline bool is_intrinsic(const Value& callee, Intrinsic intrinsic)
 {
-    public:
-        int arity() override;
-        std::any call(Interpreter& interpreter, std::vector<std::any> args) override;
-        std::string to_string() override;
-};
+    return callee.is_object(ObjectType::NATIVE) && callee.as<NblNative>()->intrinsic() == intrinsic;
+}
+
+// arguments has as many values as find_intrinsic() was asked about, bad ones are reported at paren
+inline Value run_intrinsic(Intrinsic intrinsic, const Token& paren, std::span<Value> arguments)
+{
+    switch (intrinsic)
+    {
+        case Intrinsic::CLOCK: return builtin_clock();
+        case Intrinsic::FLOORDIV: return builtin_floordiv(paren, arguments[0], arguments[1]);
+        case Intrinsic::LEN: return builtin_len(paren, arguments[0]);
+        default: return {};
+    }
+}
 
 #endif
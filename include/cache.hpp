@@ -0,0 +1,78 @@
+//------------------------------------//
+// Copyright 2024 Nam Nguyen
+// Licensed under Apache License v2.0
+//------------------------------------//
+
+#ifndef CACHE_HPP
+#define CACHE_HPP
+
+#pragma once
+#include <cstddef>
+#include <cstdint>
+
+#include "symbol.hpp"
+
+class Shape;
+class NblFunction;
+
+// what looking up a name on instances of one shape found. Shapes never change and neither do
+// the methods of a class, so the answer stays right for as long as the shape is the same
+struct CacheEntry
+{
+    uint32_t shape = 0; // Shape::id, 0 for an unused entry
+    Symbol name = 0;
+    int slot = -1; // the field's slot, -1 for a method
+    NblFunction* method = nullptr;
+    Shape* next = nullptr; // for an assignment that adds the field, the shape it moves the instance to
+};
+
+// remembers the last few shapes a property access or method call saw. A site that sees more than
+// that is megamorphic and goes through a table shared by all of them instead
+struct InlineCache
+{
+    static constexpr int SIZE = 4;
+
+    CacheEntry entries[SIZE];
+    bool megamorphic = false;
+    const bool store; // an assignment, the entry for a missing field adds it instead of finding a method
+
+    explicit InlineCache(bool store = false) : store(store) {}
+
+    // the entry for instances of shape, null on a miss
+    CacheEntry* find(uint32_t shape, Symbol name)
+    {
+        if (megamorphic)
+            return find_global(shape, name);
+
+        for (CacheEntry& entry : entries)
+        {
+            if (entry.shape == shape)
+            {
+                stats.hits++;
+                return &entry;
+            }
+        }
+
+        stats.misses++;
+        return nullptr;
+    }
+
+    CacheEntry* add(const CacheEntry& entry);
+
+    // counted over every site, --cache-stats prints them when the program ends
+    struct Stats
+    {
+        size_t hits = 0;
+        size_t misses = 0;
+        size_t global_hits = 0;
+        size_t global_misses = 0;
+    };
+
+    static Stats stats;
+    static void print_stats();
+
+    private:
+        CacheEntry* find_global(uint32_t shape, Symbol name);
+};
+
+#endif
@@ -7,19 +7,39 @@
 #define CALLABLE_HPP
 
 #pragma once
-#include <vector>
-#include <any>
+#include <span>
 #include <string>
 
+#include "value.hpp"
+#include "token.hpp"
+
 class Interpreter;
 
-class NblCallable
+class NblCallable : public Object
 {
     public:
-        virtual ~NblCallable() = default;
+        NblCallable(ObjectType type) : Object(type) {}
         virtual int arity() = 0;
-        virtual std::any call(Interpreter& interpreter, std::vector<std::any> arguments) = 0;
+        // natives may take a range of arguments starting at arity()
+        virtual int max_arity() { return arity(); }
+        // the arguments are usually on the caller's frame stack, call may move them out,
+        // errors in the call itself are reported at paren
+        virtual Value call(Interpreter& interpreter, const Token& paren, std::span<Value> arguments) = 0;
         virtual std::string to_string() = 0;
+
+        bool accepts(size_t count)
+        {
+            size_t min = arity();
+            return count == min || (count > min && count <= static_cast<size_t>(max_arity()));
+        }
+
+        std::string arity_error(size_t count)
+        {
+            int min = arity();
+            int max = max_arity();
+            std::string expected = min == max ? std::to_string(min) : std::to_string(min) + " to " + std::to_string(max);
+            return "Expected " + expected + " arguments but got " + std::to_string(count);
+        }
 };
 
 #endif
@@ -0,0 +1,50 @@
+//------------------------------------//
+// Copyright 2024 Nam Nguyen
+// Licensed under Apache License v2.0
+//------------------------------------//
+
+#ifndef CHUNK_HPP
+#define CHUNK_HPP
+
+#pragma once
+#include <vector>
+#include <cstdint>
+
+#include "value.hpp"
+
+enum OpCode : uint8_t
+{
+    // constants and literals
+    OP_CONSTANT, OP_NIL, OP_TRUE, OP_FALSE, OP_POP,
+
+    // variables
+    OP_GET_LOCAL, OP_SET_LOCAL,
+    OP_GET_GLOBAL, OP_DEFINE_GLOBAL, OP_SET_GLOBAL,
+    OP_GET_UPVALUE, OP_SET_UPVALUE,
+    OP_GET_PROPERTY, OP_SET_PROPERTY, OP_GET_SUPER,
+    OP_GET_SUBSCRIPT, OP_SET_SUBSCRIPT,
+
+    // operators
+    OP_EQUAL, OP_NOT_EQUAL,
+    OP_GREATER, OP_GREATER_EQUAL, OP_LESS, OP_LESS_EQUAL,
+    OP_ADD, OP_SUBTRACT, OP_MULTIPLY, OP_DIVIDE, OP_MODULO, OP_POWER, OP_SQUARE,
+    OP_NOT, OP_NEGATE,
+
+    // statements and control flow
+    OP_PRINT, OP_JUMP, OP_JUMP_IF_FALSE, OP_LOOP,
+    OP_CALL, OP_TAIL_CALL, OP_INVOKE, OP_INTRINSIC, OP_CLOSURE, OP_CLOSE_UPVALUE, OP_RETURN,
+    OP_CLASS, OP_INHERIT, OP_METHOD,
+    OP_LIST, OP_IMPORT
+};
+
+struct Chunk
+{
+    std::vector<uint8_t> code;
+    std::vector<int> lines; // source line of every byte in code
+    std::vector<Value> constants;
+
+    void write(uint8_t byte, int line);
+    int add_constant(Value value);
+};
+
+#endif
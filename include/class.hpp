@@ -7,34 +7,47 @@
 #define CLASS_HPP
 
 #pragma once
-#include <any>
 #include <memory>
 #include <string>
 #include <vector>
 #include <utility>
 #include <map>
+#include <unordered_map>
 
 #include "callable.hpp"
 #include "instance.hpp"
 #include "function.hpp"
+#include "symbol.hpp"
+#include "shape.hpp"
 
 class Interpreter;
 class NblFunction;
 
-class NblClass : public NblCallable, public std::enable_shared_from_this<NblClass>
+class NblClass : public NblCallable
 {
     friend class NblInstance;
     
     private:
         std::string name;
-        std::shared_ptr<NblClass> superclass;
-        std::map<std::string, std::shared_ptr<NblFunction>> methods;
+        Ref<NblClass> superclass;
+        // its own methods and every inherited one, copied down when the class is created
+        std::unordered_map<Symbol, Ref<NblFunction>> methods;
+        NblFunction* initializer = nullptr;
+        int initializer_arity = 0;
+        Shape shape; // of a new instance, the root of the class's shape tree
+        size_t field_count = 0; // the most fields an instance got so far, new ones make room for that many
 
     public:
-        NblClass(std::string name, std::shared_ptr<NblClass> superclass, std::map<std::string, std::shared_ptr<NblFunction>> methods);
-        std::shared_ptr<NblFunction> find_method(const std::string& name);
+        NblClass(std::string name, Ref<NblClass> superclass, const std::map<std::string, Ref<NblFunction>>& own_methods);
+
+        NblFunction* find_method(Symbol name)
+        {
+            auto element = methods.find(name);
+            return element != methods.end() ? element->second.get() : nullptr;
+        }
+
         int arity() override;
-        std::any call(Interpreter& interpreter, std::vector<std::any> arguments) override;
+        Value call(Interpreter& interpreter, const Token& paren, std::span<Value> arguments) override;
         std::string to_string() override;
 };
 
@@ -0,0 +1,64 @@
+//------------------------------------//
+// Copyright 2024 Nam Nguyen
+// Licensed under Apache License v2.0
+//------------------------------------//
+
+#ifndef CLOSURE_HPP
+#define CLOSURE_HPP
+
+#pragma once
+#include <functional>
+#include <memory>
+#include <vector>
+
+#include "expr.hpp"
+#include "stmt.hpp"
+#include "token.hpp"
+#include "value.hpp"
+
+class Interpreter;
+
+// a compiled node, it already knows its children and the shape of its operands
+using ExprFn = std::function<Value()>;
+using StmtFn = std::function<ExecResult()>;
+
+// turns a resolved AST into a tree of closures that run against the interpreter's state
+class ClosureCompiler
+{
+    private:
+        Interpreter& interpreter;
+
+        StmtFn compile(Stmt* stmt);
+        StmtFn compile_sequence(const std::vector<std::shared_ptr<Stmt>>& statements);
+        std::shared_ptr<StmtFn> compile_body(FunctionExpr* fn);
+        StmtFn compile_mut(MutStmt* stmt);
+        StmtFn compile_if(IfStmt* stmt);
+        StmtFn compile_while(WhileStmt* stmt);
+        StmtFn compile_function(FunctionStmt* stmt);
+        StmtFn compile_return(ReturnStmt* stmt);
+        StmtFn compile_class(ClassStmt* stmt);
+
+        ExprFn compile_variable(const Token& name, const Binding& binding);
+        ExprFn compile_assign(AssignExpr* expr);
+        ExprFn compile_binary(BinaryExpr* expr);
+        ExprFn compile_square(BinaryExpr* expr);
+        ExprFn compile_unary(UnaryExpr* expr);
+        ExprFn compile_logical(LogicalExpr* expr);
+        ExprFn compile_call(CallExpr* expr);
+        ExprFn compile_invoke(CallExpr* expr);
+        ExprFn compile_intrinsic(CallExpr* expr, const ExprFn& callee_fn, const std::vector<ExprFn>& argument_fns);
+        ExprFn compile_get(GetExpr* expr);
+        ExprFn compile_set(SetExpr* expr);
+        ExprFn compile_list(ListExpr* expr);
+        ExprFn delegate(Expr* expr);
+
+        template<typename Op>
+        ExprFn compile_numbers(BinaryExpr* expr, Op op);
+
+    public:
+        ClosureCompiler(Interpreter& interpreter);
+        StmtFn compile(const std::vector<std::shared_ptr<Stmt>>& statements);
+        ExprFn compile(Expr* expr);
+};
+
+#endif
@@ -0,0 +1,122 @@
+//------------------------------------//
+// Copyright 2024 Nam Nguyen
+// Licensed under Apache License v2.0
+//------------------------------------//
+
+#ifndef COMPILER_HPP
+#define COMPILER_HPP
+
+#pragma once
+#include <memory>
+#include <string>
+#include <vector>
+
+#include "chunk.hpp"
+#include "expr.hpp"
+#include "stmt.hpp"
+#include "error.hpp"
+#include "resolver.hpp"
+#include "vm.hpp"
+
+struct Local
+{
+    std::string name;
+    int depth;
+    bool is_captured = false;
+};
+
+struct UpvalueRef
+{
+    uint8_t index;
+    bool is_local;
+};
+
+struct LoopState
+{
+    int scope_depth;
+    std::vector<int> break_jumps;
+};
+
+// per function compilation state, chained to the function being compiled around it
+struct FunctionState
+{
+    FunctionState* enclosing;
+    Ref<VmFunction> function;
+    FunctionType type;
+    std::vector<Local> locals;
+    std::vector<UpvalueRef> upvalues;
+    std::vector<LoopState> loops;
+    int scope_depth = 0;
+};
+
+class Compiler : public ExprVisitor, public StmtVisitor
+{
+    private:
+        FunctionState* current = nullptr;
+        int line = 0; // line of the last token seen, used for nodes without tokens
+
+        Chunk& chunk();
+        void emit(uint8_t byte);
+        void emit(uint8_t op, uint8_t operand);
+        void emit_short(uint8_t op, int operand);
+        int emit_jump(uint8_t op);
+        void patch_jump(int offset);
+        void emit_loop(int loop_start);
+        void emit_return();
+        int make_constant(Value value);
+        int identifier_constant(const std::string& name);
+        int global_operand(const std::string& name);
+
+        void compile(std::shared_ptr<Stmt> stmt);
+        void compile(const std::vector<std::shared_ptr<Stmt>>& statements);
+        void compile(std::shared_ptr<Expr> expr);
+        void function(std::shared_ptr<FunctionExpr> fn, FunctionType type, const std::string& name);
+        bool invoke(CallExpr* call);
+        void begin_function(FunctionState& state, FunctionType type, const std::string& name);
+        Ref<VmFunction> end_function();
+        void begin_scope();
+        void end_scope();
+
+        void add_local(const std::string& name);
+        void declare_variable(const Token& name);
+        void define_variable(const Token& name);
+        int resolve_local(FunctionState* state, const std::string& name);
+        int resolve_upvalue(FunctionState* state, const std::string& name);
+        int add_upvalue(FunctionState* state, uint8_t index, bool is_local);
+        void named_variable(const Token& name);
+        void assign_variable(const Token& name);
+
+    public:
+        Ref<VmFunction> compile_script(const std::vector<std::shared_ptr<Stmt>>& statements);
+        Ref<VmFunction> compile_expression(std::shared_ptr<Expr> expr);
+
+        Value visitAssignExpr(std::shared_ptr<AssignExpr> expr) override;
+        Value visitBinaryExpr(std::shared_ptr<BinaryExpr> expr) override;
+        Value visitGroupingExpr(std::shared_ptr<GroupingExpr> expr) override;
+        Value visitLiteralExpr(std::shared_ptr<LiteralExpr> expr) override;
+        Value visitUnaryExpr(std::shared_ptr<UnaryExpr> expr) override;
+        Value visitMutExpr(std::shared_ptr<MutExpr> expr) override;
+        Value visitLogicalExpr(std::shared_ptr<LogicalExpr> expr) override;
+        Value visitCallExpr(std::shared_ptr<CallExpr> expr) override;
+        Value visitFunctionExpr(std::shared_ptr<FunctionExpr> expr) override;
+        Value visitGetExpr(std::shared_ptr<GetExpr> expr) override;
+        Value visitSetExpr(std::shared_ptr<SetExpr> expr) override;
+        Value visitThisExpr(std::shared_ptr<ThisExpr> expr) override;
+        Value visitSuperExpr(std::shared_ptr<SuperExpr> expr) override;
+        Value visitListExpr(std::shared_ptr<ListExpr> expr) override;
+        Value visitSubscriptExpr(std::shared_ptr<SubscriptExpr> expr) override;
+
+        Value visitBlockStmt(std::shared_ptr<BlockStmt> stmt) override;
+        Value visitExpressionStmt(std::shared_ptr<ExpressionStmt> stmt) override;
+        Value visitPrintStmt(std::shared_ptr<PrintStmt> stmt) override;
+        Value visitMutStmt(std::shared_ptr<MutStmt> stmt) override;
+        Value visitIfStmt(std::shared_ptr<IfStmt> stmt) override;
+        Value visitWhileStmt(std::shared_ptr<WhileStmt> stmt) override;
+        Value visitFunctionStmt(std::shared_ptr<FunctionStmt> stmt) override;
+        Value visitReturnStmt(std::shared_ptr<ReturnStmt> stmt) override;
+        Value visitBreakStmt(std::shared_ptr<BreakStmt> stmt) override;
+        Value visitClassStmt(std::shared_ptr<ClassStmt> stmt) override;
+        Value visitImportStmt(std::shared_ptr<ImportStmt> stmt) override;
+};
+
+#endif
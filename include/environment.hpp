@@ -8,32 +8,73 @@
 
 #pragma once
 #include <memory>
-#include <any>
 #include <string>
-#include <map>
+#include <vector>
 #include <functional>
 #include <utility>
 
 #include "error.hpp"
 #include "token.hpp"
+#include "value.hpp"
 
-class Environment : public std::enable_shared_from_this<Environment>
+// a local captured by a nested function, its slot holds the cell and every function
+// that closes over it holds the same one
+struct Cell : Object
+{
+    Value value;
+
+    Cell() : Object(ObjectType::CELL) {}
+};
+
+class Environment
 {
     friend class Interpreter;
+    friend class ClosureCompiler;
+    friend class JitEmitter;
+    friend class LoopTrace;
+    friend class TraceRecorder;
+    friend class Runtime;
 
-    std::shared_ptr<Environment> enclosing;
-    std::map<std::string, std::any> values;
+    Environment* enclosing;
+    std::shared_ptr<Environment> owner; // keeps the enclosing environment of a heap environment alive
+    std::vector<std::unique_ptr<Value>> globals; // indexed by global slot, null until defined. Each in a box of its own,
+                                                 // so defining one never moves the others, compiled code points at them
+    Value* slots = nullptr; // locals, indexed by the slot the resolver gave them
+    std::vector<Value> storage; // holds the slots unless they're on the interpreter's frame stack
 
     public:
         Environment();
-        Environment(std::shared_ptr<Environment> enclosing);
-
-        std::any get(const Token& name);
-        void assign(const Token& name, std::any value);
-        void define(const std::string& name, std::any value);
-        std::shared_ptr<Environment> ancestor(int distance);
-        std::any get_at(int distance, const std::string& name);
-        void assign_at(int distance, const Token& name, std::any value);
+        Environment(std::shared_ptr<Environment> enclosing, int slot_count);
+        Environment(Environment* enclosing, Value* slots, int slot_count, const std::vector<int>& cells = {});
+        Environment(const Environment&) = delete;
+        Environment& operator=(const Environment&) = delete;
+
+        // null when the global isn't defined
+        Value* global(int slot)
+        {
+            return slot < static_cast<int>(globals.size()) ? globals[slot].get() : nullptr;
+        }
+
+        Value get(int slot, const Token& name)
+        {
+            Value* found = global(slot);
+
+            if (found == nullptr)
+                undefined(name);
+
+            return *found;
+        }
+
+        void assign(int slot, const Token& name, Value value);
+        void define(const std::string& name, Value value);
+        [[noreturn]] static void undefined(const Token& name);
+        void define_slot(int slot, Value value);
+        Environment* ancestor(int distance);
+        Value get_at(int distance, int slot);
+        void assign_at(int distance, int slot, Value value);
+
+        // direct access for code compiled by --emit-c, which knows its slots statically
+        Value& slot(int index) { return slots[index]; }
 };
 
 #endif
@@ -9,12 +9,15 @@
 #pragma once
 #include <vector>
 #include <memory>
-#include <any>
 #include <utility>
 
 #include "token.hpp"
+#include "value.hpp"
+#include "symbol.hpp"
+#include "cache.hpp"
 
 struct Stmt;
+struct MutStmt;
 
 struct AssignExpr;
 struct BinaryExpr;
@@ -32,94 +35,215 @@ struct SuperExpr;
 struct ListExpr;
 struct SubscriptExpr;
 
+// where the resolver found a variable: depth scopes up, at slot
+struct Binding
+{
+    int depth = -1; // -1 for globals
+    int slot = 0; // the global's slot when depth is -1
+    int upvalue = -1; // declared outside of the current function, index into its upvalues
+    bool cell = false; // captured by a nested function, the slot holds the variable's Cell
+    bool receiver = false; // "this" inside its own method, the receiver the method was called with
+};
+
+// a variable a function closes over, fetched when the function is created
+struct Capture
+{
+    enum Kind
+    {
+        LOCAL, // a local of the enclosing function, depth scopes up from where this one is created
+        UPVALUE, // one of the enclosing function's upvalues
+        THIS // the receiver of the method it's created in
+    } kind;
+
+    int depth = 0;
+    int slot = 0;
+    int index = 0; // UPVALUE
+
+    bool operator==(const Capture& other) const
+    {
+        return kind == other.kind && depth == other.depth && slot == other.slot && index == other.index;
+    }
+};
+
+// node type tag, the interpreter switches on it instead of going through accept
+enum class ExprKind : uint8_t
+{
+    ASSIGN,
+    BINARY,
+    GROUPING,
+    LITERAL,
+    UNARY,
+    MUT,
+    LOGICAL,
+    CALL,
+    FUNCTION,
+    GET,
+    SET,
+    THIS,
+    SUPER,
+    LIST,
+    SUBSCRIPT,
+
+    // quickened variants, the interpreter rewrites a node's kind to one of these
+    // once it has seen the operand types, and back if the guard fails
+    ADD_NUMBERS, // BinaryExpr
+    SUBTRACT_NUMBERS,
+    MULTIPLY_NUMBERS,
+    DIVIDE_NUMBERS,
+    MODULO_NUMBERS,
+    LESS_NUMBERS,
+    LESS_EQUAL_NUMBERS,
+    GREATER_NUMBERS,
+    GREATER_EQUAL_NUMBERS,
+    EQUAL_NUMBERS,
+    NOT_EQUAL_NUMBERS,
+    LESS_LOCAL_NUMBERS, // BinaryExpr, local < number
+    INCREMENT_LOCAL, // AssignExpr, local += number literal
+    INCREMENT_GLOBAL, // AssignExpr, global += number literal
+    CALL_FUNCTION, // CallExpr on an NblFunction
+    CALL_INTRINSIC, // CallExpr on the builtin its intrinsic names
+
+    // set ahead of time by the optimizer, never undone
+    SQUARE // BinaryExpr, x ** 2
+};
+
+// builtins a call can run inline instead of through NblNative, see CallExpr::intrinsic
+enum class Intrinsic : uint8_t
+{
+    NONE,
+    CLOCK,
+    FLOORDIV,
+    LEN
+};
+
+// the kind a node was created with, for passes that don't care about quickening
+inline ExprKind generic_kind(ExprKind kind)
+{
+    switch (kind)
+    {
+        case ExprKind::ADD_NUMBERS:
+        case ExprKind::SUBTRACT_NUMBERS:
+        case ExprKind::MULTIPLY_NUMBERS:
+        case ExprKind::DIVIDE_NUMBERS:
+        case ExprKind::MODULO_NUMBERS:
+        case ExprKind::LESS_NUMBERS:
+        case ExprKind::LESS_EQUAL_NUMBERS:
+        case ExprKind::GREATER_NUMBERS:
+        case ExprKind::GREATER_EQUAL_NUMBERS:
+        case ExprKind::EQUAL_NUMBERS:
+        case ExprKind::NOT_EQUAL_NUMBERS:
+        case ExprKind::LESS_LOCAL_NUMBERS:
+        case ExprKind::SQUARE:
+            return ExprKind::BINARY;
+
+        case ExprKind::INCREMENT_LOCAL:
+        case ExprKind::INCREMENT_GLOBAL:
+            return ExprKind::ASSIGN;
+
+        case ExprKind::CALL_FUNCTION:
+        case ExprKind::CALL_INTRINSIC:
+            return ExprKind::CALL;
+
+        default:
+            return kind;
+    }
+}
+
 // visitor struct (for visitor pattern handling)
 struct ExprVisitor
 {
     virtual ~ExprVisitor() = default;
-    virtual std::any visitAssignExpr(std::shared_ptr<AssignExpr> expr) = 0;
-    virtual std::any visitBinaryExpr(std::shared_ptr<BinaryExpr> expr) = 0;
-    virtual std::any visitGroupingExpr(std::shared_ptr<GroupingExpr> expr) = 0;
-    virtual std::any visitLiteralExpr(std::shared_ptr<LiteralExpr> expr) = 0;
-    virtual std::any visitUnaryExpr(std::shared_ptr<UnaryExpr> expr) = 0;
-    virtual std::any visitMutExpr(std::shared_ptr<MutExpr> expr) = 0;
-    virtual std::any visitLogicalExpr(std::shared_ptr<LogicalExpr> expr) = 0;
-    virtual std::any visitCallExpr(std::shared_ptr<CallExpr> expr) = 0;
-    virtual std::any visitFunctionExpr(std::shared_ptr<FunctionExpr> expr) = 0;
-    virtual std::any visitGetExpr(std::shared_ptr<GetExpr> expr) = 0;
-    virtual std::any visitSetExpr(std::shared_ptr<SetExpr> expr) = 0;
-    virtual std::any visitThisExpr(std::shared_ptr<ThisExpr> expr) = 0;
-    virtual std::any visitSuperExpr(std::shared_ptr<SuperExpr> expr) = 0;
-    virtual std::any visitListExpr(std::shared_ptr<ListExpr> expr) = 0;
-    virtual std::any visitSubscriptExpr(std::shared_ptr<SubscriptExpr> expr) = 0;
+    virtual Value visitAssignExpr(std::shared_ptr<AssignExpr> expr) = 0;
+    virtual Value visitBinaryExpr(std::shared_ptr<BinaryExpr> expr) = 0;
+    virtual Value visitGroupingExpr(std::shared_ptr<GroupingExpr> expr) = 0;
+    virtual Value visitLiteralExpr(std::shared_ptr<LiteralExpr> expr) = 0;
+    virtual Value visitUnaryExpr(std::shared_ptr<UnaryExpr> expr) = 0;
+    virtual Value visitMutExpr(std::shared_ptr<MutExpr> expr) = 0;
+    virtual Value visitLogicalExpr(std::shared_ptr<LogicalExpr> expr) = 0;
+    virtual Value visitCallExpr(std::shared_ptr<CallExpr> expr) = 0;
+    virtual Value visitFunctionExpr(std::shared_ptr<FunctionExpr> expr) = 0;
+    virtual Value visitGetExpr(std::shared_ptr<GetExpr> expr) = 0;
+    virtual Value visitSetExpr(std::shared_ptr<SetExpr> expr) = 0;
+    virtual Value visitThisExpr(std::shared_ptr<ThisExpr> expr) = 0;
+    virtual Value visitSuperExpr(std::shared_ptr<SuperExpr> expr) = 0;
+    virtual Value visitListExpr(std::shared_ptr<ListExpr> expr) = 0;
+    virtual Value visitSubscriptExpr(std::shared_ptr<SubscriptExpr> expr) = 0;
 };
 
 // default expression virtual struct
 struct Expr
 {
+    ExprKind kind;
+    bool generic = false; // a quickened variant failed its guard, don't quicken again
+
+    Expr(ExprKind kind) : kind(kind) {}
     virtual ~Expr() = default;
-    virtual std::any accept(ExprVisitor& visitor) = 0;
+    virtual Value accept(ExprVisitor& visitor) = 0;
 };
 
 struct AssignExpr : Expr, public std::enable_shared_from_this<AssignExpr>
 {
     const Token name;
-    const std::shared_ptr<Expr> value;
+    std::shared_ptr<Expr> value;
+    Binding binding;
 
     AssignExpr(Token name, std::shared_ptr<Expr> value);
-    std::any accept(ExprVisitor& visitor) override;
+    Value accept(ExprVisitor& visitor) override;
 };
 
 struct BinaryExpr : Expr, public std::enable_shared_from_this<BinaryExpr>
 {
-    const std::shared_ptr<Expr> left;
+    std::shared_ptr<Expr> left;
     const Token op;
-    const std::shared_ptr<Expr> right;
+    std::shared_ptr<Expr> right;
 
     BinaryExpr(std::shared_ptr<Expr> left, Token op, std::shared_ptr<Expr> right);
-    std::any accept(ExprVisitor& visitor) override;
+    Value accept(ExprVisitor& visitor) override;
 };
 
 struct GroupingExpr : Expr, public std::enable_shared_from_this<GroupingExpr>
 {
-    const std::shared_ptr<Expr> expression;
+    std::shared_ptr<Expr> expression;
 
     GroupingExpr(std::shared_ptr<Expr> expression);
-    std::any accept(ExprVisitor& visitor) override;
+    Value accept(ExprVisitor& visitor) override;
 };
 
 struct LiteralExpr : Expr, public std::enable_shared_from_this<LiteralExpr>
 {
-    std::any value;
+    Value value;
 
-    LiteralExpr(std::any value);
-    std::any accept(ExprVisitor& visitor) override;
+    LiteralExpr(Value value);
+    Value accept(ExprVisitor& visitor) override;
 };
 
 struct UnaryExpr : Expr, public std::enable_shared_from_this<UnaryExpr>
 {
     const Token op;
-    const std::shared_ptr<Expr> right;
+    std::shared_ptr<Expr> right;
 
     UnaryExpr(Token op, std::shared_ptr<Expr> right);
-    std::any accept(ExprVisitor& visitor) override;
+    Value accept(ExprVisitor& visitor) override;
 };
 
 struct MutExpr : Expr, public std::enable_shared_from_this<MutExpr>
 {
     const Token name;
+    Binding binding;
+    MutStmt* declaration = nullptr; // a local nothing assigns to once it's declared, set by the resolver
 
     MutExpr(Token name);
-    std::any accept(ExprVisitor& visitor) override;
+    Value accept(ExprVisitor& visitor) override;
 };
 
 struct LogicalExpr : Expr, public std::enable_shared_from_this<LogicalExpr>
 {
-    const std::shared_ptr<Expr> left;
+    std::shared_ptr<Expr> left;
     const Token op;
-    const std::shared_ptr<Expr> right;
+    std::shared_ptr<Expr> right;
 
     LogicalExpr(std::shared_ptr<Expr> left, Token op, std::shared_ptr<Expr> right);
-    std::any accept(ExprVisitor& visitor) override;
+    Value accept(ExprVisitor& visitor) override;
 };
 
 struct CallExpr : Expr, public std::enable_shared_from_this<CallExpr>
@@ -127,54 +251,68 @@ struct CallExpr : Expr, public std::enable_shared_from_this<CallExpr>
     std::shared_ptr<Expr> callee;
     Token paren;
     std::vector<std::shared_ptr<Expr>> arguments;
+    // set by the resolver when the callee is a global named after a builtin and the arguments fit it.
+    // The global can still be redefined, so every engine checks it holds the builtin before going inline
+    Intrinsic intrinsic = Intrinsic::NONE;
 
     CallExpr(std::shared_ptr<Expr> callee, Token paren, std::vector<std::shared_ptr<Expr>> arguments);
-    std::any accept(ExprVisitor& visitor) override;
+    Value accept(ExprVisitor& visitor) override;
 };
 
 struct FunctionExpr : Expr, public std::enable_shared_from_this<FunctionExpr>
 {
     std::vector<Token> parameters;
     std::vector<std::shared_ptr<Stmt>> body;
+    int slot_count = 0; // parameters and locals of the body, set by the resolver
+    std::vector<int> cells; // slots of the ones a nested function captures
+    std::vector<Capture> captures; // what the function closes over, its upvalues in order
 
     FunctionExpr(std::vector<Token> parameters, std::vector<std::shared_ptr<Stmt>> body);
-    std::any accept(ExprVisitor& visitor) override;
+    Value accept(ExprVisitor& visitor) override;
 };
 
 struct GetExpr : Expr, public std::enable_shared_from_this<GetExpr>
 {
-    const std::shared_ptr<Expr> object;
+    std::shared_ptr<Expr> object;
     const Token name;
+    const Symbol symbol;
+    InlineCache cache;
 
     GetExpr(std::shared_ptr<Expr> object, Token name);
-    std::any accept(ExprVisitor& visitor) override;
+    Value accept(ExprVisitor& visitor) override;
 };
 
 struct SetExpr : Expr, public std::enable_shared_from_this<SetExpr>
 {
-    const std::shared_ptr<Expr> object;
+    std::shared_ptr<Expr> object;
     const Token name;
-    const std::shared_ptr<Expr> value;
+    const Symbol symbol;
+    std::shared_ptr<Expr> value;
+    InlineCache cache{true};
 
     SetExpr(std::shared_ptr<Expr> object, Token name, std::shared_ptr<Expr> value);
-    std::any accept(ExprVisitor& visitor) override;
+    Value accept(ExprVisitor& visitor) override;
 };
 
 struct ThisExpr : Expr, public std::enable_shared_from_this<ThisExpr>
 {
     const Token keyword;
+    Binding binding;
 
     ThisExpr(Token keyword);
-    std::any accept(ExprVisitor& visitor) override;
+    Value accept(ExprVisitor& visitor) override;
 };
 
 struct SuperExpr : Expr, public std::enable_shared_from_this<SuperExpr>
 {
     const Token keyword;
     const Token method;
+    const Symbol symbol;
+    Binding binding;
+    Binding this_binding;
 
     SuperExpr(Token keyword, Token method);
-    std::any accept(ExprVisitor& visitor) override;
+    Value accept(ExprVisitor& visitor) override;
 };
 
 struct ListExpr : Expr, public std::enable_shared_from_this<ListExpr>
@@ -182,7 +320,7 @@ struct ListExpr : Expr, public std::enable_shared_from_this<ListExpr>
     std::vector<std::shared_ptr<Expr>> elements;
 
     ListExpr(std::vector<std::shared_ptr<Expr>> elements);
-    std::any accept(ExprVisitor& visitor) override;
+    Value accept(ExprVisitor& visitor) override;
 };
 
 struct SubscriptExpr : Expr, public std::enable_shared_from_this<SubscriptExpr>
@@ -193,7 +331,7 @@ struct SubscriptExpr : Expr, public std::enable_shared_from_this<SubscriptExpr>
     std::shared_ptr<Expr> value;
 
     SubscriptExpr(std::shared_ptr<Expr> name, Token paren, std::shared_ptr<Expr> index, std::shared_ptr<Expr> value);
-    std::any accept(ExprVisitor& visitor) override;
+    Value accept(ExprVisitor& visitor) override;
 };
 
 #endif
@@ -9,27 +9,37 @@
 #pragma once
 #include "interpreter.hpp"
 #include "instance.hpp"
+#include "closure.hpp"
+#include "jit.hpp"
 
 class NblInstance;
 
-struct NblReturn
+class NblFunction final : public NblCallable
 {
-    const std::any value;
-};
+    friend class JitEmitter;
+    friend class Interpreter;
 
-class NblFunction : public NblCallable
-{
     private:
         std::string name;
         std::shared_ptr<FunctionExpr> declaration;
-        std::shared_ptr<Environment> closure;
+        std::vector<Ref<Cell>> upvalues; // the cells of declaration->captures
+        Value receiver; // "this" once bound
         bool is_initializer;
+        std::shared_ptr<StmtFn> body; // compiled body on the closure engine, null on the tree-walker
+        int calls = 0;
+        std::shared_ptr<JitCode> jit; // native code once the function got hot
+        bool jit_disabled = false; // the JIT couldn't compile it or its code bailed out
+
+        Value run(Interpreter& interpreter, const Value& self, std::span<Value> arguments);
+        bool call_native(std::span<Value> arguments, Value& result);
 
     public:
-        NblFunction(std::string name, std::shared_ptr<FunctionExpr> declaration, std::shared_ptr<Environment> closure, bool is_initializer);
-        std::shared_ptr<NblFunction> bind(std::shared_ptr<NblInstance> instance);
+        NblFunction(std::string name, std::shared_ptr<FunctionExpr> declaration, std::vector<Ref<Cell>> upvalues, bool is_initializer, std::shared_ptr<StmtFn> body = nullptr);
+        Ref<NblFunction> bind(Ref<NblInstance> instance);
         int arity() override;
-        std::any call(Interpreter& interpreter, std::vector<std::any> arguments) override;
+        Value call(Interpreter& interpreter, const Token& paren, std::span<Value> arguments) override;
+        // calls it as a method of self, without binding it first
+        Value invoke(Interpreter& interpreter, const Value& self, std::span<Value> arguments);
         std::string to_string() override;
 };
 
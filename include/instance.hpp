@@ -7,28 +7,39 @@
 #define INSTANCE_HPP
 
 #pragma once
-#include <any>
 #include <map>
 #include <memory>
 #include <string>
 #include <utility>
+#include <vector>
 
 #include "class.hpp"
 #include "token.hpp"
+#include "value.hpp"
+#include "symbol.hpp"
+#include "shape.hpp"
+#include "cache.hpp"
 
 class NblClass;
 class Token;
 
-class NblInstance : public std::enable_shared_from_this<NblInstance>
+class NblInstance : public Object
 {
+    friend class Interpreter;
+
     private:
-        std::shared_ptr<NblClass> klass;
-        std::map<std::string, std::any> fields;
+        Ref<NblClass> klass;
+        Shape* shape;
+        std::vector<Value> fields; // in the slots shape gives them
 
     public:
-        NblInstance(std::shared_ptr<NblClass> klass);
-        std::any get(const Token& name);
-        void set(const Token& name, std::any value);
+        NblInstance(Ref<NblClass> klass);
+
+        // the field or method name refers to, found through the cache of the site asking for it
+        // null when it's neither
+        const CacheEntry* lookup(Symbol name, InlineCache& cache);
+        Value get(const Token& name, Symbol symbol, InlineCache& cache);
+        void set(Symbol name, Value value, InlineCache& cache);
         std::string to_string();
 };
 
@@ -11,11 +11,12 @@
 #include <utility>
 #include <vector>
 #include <chrono>
-#include <any>
 #include <memory>
 #include <string>
 #include <stdexcept>
 #include <cmath>
+#include <optional>
+#include <span>
 
 #include "expr.hpp"
 #include "error.hpp"
@@ -28,68 +29,201 @@
 #include "class.hpp"
 #include "instance.hpp"
 #include "list.hpp"
+#include "number.hpp"
 #include "util.hpp"
+#include "vm.hpp"
+#include "closure.hpp"
+#include "trace.hpp"
+#include "value.hpp"
 
-class BreakException : public std::runtime_error
+enum class Engine
 {
-    public:
-        BreakException() : std::runtime_error("break") {};
+    TREE_WALKER,
+    BYTECODE,
+    CLOSURE
 };
 
-class Interpreter : public ExprVisitor, public StmtVisitor
+class Interpreter
 {
+    friend class VM;
+    friend class ClosureCompiler;
+    friend class LoopTrace;
+    friend class TraceRecorder;
+    friend class Runtime;
+    friend class NblFunction;
+    friend class JitEmitter;
+    friend class CallArguments;
+    friend class Optimizer;
+    friend class AstPrinter;
+
     public:
         std::shared_ptr<Environment> globals{new Environment};
+        bool jit_enabled = true; // --no-jit turns it off
+        size_t max_stack = 1000000; // deepest script call nesting, --max-stack changes it
+        int optimize_level = 2; // how much the optimizer rewrites scripts before they run, -O0 to -O2
+        bool print_ast = false; // --print-ast-after-opt, every file's AST goes to stderr once optimized
+        const char* native_limit = nullptr; // lowest address calls may use on the thread the script runs on, if known
     
     private:
-        std::map<std::shared_ptr<Expr>, int> locals;
-        std::shared_ptr<Environment> environment = globals;
+        static constexpr int STACK_SIZE = 1 << 18;
+
+        Environment* environment = globals.get();
+        // slots of every scope being run, in the order they were entered, a scope past the end keeps them on the heap
+        std::unique_ptr<Value[]> stack{new Value[STACK_SIZE]};
+        Value* stack_top = stack.get();
+        std::vector<Ref<Cell>>* upvalues = nullptr; // of the function being run
+        const Value* receiver = nullptr; // "this" of the method being run
+        std::shared_ptr<VM> vm; // only set when running on the bytecode engine
+        std::shared_ptr<ClosureCompiler> closures; // only set when running on the closure engine
+        Value return_value; // set by a return statement, see take_return_value
+        Ref<NblFunction> tail_call; // set instead by a return in tail position, see NblFunction::call
+        Value tail_receiver;
+        std::vector<Value> tail_arguments;
+        size_t depth = 0; // script functions being run
 
     private:
-        std::any lookup_mut(const Token& name, std::shared_ptr<Expr> expr);
-        std::any evaluate(std::shared_ptr<Expr> expr);
-        void execute(std::shared_ptr<Stmt> stmt);
-        void check_num_operand(const Token& op, const std::any& operand);
-        void check_num_operands(const Token& op, const std::any& left, const std::any& right);
-        bool is_truthy(const std::any& obj);
-        bool is_equal(const std::any& obj1, const std::any& obj2);
-        std::string int_or_double(const std::any& obj);
-        std::string stringify(const std::any& obj);
+        Value lookup_mut(const Token& name, const Binding& binding);
+        // where a local lives, in its slot, in the cell in its slot, or in an upvalue's cell
+        Value& local(const Binding& binding)
+        {
+            if (binding.upvalue >= 0)
+                return (*upvalues)[binding.upvalue]->value;
+
+            Value& slot = environment->ancestor(binding.depth)->slots[binding.slot];
+            return binding.cell ? slot.as<Cell>()->value : slot;
+        }
+
+        // reserves the slots of a scope on the frame stack, null when they don't fit
+        Value* push_frame(int slot_count)
+        {
+            if (stack.get() + STACK_SIZE - stack_top < slot_count)
+                return nullptr;
+
+            Value* frame = stack_top;
+            stack_top += slot_count;
+            return frame;
+        }
+
+        // releases a frame and every frame above it, clearing the slots drops the values they held
+        void pop_frame(Value* frame)
+        {
+            if (frame == nullptr)
+                return;
+
+            while (stack_top != frame)
+                *--stack_top = nullptr;
+        }
+
+        // every call nests C++ calls, running out of either limit is a runtime error instead of a crash
+        void check_stack(const Token& paren)
+        {
+            if (depth >= max_stack || (native_limit != nullptr && static_cast<const char*>(__builtin_frame_address(0)) < native_limit))
+                throw RuntimeError(paren, "Stack overflow");
+        }
+
+        void unwind();
+        std::vector<Ref<Cell>> capture(FunctionExpr* fn);
+        Value evaluate(Expr* expr);
+        void define(const Token& name, int slot, Value value);
+        ExecResult execute(Stmt* stmt);
+        void check_num_operand(const Token& op, const Value& operand);
+        void check_num_operands(const Token& op, const Value& left, const Value& right);
+        bool is_truthy(const Value& obj);
+        bool is_equal(const Value& obj1, const Value& obj2);
+        NblCallable* as_callable(const Value& obj);
+        std::string int_or_double(double number);
+        std::string stringify(const Value& obj);
+
+        Value binary_operation(const Token& op, const Value& left, const Value& right);
+        Value call_value(CallExpr* expr, const Value& callee);
+        Value call(const Token& paren, const Value& callee, std::span<Value> arguments);
+        void return_call(const Token& paren, const Value& callee, std::span<Value> arguments);
+        void return_method(const Token& paren, NblFunction* method, const Value& receiver, std::span<Value> arguments);
+        NblFunction* find_method(GetExpr* get, const Value& object, Value& field);
+        void declare_class(ClassStmt* stmt, const std::vector<std::shared_ptr<StmtFn>>& bodies);
+        void quicken_binary(BinaryExpr* expr);
+        void quicken_assign(AssignExpr* expr);
+        Value eval_binary_numbers(BinaryExpr* expr);
+        Value eval_less_local(BinaryExpr* expr);
+        Value eval_square(BinaryExpr* expr);
+        Value eval_increment_local(AssignExpr* expr);
+        Value eval_increment_global(AssignExpr* expr);
+        Value eval_call_function(CallExpr* expr);
+        Value eval_call_intrinsic(CallExpr* expr);
 
     public:
         Interpreter();
+        void set_engine(Engine engine);
         void interpret(const std::vector<std::shared_ptr<Stmt>>& statements);
         std::string interpret(const std::shared_ptr<Expr>& expr);
-        void execute_block(const std::vector<std::shared_ptr<Stmt>>& statements, std::shared_ptr<Environment> environment);
-        void resolve(std::shared_ptr<Expr> expr, int depth);
-
-        std::any visitAssignExpr(std::shared_ptr<AssignExpr> expr) override;
-        std::any visitBinaryExpr(std::shared_ptr<BinaryExpr> expr) override;
-        std::any visitGroupingExpr(std::shared_ptr<GroupingExpr> expr) override;
-        std::any visitLiteralExpr(std::shared_ptr<LiteralExpr> expr) override;
-        std::any visitUnaryExpr(std::shared_ptr<UnaryExpr> expr) override;
-        std::any visitMutExpr(std::shared_ptr<MutExpr> expr) override;
-        std::any visitLogicalExpr(std::shared_ptr<LogicalExpr> expr) override;
-        std::any visitCallExpr(std::shared_ptr<CallExpr> expr) override;
-        std::any visitFunctionExpr(std::shared_ptr<FunctionExpr> expr) override;
-        std::any visitGetExpr(std::shared_ptr<GetExpr> expr) override;
-        std::any visitSetExpr(std::shared_ptr<SetExpr> expr) override;
-        std::any visitThisExpr(std::shared_ptr<ThisExpr> expr) override;
-        std::any visitSuperExpr(std::shared_ptr<SuperExpr> expr) override;
-        std::any visitListExpr(std::shared_ptr<ListExpr> expr) override;
-        std::any visitSubscriptExpr(std::shared_ptr<SubscriptExpr> expr) override;
-
-        std::any visitBlockStmt(std::shared_ptr<BlockStmt> stmt) override;
-        std::any visitExpressionStmt(std::shared_ptr<ExpressionStmt> stmt) override;
-        std::any visitPrintStmt(std::shared_ptr<PrintStmt> stmt) override;
-        std::any visitMutStmt(std::shared_ptr<MutStmt> stmt) override;
-        std::any visitIfStmt(std::shared_ptr<IfStmt> stmt) override;
-        std::any visitWhileStmt(std::shared_ptr<WhileStmt> stmt) override;
-        std::any visitFunctionStmt(std::shared_ptr<FunctionStmt> stmt) override;
-        std::any visitReturnStmt(std::shared_ptr<ReturnStmt> stmt) override;
-        std::any visitBreakStmt(std::shared_ptr<BreakStmt> stmt) override;
-        std::any visitClassStmt(std::shared_ptr<ClassStmt> stmt) override;
-        std::any visitImportStmt(std::shared_ptr<ImportStmt> stmt) override;
+        ExecResult execute_block(const std::vector<std::shared_ptr<Stmt>>& statements, Environment* environment);
+        ExecResult execute_block(const StmtFn& body, Environment* environment);
+        ExecResult execute_scope(const std::vector<std::shared_ptr<Stmt>>& statements, int slot_count, const std::vector<int>& cells);
+        ExecResult execute_scope(const StmtFn& body, int slot_count, const std::vector<int>& cells);
+        Value take_return_value();
+
+        Value eval_assign(AssignExpr* expr);
+        Value eval_binary(BinaryExpr* expr);
+        Value eval_grouping(GroupingExpr* expr);
+        Value eval_literal(LiteralExpr* expr);
+        Value eval_unary(UnaryExpr* expr);
+        Value eval_mut(MutExpr* expr);
+        Value eval_logical(LogicalExpr* expr);
+        Value eval_call(CallExpr* expr);
+        Value eval_invoke(CallExpr* expr);
+        Value eval_function(FunctionExpr* expr);
+        Value eval_get(GetExpr* expr);
+        Value eval_set(SetExpr* expr);
+        Value eval_this(ThisExpr* expr);
+        Value eval_super(SuperExpr* expr);
+        Value eval_list(ListExpr* expr);
+        Value eval_subscript(SubscriptExpr* expr);
+
+        ExecResult exec_block(BlockStmt* stmt);
+        ExecResult exec_expression(ExpressionStmt* stmt);
+        ExecResult exec_print(PrintStmt* stmt);
+        ExecResult exec_mut(MutStmt* stmt);
+        ExecResult exec_if(IfStmt* stmt);
+        ExecResult exec_while(WhileStmt* stmt);
+        ExecResult exec_function(FunctionStmt* stmt);
+        ExecResult exec_return(ReturnStmt* stmt);
+        ExecResult exec_break(BreakStmt* stmt);
+        ExecResult exec_class(ClassStmt* stmt);
+        ExecResult exec_import(ImportStmt* stmt);
+};
+
+// the arguments of a call, evaluated into a frame on the frame stack so calls don't allocate
+class CallArguments
+{
+    private:
+        Interpreter& interpreter;
+        Value* frame;
+        std::vector<Value> spilled; // holds them instead once the frame stack is full
+
+    public:
+        std::span<Value> values;
+
+        CallArguments(Interpreter& interpreter, size_t count)
+            : interpreter(interpreter), frame(interpreter.push_frame(count))
+        {
+            if (frame == nullptr)
+            {
+                spilled.resize(count);
+                values = spilled;
+            }
+            else
+            {
+                values = std::span<Value>(frame, count);
+            }
+        }
+
+        ~CallArguments()
+        {
+            interpreter.pop_frame(frame);
+        }
+
+        CallArguments(const CallArguments&) = delete;
+        CallArguments& operator=(const CallArguments&) = delete;
 };
 
 #endif
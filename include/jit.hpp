@@ -0,0 +1,52 @@
+//------------------------------------//
+// Copyright 2024 Nam Nguyen
+// Licensed under Apache License v2.0
+//------------------------------------//
+
+#ifndef JIT_HPP
+#define JIT_HPP
+
+#pragma once
+#include <cstddef>
+#include <memory>
+#include <vector>
+
+#include "value.hpp"
+
+class NblFunction;
+class Interpreter;
+
+// what native code hands back, anything but a number sends callers to the interpreter
+enum JitStatus : int
+{
+    JIT_NUMBER = 0,
+    JIT_NIL = 1,
+    JIT_BAIL = 2
+};
+
+using JitEntry = int (*)(const double* arguments, double* result);
+
+// an executable mapping holding one compiled function
+struct JitCode
+{
+    void* memory = nullptr;
+    size_t size = 0;
+    JitEntry entry = nullptr;
+    std::vector<Value> callees; // functions called from the code, kept alive so their addresses stay theirs
+    std::vector<std::shared_ptr<JitCode>> dependencies; // their native code
+
+    ~JitCode();
+};
+
+// baseline x86-64 compiler for functions that only ever touch numbers
+class JitCompiler
+{
+    public:
+        static constexpr int THRESHOLD = 100; // calls before a function gets compiled
+        static constexpr int MAX_ARGUMENTS = 8;
+
+        // returns null when the function uses anything the JIT doesn't handle
+        static std::shared_ptr<JitCode> compile(NblFunction* function, Interpreter& interpreter);
+};
+
+#endif
@@ -8,18 +8,19 @@
 
 #pragma once
 #include <vector>
-#include <any>
 
 #include "expr.hpp"
+#include "value.hpp"
 
-struct ListType
+struct ListType : Object
 {
-    std::vector<std::any> elements;
+    std::vector<Value> elements;
 
-    void append(std::any value);
-    std::any get_element_at(int index);
-    bool set_element_at(int index, std::any value);
-    int get_length();
+    ListType() : Object(ObjectType::LIST) {}
+    void append(Value value);
+    Value get_element_at(int index);
+    bool set_element_at(int index, Value value);
+    int get_length() { return static_cast<int>(elements.size()); }
 };
 
 #endif
@@ -0,0 +1,173 @@
+//------------------------------------//
+// Copyright 2024 Nam Nguyen
+// Licensed under Apache License v2.0
+//------------------------------------//
+
+#ifndef NUMBER_HPP
+#define NUMBER_HPP
+
+#pragma once
+#include <climits>
+#include <cmath>
+#include <cstdint>
+
+#include "value.hpp"
+
+// arithmetic on two numbers, shared by every engine
+// integers stay integers while the exact result is one and fits, anything else is done on doubles,
+// so the result always equals what the operation on doubles gives, down to the sign of zero
+
+inline Value num_add(const Value& left, const Value& right)
+{
+    if (left.is_int() && right.is_int())
+        return Value::integer(left.as_int() + right.as_int());
+
+    return left.as_number() + right.as_number();
+}
+
+inline Value num_subtract(const Value& left, const Value& right)
+{
+    if (left.is_int() && right.is_int())
+        return Value::integer(left.as_int() - right.as_int());
+
+    return left.as_number() - right.as_number();
+}
+
+inline Value num_multiply(const Value& left, const Value& right)
+{
+    if (left.is_int() && right.is_int())
+    {
+        int64_t a = left.as_int();
+        int64_t b = right.as_int();
+        int64_t result;
+
+        if (!__builtin_mul_overflow(a, b, &result))
+            return result == 0 && (a < 0 || b < 0) ? Value(-0.0) : Value::integer(result);
+    }
+
+    return left.as_number() * right.as_number();
+}
+
+inline Value num_divide(const Value& left, const Value& right)
+{
+    if (left.is_int() && right.is_int())
+    {
+        int64_t a = left.as_int();
+        int64_t b = right.as_int();
+
+        if (b != 0 && a % b == 0 && !(a == 0 && b < 0))
+            return Value::integer(a / b);
+    }
+
+    return left.as_number() / right.as_number();
+}
+
+inline Value num_modulo(const Value& left, const Value& right)
+{
+    if (left.is_int() && right.is_int() && right.as_int() != 0)
+    {
+        // % truncates like fmod, the result takes the sign of the dividend
+        int64_t result = left.as_int() % right.as_int();
+        return result == 0 && left.as_int() < 0 ? Value(-0.0) : Value::integer(result);
+    }
+
+    return std::fmod(left.as_number(), right.as_number());
+}
+
+inline Value num_power(const Value& left, const Value& right)
+{
+    if (left.is_int() && right.is_int() && right.as_int() >= 0)
+    {
+        int64_t base = left.as_int();
+        int64_t exponent = right.as_int();
+        int64_t result = 1;
+        bool overflow = false;
+
+        while (exponent > 0 && !overflow)
+        {
+            if (exponent & 1)
+                overflow = __builtin_mul_overflow(result, base, &result);
+
+            exponent >>= 1;
+
+            if (exponent > 0)
+                overflow = overflow || __builtin_mul_overflow(base, base, &base);
+        }
+
+        if (!overflow)
+            return Value::integer(result);
+    }
+
+    return std::pow(left.as_number(), right.as_number());
+}
+
+inline Value num_negate(const Value& operand)
+{
+    if (operand.is_int() && operand.as_int() != 0)
+        return Value::integer(-operand.as_int());
+
+    return -operand.as_number();
+}
+
+inline Value num_floordiv(const Value& left, const Value& right)
+{
+    if (left.is_int() && right.is_int() && right.as_int() != 0)
+    {
+        int64_t a = left.as_int();
+        int64_t b = right.as_int();
+        int64_t quotient = a / b;
+
+        if (a % b != 0 && (a < 0) != (b < 0))
+            quotient--;
+
+        if (!(a == 0 && b < 0))
+            return Value::integer(quotient);
+    }
+
+    return std::floor(left.as_number() / right.as_number());
+}
+
+inline bool num_less(const Value& left, const Value& right)
+{
+    if (left.is_int() && right.is_int())
+        return left.as_int() < right.as_int();
+
+    return left.as_number() < right.as_number();
+}
+
+inline bool num_less_equal(const Value& left, const Value& right)
+{
+    if (left.is_int() && right.is_int())
+        return left.as_int() <= right.as_int();
+
+    return left.as_number() <= right.as_number();
+}
+
+inline bool num_equal(const Value& left, const Value& right)
+{
+    if (left.is_int() && right.is_int())
+        return left.as_int() == right.as_int();
+
+    return left.as_number() == right.as_number();
+}
+
+inline bool num_greater(const Value& left, const Value& right)
+{
+    return num_less(right, left);
+}
+
+inline bool num_greater_equal(const Value& left, const Value& right)
+{
+    return num_less_equal(right, left);
+}
+
+// a number used as a list index, anything past the range of int is out of bounds
+inline int num_index(const Value& index)
+{
+    if (index.is_int())
+        return index.as_int() > INT_MAX || index.as_int() < INT_MIN ? -1 : static_cast<int>(index.as_int());
+
+    return static_cast<int>(index.as_double());
+}
+
+#endif
@@ -0,0 +1,41 @@
+//------------------------------------//
+// Copyright 2024 Nam Nguyen
+// Licensed under Apache License v2.0
+//------------------------------------//
+
+#ifndef OPTIMIZER_HPP
+#define OPTIMIZER_HPP
+
+#pragma once
+#include <memory>
+#include <vector>
+
+#include "expr.hpp"
+#include "stmt.hpp"
+#include "value.hpp"
+
+class Interpreter;
+
+// rewrites a resolved AST before any engine runs it, every rewrite keeps what the program prints
+// -O1 folds constants and drops code that can't run, -O2 also propagates constant locals and squares
+class Optimizer
+{
+    private:
+        Interpreter& interpreter;
+        int level;
+
+        void optimize(std::shared_ptr<Stmt>& stmt);
+        void optimize(std::shared_ptr<Expr>& expr);
+        void optimize_branch(std::shared_ptr<Stmt>& stmt);
+        void optimize_binary(std::shared_ptr<Expr>& expr);
+        void optimize_unary(std::shared_ptr<Expr>& expr);
+        void optimize_logical(std::shared_ptr<Expr>& expr);
+        void optimize_mut(std::shared_ptr<Expr>& expr);
+        bool fold(BinaryExpr* expr, const Value& left, const Value& right, Value& result);
+
+    public:
+        Optimizer(Interpreter& interpreter, int level);
+        void optimize(std::vector<std::shared_ptr<Stmt>>& statements);
+};
+
+#endif
@@ -32,7 +32,7 @@ class Parser
     int loop_depth = 0; // track how many enclosing loops
 
     private:
-        bool allow_expression;
+        bool allow_expression = false;
         bool found_expression = false;
 
         std::shared_ptr<Stmt> statement();
@@ -0,0 +1,37 @@
+//------------------------------------//
+// Copyright 2024 Nam Nguyen
+// Licensed under Apache License v2.0
+//------------------------------------//
+
+#ifndef PRINTER_HPP
+#define PRINTER_HPP
+
+#pragma once
+#include <memory>
+#include <string>
+#include <vector>
+
+#include "expr.hpp"
+#include "stmt.hpp"
+
+class Interpreter;
+
+// writes an AST out for --print-ast-after-opt, a statement per line with the ones inside it
+// indented below it, and expressions as s-expressions like (+ a (* b 2))
+class AstPrinter
+{
+    private:
+        Interpreter& interpreter;
+        int depth = 0;
+
+        void print(Stmt* stmt, std::string& out);
+        void print_body(Stmt* stmt, std::string& out);
+        std::string indent();
+
+    public:
+        AstPrinter(Interpreter& interpreter);
+        std::string print(const std::vector<std::shared_ptr<Stmt>>& statements);
+        std::string print(Expr* expr);
+};
+
+#endif
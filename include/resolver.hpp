@@ -34,11 +34,30 @@ enum class ClassType
     SUBCLASS
 };
 
+struct LocalVariable
+{
+    bool defined;
+    int slot; // index into the scope's environment
+    bool captured = false; // used by a function nested in the one declaring it
+    std::vector<Binding*> uses; // by the declaring function, they go through the cell if it gets captured
+    MutStmt* declaration = nullptr; // the mut statement declaring it, null for parameters, functions and classes
+    bool assigned = false;
+    std::vector<MutExpr*> reads; // they get the declaration if nothing assigns to it
+};
+
+// a function being resolved, the script is the one at the bottom
+struct FunctionScope
+{
+    FunctionExpr* fn; // null for the script
+    size_t first_scope; // the scope of its parameters
+    bool is_method; // the scope just outside of it holds "this"
+};
+
 class Resolver : public ExprVisitor, public StmtVisitor
 {
     private:
-        Interpreter& interpreter;
-        std::vector<std::map<std::string, bool>> scopes;
+        std::vector<std::map<std::string, LocalVariable>> scopes;
+        std::vector<FunctionScope> functions{{nullptr, 0, false}};
         FunctionType current_func = FunctionType::NONE;
         ClassType current_class = ClassType::NONE;
 
@@ -51,43 +70,45 @@ class Resolver : public ExprVisitor, public StmtVisitor
         void resolve(std::shared_ptr<Stmt> stmt);
         void resolve(std::shared_ptr<Expr> expr);
         void resolve_function(std::shared_ptr<FunctionExpr> fn, FunctionType type);
-        void resolve_local(std::shared_ptr<Expr> expr, const Token& name);
-        void declare(const Token& name);
+        LocalVariable* resolve_local(Binding& binding, const Token& name);
+        void bind(Binding& binding, size_t scope, const std::string& name);
+        int capture(size_t level, size_t scope, int slot);
+        int declare(const Token& name);
         void define(const Token& name);
         void begin_scope();
-        void end_scope();
+        void end_scope(std::vector<int>* cells = nullptr);
 
     public:
-        Resolver(Interpreter& interpreter, std::string& executed_path);
+        Resolver(std::string& executed_path);
         void resolve(const std::vector<std::shared_ptr<Stmt>>& statements);
 
-        std::any visitAssignExpr(std::shared_ptr<AssignExpr> expr) override;
-        std::any visitBinaryExpr(std::shared_ptr<BinaryExpr> expr) override;
-        std::any visitGroupingExpr(std::shared_ptr<GroupingExpr> expr) override;
-        std::any visitLiteralExpr(std::shared_ptr<LiteralExpr> expr) override;
-        std::any visitUnaryExpr(std::shared_ptr<UnaryExpr> expr) override;
-        std::any visitMutExpr(std::shared_ptr<MutExpr> expr) override;
-        std::any visitLogicalExpr(std::shared_ptr<LogicalExpr> expr) override;
-        std::any visitCallExpr(std::shared_ptr<CallExpr> expr) override;
-        std::any visitFunctionExpr(std::shared_ptr<FunctionExpr> expr) override;
-        std::any visitGetExpr(std::shared_ptr<GetExpr> expr) override;
-        std::any visitSetExpr(std::shared_ptr<SetExpr> expr) override;
-        std::any visitThisExpr(std::shared_ptr<ThisExpr> expr) override;
-        std::any visitSuperExpr(std::shared_ptr<SuperExpr> expr) override;
-        std::any visitListExpr(std::shared_ptr<ListExpr> expr) override;
-        std::any visitSubscriptExpr(std::shared_ptr<SubscriptExpr> expr) override;
-
-        std::any visitBlockStmt(std::shared_ptr<BlockStmt> stmt) override;
-        std::any visitExpressionStmt(std::shared_ptr<ExpressionStmt> stmt) override;
-        std::any visitPrintStmt(std::shared_ptr<PrintStmt> stmt) override;
-        std::any visitMutStmt(std::shared_ptr<MutStmt> stmt) override;
-        std::any visitIfStmt(std::shared_ptr<IfStmt> stmt) override;
-        std::any visitWhileStmt(std::shared_ptr<WhileStmt> stmt) override;
-        std::any visitFunctionStmt(std::shared_ptr<FunctionStmt> stmt) override;
-        std::any visitReturnStmt(std::shared_ptr<ReturnStmt> stmt) override;
-        std::any visitBreakStmt(std::shared_ptr<BreakStmt> stmt) override;
-        std::any visitClassStmt(std::shared_ptr<ClassStmt> stmt) override;
-        std::any visitImportStmt(std::shared_ptr<ImportStmt> stmt) override;
+        Value visitAssignExpr(std::shared_ptr<AssignExpr> expr) override;
+        Value visitBinaryExpr(std::shared_ptr<BinaryExpr> expr) override;
+        Value visitGroupingExpr(std::shared_ptr<GroupingExpr> expr) override;
+        Value visitLiteralExpr(std::shared_ptr<LiteralExpr> expr) override;
+        Value visitUnaryExpr(std::shared_ptr<UnaryExpr> expr) override;
+        Value visitMutExpr(std::shared_ptr<MutExpr> expr) override;
+        Value visitLogicalExpr(std::shared_ptr<LogicalExpr> expr) override;
+        Value visitCallExpr(std::shared_ptr<CallExpr> expr) override;
+        Value visitFunctionExpr(std::shared_ptr<FunctionExpr> expr) override;
+        Value visitGetExpr(std::shared_ptr<GetExpr> expr) override;
+        Value visitSetExpr(std::shared_ptr<SetExpr> expr) override;
+        Value visitThisExpr(std::shared_ptr<ThisExpr> expr) override;
+        Value visitSuperExpr(std::shared_ptr<SuperExpr> expr) override;
+        Value visitListExpr(std::shared_ptr<ListExpr> expr) override;
+        Value visitSubscriptExpr(std::shared_ptr<SubscriptExpr> expr) override;
+
+        Value visitBlockStmt(std::shared_ptr<BlockStmt> stmt) override;
+        Value visitExpressionStmt(std::shared_ptr<ExpressionStmt> stmt) override;
+        Value visitPrintStmt(std::shared_ptr<PrintStmt> stmt) override;
+        Value visitMutStmt(std::shared_ptr<MutStmt> stmt) override;
+        Value visitIfStmt(std::shared_ptr<IfStmt> stmt) override;
+        Value visitWhileStmt(std::shared_ptr<WhileStmt> stmt) override;
+        Value visitFunctionStmt(std::shared_ptr<FunctionStmt> stmt) override;
+        Value visitReturnStmt(std::shared_ptr<ReturnStmt> stmt) override;
+        Value visitBreakStmt(std::shared_ptr<BreakStmt> stmt) override;
+        Value visitClassStmt(std::shared_ptr<ClassStmt> stmt) override;
+        Value visitImportStmt(std::shared_ptr<ImportStmt> stmt) override;
 };
 
 #endif
@@ -0,0 +1,205 @@
+//------------------------------------//
+// Copyright 2024 Nam Nguyen
+// Licensed under Apache License v2.0
+//------------------------------------//
+
+#ifndef RUNTIME_HPP
+#define RUNTIME_HPP
+
+#pragma once
+#include <initializer_list>
+#include <map>
+#include <memory>
+#include <string>
+#include <utility>
+
+#include "interpreter.hpp"
+
+struct AotClass;
+
+// a function compiled ahead of time by --emit-c, methods get their receiver passed in
+struct AotFunction : Object
+{
+    using Code = Value (*)(AotFunction* self, const Value& receiver, Value* arguments);
+
+    std::string name; // the class name for methods, empty for lambdas
+    int arity;
+    Code code;
+    std::shared_ptr<Environment> closure; // innermost environment the function was declared in
+    Value receiver; // "this", once bound
+    Value superclass; // "super" of a method
+    bool is_initializer = false;
+
+    AotFunction(std::string name, int arity, Code code, std::shared_ptr<Environment> closure)
+        : Object(ObjectType::AOT_FUNCTION), name(std::move(name)), arity(arity), code(code), closure(std::move(closure)) {}
+    Ref<AotFunction> bind(const Value& receiver);
+};
+
+struct AotClass : Object
+{
+    std::string name;
+    Ref<AotClass> superclass;
+    std::map<std::string, Ref<AotFunction>> methods; // inherited ones included, a lookup never walks up
+    AotFunction* initializer = nullptr;
+
+    AotClass(std::string name, Ref<AotClass> superclass);
+    AotFunction* find_method(const std::string& name);
+};
+
+struct AotInstance : Object
+{
+    Ref<AotClass> klass;
+    std::map<std::string, Value> fields;
+
+    AotInstance(Ref<AotClass> klass) : Object(ObjectType::AOT_INSTANCE), klass(std::move(klass)) {}
+};
+
+// what a program compiled by --emit-c calls into, operators and natives are the interpreter's own
+// so both report the same results and the same errors
+class Runtime
+{
+    private:
+        Interpreter interpreter;
+        std::map<std::pair<TokenType, int>, Token> tokens; // a RuntimeError only holds a reference to its token
+        size_t max_stack = 0; // deepest call nesting, the --max-stack the script was compiled with
+        const char* native_limit = nullptr; // lowest address calls may use on the script's stack, if known
+        size_t depth = 0; // compiled functions being run
+
+        const Token& token(TokenType type, int line);
+        void check_arity(int arity, int count, int line);
+
+        // counts a compiled call for as long as it runs, however it ends
+        class CallDepth
+        {
+            Runtime& runtime;
+
+            public:
+                CallDepth(Runtime& runtime, int line)
+                    : runtime(runtime)
+                {
+                    runtime.check_stack(line);
+                    runtime.depth++;
+                }
+
+                ~CallDepth()
+                {
+                    runtime.depth--;
+                }
+
+                CallDepth(const CallDepth&) = delete;
+                CallDepth& operator=(const CallDepth&) = delete;
+        };
+
+        // compiled calls nest C++ calls, running out of either limit is a runtime error like it is for Interpreter::check_stack
+        void check_stack(int line)
+        {
+            if (depth >= max_stack || (native_limit != nullptr && static_cast<const char*>(__builtin_frame_address(0)) < native_limit))
+                error(line, "Stack overflow");
+        }
+
+    public:
+        [[noreturn]] void error(int line, const std::string& message);
+        [[noreturn]] void undefined(const char* name, int line);
+
+        // loads a native into a global if the interpreter has one by that name
+        void native(const char* name, Value& global, bool& defined);
+        // runs the script on a stack for max_stack calls and exits with its status, 3 after a runtime error
+        int run(void (*script)(), size_t max_stack);
+
+        bool truthy(const Value& value) { return !value.is_falsey(); }
+        Value binary(TokenType op, const Value& left, const Value& right, int line);
+        Value negate(const Value& value, int line);
+        Value equal(const Value& left, const Value& right) { return interpreter.is_equal(left, right); }
+        Value not_equal(const Value& left, const Value& right) { return !interpreter.is_equal(left, right); }
+
+        // numbers stay inline, anything else goes through binary
+        Value add(const Value& left, const Value& right, int line)
+        {
+            if (left.is_number() && right.is_number())
+                return num_add(left, right);
+            return binary(PLUS, left, right, line);
+        }
+
+        Value subtract(const Value& left, const Value& right, int line)
+        {
+            if (left.is_number() && right.is_number())
+                return num_subtract(left, right);
+            return binary(MINUS, left, right, line);
+        }
+
+        Value multiply(const Value& left, const Value& right, int line)
+        {
+            if (left.is_number() && right.is_number())
+                return num_multiply(left, right);
+            return binary(STAR, left, right, line);
+        }
+
+        Value divide(const Value& left, const Value& right, int line)
+        {
+            if (left.is_number() && right.is_number())
+                return num_divide(left, right);
+            return binary(SLASH, left, right, line);
+        }
+
+        Value less(const Value& left, const Value& right, int line)
+        {
+            if (left.is_number() && right.is_number())
+                return num_less(left, right);
+            return binary(LESS, left, right, line);
+        }
+
+        Value less_equal(const Value& left, const Value& right, int line)
+        {
+            if (left.is_number() && right.is_number())
+                return num_less_equal(left, right);
+            return binary(LESS_EQUAL, left, right, line);
+        }
+
+        Value greater(const Value& left, const Value& right, int line)
+        {
+            if (left.is_number() && right.is_number())
+                return num_greater(left, right);
+            return binary(GREATER, left, right, line);
+        }
+
+        Value greater_equal(const Value& left, const Value& right, int line)
+        {
+            if (left.is_number() && right.is_number())
+                return num_greater_equal(left, right);
+            return binary(GREATER_EQUAL, left, right, line);
+        }
+
+        Value call(const Value& callee, Value* arguments, int count, int line);
+
+        // a call the compiler resolved to the generated function itself
+        template <typename Function, typename... Arguments>
+        Value call_direct(Function function, AotFunction* self, int line, Arguments&&... arguments)
+        {
+            CallDepth call(*this, line);
+            return function(self, Value(), std::forward<Arguments>(arguments)...);
+        }
+
+        Value invoke(AotFunction* method, const Value& receiver, Value* arguments, int count, int line);
+
+        // the method a call on object.name runs, or null with callee set to the field of that name
+        AotFunction* lookup(const Value& object, const std::string& name, Value& callee, int line);
+
+        Value get(const Value& object, const std::string& name, int line);
+        void expect_instance(const Value& object, int line);
+        void set(const Value& object, const std::string& name, const Value& value);
+        Value super_method(const Value& superclass, const Value& receiver, const std::string& name, int line);
+
+        Value list(std::initializer_list<Value> elements);
+        Value subscript(const Value& list, const Value& index, int line);
+        ListType* subscript_target(const Value& list, const Value& index, int line);
+        void subscript_store(ListType* list, const Value& index, const Value& value, int line);
+
+        Value make_class(const char* name);
+        Value make_class(const char* name, const Value& superclass, int line);
+        void add_method(const Value& klass, const char* name, AotFunction* method);
+
+        std::string stringify(const Value& value);
+        void print(const Value& value);
+};
+
+#endif
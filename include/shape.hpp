@@ -0,0 +1,49 @@
+//------------------------------------//
+// Copyright 2024 Nam Nguyen
+// Licensed under Apache License v2.0
+//------------------------------------//
+
+#ifndef SHAPE_HPP
+#define SHAPE_HPP
+
+#pragma once
+#include <cstdint>
+#include <memory>
+#include <unordered_map>
+#include <vector>
+
+#include "symbol.hpp"
+
+// which slot of an instance holds which field. Instances of a class that got the same fields in the
+// same order share a shape, adding a field moves an instance on to the next shape in the class's tree
+class Shape
+{
+    private:
+        std::vector<Symbol> names; // the field in each slot
+        std::unordered_map<Symbol, std::unique_ptr<Shape>> transitions;
+
+    public:
+        // never reused, so a cache that remembers a shape by id can't mistake a new shape for one that was freed
+        const uint32_t id;
+
+        Shape();
+
+        // slot of the field, -1 when instances of this shape don't have it. Objects have few fields,
+        // scanning them is quicker than hashing
+        int find(Symbol name) const
+        {
+            for (size_t i = 0; i < names.size(); i++)
+            {
+                if (names[i] == name)
+                    return static_cast<int>(i);
+            }
+
+            return -1;
+        }
+
+        // the shape after adding name, the new field goes in the last slot
+        Shape* add(Symbol name);
+        size_t size() const { return names.size(); }
+};
+
+#endif
@@ -0,0 +1,19 @@
+//------------------------------------//
+// Copyright 2024 Nam Nguyen
+// Licensed under Apache License v2.0
+//------------------------------------//
+
+#ifndef STACK_HPP
+#define STACK_HPP
+
+#pragma once
+#include <cstddef>
+#include <functional>
+
+// Script calls nest C++ calls, a few megabytes of main thread stack only go a few thousand deep.
+// Runs body on a thread whose stack has room for max_calls of them. The memory is only reserved,
+// pages get used as the recursion reaches them. body is told the lowest address calls may
+// safely use, or null when it runs on the caller's stack because the thread couldn't be made.
+void run_on_script_stack(size_t max_calls, const std::function<void(const char* limit)>& body);
+
+#endif
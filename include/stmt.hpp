@@ -7,7 +7,6 @@
 #define STMT_HPP
 
 #pragma once
-#include <any>
 #include <memory>
 #include <vector>
 #include <utility>
@@ -27,59 +26,92 @@ struct BreakStmt;
 struct ClassStmt;
 struct ImportStmt;
 
+class LoopTrace;
+
+// how a statement finished, return and break unwind through the enclosing statements
+enum class ExecResult
+{
+    NORMAL,
+    RETURN,
+    BREAK
+};
+
+// node type tag, see ExprKind
+enum class StmtKind : uint8_t
+{
+    BLOCK,
+    EXPRESSION,
+    PRINT,
+    MUT,
+    IF,
+    WHILE,
+    FUNCTION,
+    RETURN,
+    BREAK,
+    CLASS,
+    IMPORT
+};
+
 struct StmtVisitor
 {
     virtual ~StmtVisitor() = default;
-    virtual std::any visitBlockStmt(std::shared_ptr<BlockStmt> stmt) = 0;
-    virtual std::any visitExpressionStmt(std::shared_ptr<ExpressionStmt> stmt) = 0;
-    virtual std::any visitPrintStmt(std::shared_ptr<PrintStmt> stmt) = 0;
-    virtual std::any visitMutStmt(std::shared_ptr<MutStmt> stmt) = 0;
-    virtual std::any visitIfStmt(std::shared_ptr<IfStmt> stmt) = 0;
-    virtual std::any visitWhileStmt(std::shared_ptr<WhileStmt> stmt) = 0;
-    virtual std::any visitFunctionStmt(std::shared_ptr<FunctionStmt> stmt) = 0;
-    virtual std::any visitReturnStmt(std::shared_ptr<ReturnStmt> stmt) = 0;
-    virtual std::any visitBreakStmt(std::shared_ptr<BreakStmt> stmt) = 0;
-    virtual std::any visitClassStmt(std::shared_ptr<ClassStmt> stmt) = 0;
-    virtual std::any visitImportStmt(std::shared_ptr<ImportStmt> stmt) = 0;
+    virtual Value visitBlockStmt(std::shared_ptr<BlockStmt> stmt) = 0;
+    virtual Value visitExpressionStmt(std::shared_ptr<ExpressionStmt> stmt) = 0;
+    virtual Value visitPrintStmt(std::shared_ptr<PrintStmt> stmt) = 0;
+    virtual Value visitMutStmt(std::shared_ptr<MutStmt> stmt) = 0;
+    virtual Value visitIfStmt(std::shared_ptr<IfStmt> stmt) = 0;
+    virtual Value visitWhileStmt(std::shared_ptr<WhileStmt> stmt) = 0;
+    virtual Value visitFunctionStmt(std::shared_ptr<FunctionStmt> stmt) = 0;
+    virtual Value visitReturnStmt(std::shared_ptr<ReturnStmt> stmt) = 0;
+    virtual Value visitBreakStmt(std::shared_ptr<BreakStmt> stmt) = 0;
+    virtual Value visitClassStmt(std::shared_ptr<ClassStmt> stmt) = 0;
+    virtual Value visitImportStmt(std::shared_ptr<ImportStmt> stmt) = 0;
 };
 
 struct Stmt
 {
+    const StmtKind kind;
+
+    Stmt(StmtKind kind) : kind(kind) {}
     virtual ~Stmt() = default;
-    virtual std::any accept(StmtVisitor& visitor) = 0;
+    virtual Value accept(StmtVisitor& visitor) = 0;
 };
 
 struct BlockStmt : Stmt, public std::enable_shared_from_this<BlockStmt>
 {
-    const std::vector<std::shared_ptr<Stmt>> statements;
+    std::vector<std::shared_ptr<Stmt>> statements;
+    int slot_count = 0; // locals declared in the block, set by the resolver
+    std::vector<int> cells; // slots of the ones a nested function captures
+    bool scoped = true; // false when the block declares nothing, it then runs in the enclosing scope
 
     BlockStmt(std::vector<std::shared_ptr<Stmt>> statements);
-    std::any accept(StmtVisitor& visitor) override;
+    Value accept(StmtVisitor& visitor) override;
 };
 
 struct ExpressionStmt : Stmt, public std::enable_shared_from_this<ExpressionStmt>
 {
-    const std::shared_ptr<Expr> expression;
+    std::shared_ptr<Expr> expression;
 
     ExpressionStmt(std::shared_ptr<Expr> expression);
-    std::any accept(StmtVisitor& visitor) override;
+    Value accept(StmtVisitor& visitor) override;
 };
 
 struct PrintStmt : Stmt, public std::enable_shared_from_this<PrintStmt>
 {
-    const std::shared_ptr<Expr> expression;
+    std::shared_ptr<Expr> expression;
 
     PrintStmt(std::shared_ptr<Expr> expression);
-    std::any accept(StmtVisitor& visitor) override;
+    Value accept(StmtVisitor& visitor) override;
 };
 
 struct MutStmt : Stmt, public std::enable_shared_from_this<MutStmt>
 {
     const Token name;
-    const std::shared_ptr<Expr> initializer;
+    std::shared_ptr<Expr> initializer;
+    int slot = -1; // set by the resolver, -1 for globals
 
     MutStmt(Token name, std::shared_ptr<Expr> initializer);
-    std::any accept(StmtVisitor& visitor) override;
+    Value accept(StmtVisitor& visitor) override;
 };
 
 struct IfStmt : Stmt, public std::enable_shared_from_this<IfStmt>
@@ -89,40 +121,45 @@ struct IfStmt : Stmt, public std::enable_shared_from_this<IfStmt>
     std::shared_ptr<Stmt> else_branch;
 
     IfStmt(std::shared_ptr<Expr> condition, std::shared_ptr<Stmt> then_branch, std::shared_ptr<Stmt> else_branch);
-    std::any accept(StmtVisitor& visitor) override;
+    Value accept(StmtVisitor& visitor) override;
 };
 
 struct WhileStmt : Stmt, public std::enable_shared_from_this<WhileStmt>
 {
     std::shared_ptr<Expr> condition;
     std::shared_ptr<Stmt> body;
+    int iterations = 0; // counted by the tree-walker until the loop gets traced
+    bool traceable = true;
+    std::shared_ptr<LoopTrace> trace;
 
     WhileStmt(std::shared_ptr<Expr> condition, std::shared_ptr<Stmt> body);
-    std::any accept(StmtVisitor& visitor) override;
+    Value accept(StmtVisitor& visitor) override;
 };
 
 struct FunctionStmt : Stmt, public std::enable_shared_from_this<FunctionStmt>
 {
     Token name;
     std::shared_ptr<FunctionExpr> fn;
+    int slot = -1; // set by the resolver, -1 for globals
 
     FunctionStmt(Token name, std::shared_ptr<FunctionExpr> fn);
-    std::any accept(StmtVisitor& visitor) override;
+    Value accept(StmtVisitor& visitor) override;
 };
 
 struct ReturnStmt : Stmt, public std::enable_shared_from_this<ReturnStmt>
 {
     const Token keyword;
-    const std::shared_ptr<Expr> value;
+    std::shared_ptr<Expr> value;
+    bool tail = false; // the value is a call whose result is returned as is, set by the resolver
 
     ReturnStmt(Token keyword, std::shared_ptr<Expr> value);
-    std::any accept(StmtVisitor& visitor) override;
+    Value accept(StmtVisitor& visitor) override;
 };
 
 struct BreakStmt : Stmt, public std::enable_shared_from_this<BreakStmt>
 {
     BreakStmt();
-    std::any accept(StmtVisitor& visitor) override;
+    Value accept(StmtVisitor& visitor) override;
 };
 
 struct ClassStmt : Stmt, public std::enable_shared_from_this<ClassStmt>
@@ -130,9 +167,10 @@ struct ClassStmt : Stmt, public std::enable_shared_from_this<ClassStmt>
     const Token name;
     const std::shared_ptr<MutExpr> superclass;
     const std::vector<std::shared_ptr<FunctionStmt>> methods;
+    int slot = -1; // set by the resolver, -1 for globals
 
     ClassStmt(Token name, std::shared_ptr<MutExpr> superclass, std::vector<std::shared_ptr<FunctionStmt>> methods);
-    std::any accept(StmtVisitor& visitor) override;
+    Value accept(StmtVisitor& visitor) override;
 };
 
 struct ImportStmt : Stmt, public std::enable_shared_from_this<ImportStmt>
@@ -141,7 +179,7 @@ struct ImportStmt : Stmt, public std::enable_shared_from_this<ImportStmt>
     std::shared_ptr<LiteralExpr> target;
 
     ImportStmt(Token keyword, std::shared_ptr<LiteralExpr> target);
-    std::any accept(StmtVisitor& visitor) override;
+    Value accept(StmtVisitor& visitor) override;
 };
 
 #endif
@@ -0,0 +1,23 @@
+//------------------------------------//
+// Copyright 2024 Nam Nguyen
+// Licensed under Apache License v2.0
+//------------------------------------//
+
+#ifndef SYMBOL_HPP
+#define SYMBOL_HPP
+
+#pragma once
+#include <cstdint>
+#include <string>
+
+// a name interned to a small integer, equal names get equal symbols so lookups compare integers
+using Symbol = uint32_t;
+
+Symbol intern(const std::string& name);
+
+// globals are numbered the same way but apart from symbols, so the slots stay dense and an engine
+// can keep its globals in an array indexed by them
+int global_slot(const std::string& name);
+const std::string& global_name(int slot);
+
+#endif
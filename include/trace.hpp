@@ -0,0 +1,146 @@
+//------------------------------------//
+// Copyright 2024 Nam Nguyen
+// Licensed under Apache License v2.0
+//------------------------------------//
+
+#ifndef TRACE_HPP
+#define TRACE_HPP
+
+#pragma once
+#include <map>
+#include <memory>
+#include <string>
+#include <vector>
+
+#include "expr.hpp"
+#include "jit.hpp"
+#include "stmt.hpp"
+
+class Interpreter;
+class Environment;
+struct TraceState;
+
+// a number the trace keeps unboxed in a register, its address is worked out on every entry
+struct TraceVariable
+{
+    enum Place { INNER, OUTER, GLOBAL, UPVALUE } place;
+    int scope = 0; // INNER: block of the trace it lives in, OUTER: environments above the loop's
+    int slot = 0; // UPVALUE: index into the function's upvalues, GLOBAL: the global's slot
+    bool cell = false; // OUTER: captured, the slot holds its cell
+
+    bool operator==(const TraceVariable& other) const
+    {
+        return place == other.place && scope == other.scope && slot == other.slot && cell == other.cell;
+    }
+};
+
+// statements the interpreter still has to run after a side exit, from next up to end
+struct TraceFrame
+{
+    const std::shared_ptr<Stmt>* next;
+    const std::shared_ptr<Stmt>* end;
+    int scope; // -1 for the loop's environment
+};
+
+// one recorded iteration of a hot while loop, compiled to native code that loops on its own
+class LoopTrace
+{
+    friend class TraceRecorder;
+    friend class TraceEmitter;
+
+    public:
+        static constexpr int THRESHOLD = 50; // iterations before a loop gets recorded
+        static constexpr int EXIT_LIMIT = 1000; // side exits before the trace is thrown away
+
+    private:
+        struct Block
+        {
+            BlockStmt* block;
+            int parent; // -1 for the loop's environment
+        };
+
+        struct Callout
+        {
+            Stmt* stmt;
+            int scope;
+        };
+
+        JitCode code;
+        std::vector<TraceVariable> variables;
+        std::vector<Block> blocks; // every block entered along the trace, each gets an environment on entry
+        std::vector<Callout> callouts; // statements the native code hands back to the interpreter
+        std::vector<std::vector<TraceFrame>> exits; // innermost frame first
+        int exits_taken = 0;
+
+        static int callout(TraceState* state, int index);
+
+    public:
+        // runs iterations until the loop ends or a side exit finished one in the interpreter,
+        // false when the entry guards fail and nothing ran
+        bool run(Interpreter& interpreter, ExecResult& result);
+        bool worn_out() const { return exits_taken >= EXIT_LIMIT; }
+};
+
+// executes one iteration in the interpreter while writing down what it did
+class TraceRecorder
+{
+    public:
+        static constexpr int MAX_VARIABLES = 10; // one xmm register each
+
+        enum class OpKind
+        {
+            EVALUATE, // a numeric expression, assignments included
+            DECLARE, // mut with a numeric initializer
+            GUARD, // an if condition that has to come out the way it did while recording
+            CALLOUT // anything else, run by the interpreter
+        };
+
+        struct Op
+        {
+            OpKind kind;
+            Expr* expr = nullptr;
+            int variable = -1; // DECLARE
+            std::shared_ptr<TraceVariable> declares; // the local a CALLOUT defines, if it's a mut
+            bool expected = false; // GUARD
+            int exit = -1; // GUARD, CALLOUT
+            int callout = -1; // CALLOUT
+        };
+
+    private:
+        Interpreter& interpreter;
+        WhileStmt* loop;
+        std::shared_ptr<LoopTrace> trace = std::make_shared<LoopTrace>();
+        std::vector<Op> ops;
+        std::map<Expr*, int> bound; // variable read or written by each MutExpr and AssignExpr
+        int scope = -1;
+
+        // where recording is in each statement list it descended into
+        struct Position
+        {
+            const std::shared_ptr<Stmt>* end;
+            const std::shared_ptr<Stmt>* at;
+            int scope;
+        };
+
+        std::vector<Position> positions;
+
+        TraceVariable place(const Token& name, const Binding& binding);
+        int variable(const TraceVariable& variable);
+        bool is_number(const Token& name, const Binding& binding);
+        int numeric(Expr* expr, bool pure, std::vector<std::pair<Expr*, TraceVariable>>& uses);
+        int condition(Expr* expr, std::vector<std::pair<Expr*, TraceVariable>>& uses);
+        bool native(Expr* expr, bool is_condition);
+        int exit(bool rerun);
+
+        ExecResult record(const std::shared_ptr<Stmt>* begin, const std::shared_ptr<Stmt>* end);
+        ExecResult record(Stmt* stmt);
+        ExecResult callout(Stmt* stmt, std::shared_ptr<TraceVariable> declares = nullptr);
+
+    public:
+        TraceRecorder(Interpreter& interpreter, WhileStmt* loop);
+
+        // runs the loop body once, installs the trace on the loop if it compiled
+        ExecResult record();
+};
+
+#endif
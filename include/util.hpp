@@ -29,5 +29,6 @@
 extern void run(const std::string& text, Interpreter& interpreter);
 extern void run_file(const std::string& filename, Interpreter& interpreter);
 extern void run_prompt(Interpreter& interpreter);
+extern void emit_file(const std::string& path, size_t max_stack);
 
 #endif
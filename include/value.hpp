@@ -0,0 +1,193 @@
+//------------------------------------//
+// Copyright 2024 Nam Nguyen
+// Licensed under Apache License v2.0
+//------------------------------------//
+
+#ifndef VALUE_HPP
+#define VALUE_HPP
+
+#pragma once
+#include <cstdint>
+#include <cstring>
+#include <cstddef>
+#include <string>
+#include <utility>
+
+enum class ObjectType : uint8_t
+{
+    STRING,
+    LIST,
+    FUNCTION,
+    CLASS,
+    INSTANCE,
+    NATIVE,
+    VM_FUNCTION,
+    VM_CLOSURE,
+    VM_CLASS,
+    VM_INSTANCE,
+    VM_BOUND_METHOD,
+    AOT_FUNCTION,
+    AOT_CLASS,
+    AOT_INSTANCE,
+    CELL
+};
+
+// header of every heap allocated value, kept alive by the Values and Refs pointing at it
+struct Object
+{
+    const ObjectType type;
+    uint32_t references = 0;
+
+    Object(ObjectType type) : type(type) {}
+    Object(const Object&) = delete;
+    Object& operator=(const Object&) = delete;
+    virtual ~Object() = default;
+};
+
+struct StringObject : Object
+{
+    const std::string value;
+
+    StringObject(std::string value) : Object(ObjectType::STRING), value(std::move(value)) {}
+};
+
+inline void retain(Object* object)
+{
+    object->references++;
+}
+
+// deletes an object nobody references anymore, without recursing into the objects it held
+void destroy(Object* object);
+
+inline void release(Object* object)
+{
+    if (--object->references == 0)
+        destroy(object);
+}
+
+// intrusive smart pointer for holding objects by their concrete type
+template <typename T>
+class Ref
+{
+    T* pointer = nullptr;
+
+    public:
+        Ref() = default;
+        Ref(std::nullptr_t) {}
+        Ref(T* pointer) : pointer(pointer) { if (pointer != nullptr) retain(pointer); }
+        Ref(const Ref& other) : Ref(other.pointer) {}
+        Ref(Ref&& other) noexcept : pointer(std::exchange(other.pointer, nullptr)) {}
+
+        template <typename U>
+        Ref(const Ref<U>& other) : Ref(other.get()) {}
+
+        ~Ref() { if (pointer != nullptr) release(pointer); }
+
+        Ref& operator=(Ref other) noexcept
+        {
+            std::swap(pointer, other.pointer);
+            return *this;
+        }
+
+        T* get() const { return pointer; }
+        T* operator->() const { return pointer; }
+        T& operator*() const { return *pointer; }
+        explicit operator bool() const { return pointer != nullptr; }
+        bool operator==(std::nullptr_t) const { return pointer == nullptr; }
+        bool operator!=(std::nullptr_t) const { return pointer != nullptr; }
+};
+
+// 64 bit NaN-boxed value
+// doubles are stored as they are, everything else lives in the payload of a quiet NaN:
+// nil and booleans in the low bits, integers in the low 48 bits with bit 48 set,
+// object pointers in the low 48 bits with the sign bit set
+class Value
+{
+    static constexpr uint64_t SIGN_BIT = 0x8000000000000000;
+    static constexpr uint64_t QNAN = 0x7ffc000000000000;
+
+    static constexpr uint64_t NIL_BITS = QNAN | 1;
+    static constexpr uint64_t FALSE_BITS = QNAN | 2;
+    static constexpr uint64_t TRUE_BITS = QNAN | 3;
+    static constexpr uint64_t INT_BITS = QNAN | 0x0001000000000000;
+    static constexpr uint64_t INT_PAYLOAD = 0x0000ffffffffffff;
+    static constexpr uint64_t OBJECT_BITS = SIGN_BIT | QNAN;
+
+    uint64_t bits;
+
+    public:
+        static constexpr int64_t MIN_INT = -(int64_t(1) << 47);
+        static constexpr int64_t MAX_INT = (int64_t(1) << 47) - 1;
+
+        Value() : bits(NIL_BITS) {}
+        Value(std::nullptr_t) : bits(NIL_BITS) {}
+        Value(bool boolean) : bits(boolean ? TRUE_BITS : FALSE_BITS) {}
+        Value(double number) { std::memcpy(&bits, &number, sizeof(double)); }
+        Value(Object* object) : bits(OBJECT_BITS | reinterpret_cast<uintptr_t>(object)) { retain(object); }
+        Value(std::string string) : Value(new StringObject(std::move(string))) {}
+        Value(const char* string) : Value(std::string(string)) {}
+
+        // an integer that doesn't fit in 48 bits becomes a double
+        static Value integer(int64_t number)
+        {
+            if (number < MIN_INT || number > MAX_INT)
+                return static_cast<double>(number);
+
+            Value value;
+            value.bits = INT_BITS | (static_cast<uint64_t>(number) & INT_PAYLOAD);
+            return value;
+        }
+
+        template <typename T>
+        Value(const Ref<T>& ref) : Value(static_cast<Object*>(ref.get())) {}
+
+        Value(const Value& other) : bits(other.bits)
+        {
+            if (is_object())
+                retain(as_object());
+        }
+
+        Value(Value&& other) noexcept : bits(std::exchange(other.bits, NIL_BITS)) {}
+
+        ~Value()
+        {
+            if (is_object())
+                release(as_object());
+        }
+
+        Value& operator=(Value other) noexcept
+        {
+            std::swap(bits, other.bits);
+            return *this;
+        }
+
+        bool is_nil() const { return bits == NIL_BITS; }
+        bool is_bool() const { return (bits | 1) == TRUE_BITS; }
+        bool is_double() const { return (bits & QNAN) != QNAN; }
+        bool is_int() const { return (bits >> 48) == (INT_BITS >> 48); }
+        bool is_number() const { return is_double() || is_int(); }
+        bool is_object() const { return (bits & OBJECT_BITS) == OBJECT_BITS; }
+        bool is_object(ObjectType type) const { return is_object() && as_object()->type == type; }
+        bool is_string() const { return is_object(ObjectType::STRING); }
+        bool is_falsey() const { return bits == NIL_BITS || bits == FALSE_BITS; }
+
+        bool as_bool() const { return bits == TRUE_BITS; }
+        double as_double() const
+        {
+            double number;
+            std::memcpy(&number, &bits, sizeof(double));
+            return number;
+        }
+        int64_t as_int() const { return static_cast<int64_t>(bits << 16) >> 16; }
+        double as_number() const { return is_int() ? static_cast<double>(as_int()) : as_double(); }
+        Object* as_object() const { return reinterpret_cast<Object*>(bits & ~OBJECT_BITS); }
+        const std::string& as_string() const { return as<StringObject>()->value; }
+
+        template <typename T>
+        T* as() const { return static_cast<T*>(as_object()); }
+
+        // same payload, for nil, booleans, integers and object identity
+        bool same(const Value& other) const { return bits == other.bits; }
+};
+
+#endif
@@ -0,0 +1,124 @@
+//------------------------------------//
+// Copyright 2024 Nam Nguyen
+// Licensed under Apache License v2.0
+//------------------------------------//
+
+#ifndef VM_HPP
+#define VM_HPP
+
+#pragma once
+#include <map>
+#include <memory>
+#include <string>
+#include <vector>
+#include <unordered_map>
+
+#include "chunk.hpp"
+#include "callable.hpp"
+#include "expr.hpp"
+#include "stmt.hpp"
+#include "token.hpp"
+#include "value.hpp"
+
+class Interpreter;
+
+// compiled function prototype, shared by every closure created from it
+struct VmFunction : Object
+{
+    std::string name;
+    int arity = 0;
+    int upvalue_count = 0;
+    Chunk chunk;
+
+    VmFunction() : Object(ObjectType::VM_FUNCTION) {}
+};
+
+// a captured variable, points into the stack while open and owns the value once closed
+struct VmUpvalue
+{
+    size_t slot;
+    Value closed;
+    bool is_open = true;
+};
+
+struct VmClosure : Object
+{
+    Ref<VmFunction> function;
+    std::vector<std::shared_ptr<VmUpvalue>> upvalues;
+
+    VmClosure(Ref<VmFunction> function) : Object(ObjectType::VM_CLOSURE), function(std::move(function)) {}
+    std::string to_string();
+};
+
+struct VmClass : Object
+{
+    std::string name;
+    std::map<std::string, Ref<VmClosure>> methods;
+
+    VmClass(std::string name) : Object(ObjectType::VM_CLASS), name(std::move(name)) {}
+};
+
+struct VmInstance : Object
+{
+    Ref<VmClass> klass;
+    std::map<std::string, Value> fields;
+
+    VmInstance(Ref<VmClass> klass) : Object(ObjectType::VM_INSTANCE), klass(std::move(klass)) {}
+};
+
+struct VmBoundMethod : Object
+{
+    Value receiver;
+    Ref<VmClosure> method;
+
+    VmBoundMethod(Value receiver, Ref<VmClosure> method)
+        : Object(ObjectType::VM_BOUND_METHOD), receiver(std::move(receiver)), method(std::move(method)) {}
+};
+
+struct CallFrame
+{
+    Ref<VmClosure> closure;
+    const uint8_t* ip;
+    size_t base; // stack index of slot 0
+};
+
+// a global in the slot global_slot() gave its name
+struct VmGlobal
+{
+    Value value;
+    bool defined = false;
+};
+
+class VM
+{
+    private:
+
+        Interpreter& interpreter;
+        std::vector<Value> stack;
+        std::vector<CallFrame> frames;
+        std::vector<VmGlobal> globals; // indexed by global slot
+        std::map<size_t, std::shared_ptr<VmUpvalue>> open_upvalues; // keyed by stack slot
+        Token error_token{TOKEN_EOF, "", nullptr, 0};
+
+        void run(size_t frame_floor);
+        void call_value(Value callee, int arg_count);
+        void call(Ref<VmClosure> closure, int arg_count);
+        std::shared_ptr<VmUpvalue> capture_upvalue(size_t slot);
+        void close_upvalues(size_t last);
+        void define_global(size_t slot, Value value);
+        Value& upvalue_value(VmUpvalue& upvalue);
+        void invoke(const std::string& name, int arg_count);
+        void bind_method(VmClass* klass, const std::string& name);
+        Value execute_script(Ref<VmFunction> script);
+        void reset();
+        const Token& current_token();
+        [[noreturn]] void runtime_error(const std::string& msg);
+        std::string stringify(const Value& value);
+
+    public:
+        VM(Interpreter& interpreter);
+        void interpret(const std::vector<std::shared_ptr<Stmt>>& statements);
+        std::string interpret(const std::shared_ptr<Expr>& expr);
+};
+
+#endif
@@ -0,0 +1,1264 @@
+//------------------------------------//
+// Copyright 2024 Nam Nguyen
+// Licensed under Apache License v2.0
+//------------------------------------//
+
+#include <cstdio>
+#include <fstream>
+
+#include "aot.hpp"
+#include "lexer.hpp"
+#include "parser.hpp"
+#include "resolver.hpp"
+
+// whether evaluating expr could write a variable, anything read before it has to be copied first
+static bool may_write(Expr* expr)
+{
+    if (expr == nullptr)
+        return false;
+
+    switch (generic_kind(expr->kind))
+    {
+        case ExprKind::ASSIGN:
+        case ExprKind::CALL:
+        case ExprKind::SET:
+            return true;
+
+        case ExprKind::BINARY:
+        {
+            BinaryExpr* binary = static_cast<BinaryExpr*>(expr);
+            return may_write(binary->left.get()) || may_write(binary->right.get());
+        }
+
+        case ExprKind::LOGICAL:
+        {
+            LogicalExpr* logical = static_cast<LogicalExpr*>(expr);
+            return may_write(logical->left.get()) || may_write(logical->right.get());
+        }
+
+        case ExprKind::GROUPING: return may_write(static_cast<GroupingExpr*>(expr)->expression.get());
+        case ExprKind::UNARY: return may_write(static_cast<UnaryExpr*>(expr)->right.get());
+        case ExprKind::GET: return may_write(static_cast<GetExpr*>(expr)->object.get());
+
+        case ExprKind::LIST:
+            for (const std::shared_ptr<Expr>& element : static_cast<ListExpr*>(expr)->elements)
+                if (may_write(element.get()))
+                    return true;
+            return false;
+
+        case ExprKind::SUBSCRIPT:
+        {
+            SubscriptExpr* subscript = static_cast<SubscriptExpr*>(expr);
+            return subscript->value != nullptr || may_write(subscript->name.get()) || may_write(subscript->index.get());
+        }
+
+        default:
+            return false;
+    }
+}
+
+static std::string quote(const std::string& text)
+{
+    std::string result = "\"";
+
+    for (unsigned char c : text)
+    {
+        if (c == '"' || c == '\\')
+        {
+            result += '\\';
+            result += c;
+        }
+        else if (c < 32 || c >= 127)
+        {
+            char escape[8];
+            snprintf(escape, sizeof(escape), "\\%03o", c);
+            result += escape;
+        }
+        else
+        {
+            result += c;
+        }
+    }
+
+    return result + "\"";
+}
+
+static std::string number(double value)
+{
+    char text[32];
+    snprintf(text, sizeof(text), "%.17g", value);
+
+    std::string result = text;
+    if (result.find_first_of(".e") == std::string::npos)
+        result += ".0";
+
+    return "Value(" + result + ")";
+}
+
+bool AotCompiler::Scope::has_environment() const
+{
+    for (bool slot : captured)
+        if (slot)
+            return true;
+
+    return false;
+}
+
+std::vector<std::shared_ptr<Stmt>> AotCompiler::parse(const std::string& path)
+{
+    std::ifstream file{path};
+    std::string line;
+    std::string source;
+
+    while (std::getline(file, line))
+        source += line + "\n";
+
+    Lexer lexer{source};
+    std::vector<Token> tokens = lexer.scan_tokens();
+
+    Parser parser{tokens};
+    std::vector<std::shared_ptr<Stmt>> statements = parser.parse();
+
+    if (Error::has_error)
+        return {};
+
+    std::string base_dir = path;
+    Resolver resolver{base_dir};
+    resolver.resolve(statements);
+
+    if (Error::has_error)
+        return {};
+
+    return statements;
+}
+
+AotCompiler::Module* AotCompiler::module(const std::string& path)
+{
+    auto element = modules.find(path);
+
+    if (element == modules.end())
+    {
+        Module module;
+        module.statements = parse(path);
+        module.name = "module" + std::to_string(++counter);
+        element = modules.emplace(path, std::move(module)).first;
+    }
+
+    return &element->second;
+}
+
+AotCompiler::Scope& AotCompiler::enter(const void* node, Role role, int slot_count)
+{
+    auto [element, inserted] = scopes.try_emplace({node, role});
+    Scope& scope = element->second;
+
+    if (inserted)
+    {
+        scope.id = ++counter;
+        scope.frame = frame_key;
+        scope.names.resize(slot_count);
+        scope.captured.resize(slot_count, false);
+    }
+
+    stack.push_back(&scope);
+    return scope;
+}
+
+bool AotCompiler::is_native(const std::string& name)
+{
+    Value value;
+    bool defined = false;
+
+    natives.native(name.c_str(), value, defined);
+    return defined;
+}
+
+// first pass, finds the locals closures capture and the globals only ever set by one fun
+
+void AotCompiler::analyze(const std::vector<std::shared_ptr<Stmt>>& statements)
+{
+    for (const std::shared_ptr<Stmt>& statement : statements)
+        analyze(statement.get());
+}
+
+void AotCompiler::analyze(Stmt* stmt)
+{
+    switch (stmt->kind)
+    {
+        case StmtKind::BLOCK:
+        {
+            BlockStmt* block = static_cast<BlockStmt*>(stmt);
+
+            if (!block->scoped)
+            {
+                analyze(block->statements);
+                break;
+            }
+
+            enter(block, BODY, block->slot_count);
+            analyze(block->statements);
+            stack.pop_back();
+            break;
+        }
+
+        case StmtKind::EXPRESSION:
+            analyze(static_cast<ExpressionStmt*>(stmt)->expression.get());
+            break;
+
+        case StmtKind::PRINT:
+            analyze(static_cast<PrintStmt*>(stmt)->expression.get());
+            break;
+
+        case StmtKind::MUT:
+        {
+            MutStmt* mut = static_cast<MutStmt*>(stmt);
+            declare(mut->slot, mut->name.lexeme);
+
+            if (mut->slot < 0)
+                definitions[mut->name.lexeme] += 2;
+
+            if (mut->initializer != nullptr)
+                analyze(mut->initializer.get());
+            break;
+        }
+
+        case StmtKind::IF:
+        {
+            IfStmt* branch = static_cast<IfStmt*>(stmt);
+            analyze(branch->condition.get());
+            analyze(branch->then_branch.get());
+
+            if (branch->else_branch != nullptr)
+                analyze(branch->else_branch.get());
+            break;
+        }
+
+        case StmtKind::WHILE:
+        {
+            WhileStmt* loop = static_cast<WhileStmt*>(stmt);
+            analyze(loop->condition.get());
+            analyze(loop->body.get());
+            break;
+        }
+
+        case StmtKind::FUNCTION:
+        {
+            FunctionStmt* function = static_cast<FunctionStmt*>(stmt);
+            declare(function->slot, function->name.lexeme);
+
+            if (function->slot < 0)
+            {
+                definitions[function->name.lexeme] += 1;
+                global_functions[function->name.lexeme] = function->fn.get();
+            }
+
+            analyze_function(function->fn.get(), false, false);
+            break;
+        }
+
+        case StmtKind::RETURN:
+        {
+            ReturnStmt* ret = static_cast<ReturnStmt*>(stmt);
+
+            if (ret->value != nullptr)
+                analyze(ret->value.get());
+            break;
+        }
+
+        case StmtKind::BREAK:
+            break;
+
+        case StmtKind::CLASS:
+        {
+            ClassStmt* klass = static_cast<ClassStmt*>(stmt);
+            declare(klass->slot, klass->name.lexeme);
+
+            if (klass->slot < 0)
+                definitions[klass->name.lexeme] += 2;
+
+            if (klass->superclass != nullptr)
+                reference(klass->superclass->binding, klass->superclass->name.lexeme);
+
+            for (const std::shared_ptr<FunctionStmt>& method : klass->methods)
+                analyze_function(method->fn.get(), true, klass->superclass != nullptr);
+            break;
+        }
+
+        case StmtKind::IMPORT:
+        {
+            Module* imported = module(static_cast<ImportStmt*>(stmt)->target->value.as_string());
+
+            if (!imported->analyzed)
+            {
+                imported->analyzed = true;
+
+                std::vector<Scope*> enclosing = std::move(stack);
+                const void* enclosing_frame = frame_key;
+
+                stack.clear();
+                frame_key = &imported->statements;
+                analyze(imported->statements);
+
+                stack = std::move(enclosing);
+                frame_key = enclosing_frame;
+            }
+            break;
+        }
+    }
+}
+
+void AotCompiler::analyze(Expr* expr)
+{
+    switch (generic_kind(expr->kind))
+    {
+        case ExprKind::ASSIGN:
+        {
+            AssignExpr* assign = static_cast<AssignExpr*>(expr);
+            analyze(assign->value.get());
+
+            if (assign->binding.depth < 0)
+                definitions[assign->name.lexeme] += 2;
+
+            reference(assign->binding, assign->name.lexeme);
+            break;
+        }
+
+        case ExprKind::BINARY:
+        {
+            BinaryExpr* binary = static_cast<BinaryExpr*>(expr);
+            analyze(binary->left.get());
+            analyze(binary->right.get());
+            break;
+        }
+
+        case ExprKind::GROUPING:
+            analyze(static_cast<GroupingExpr*>(expr)->expression.get());
+            break;
+
+        case ExprKind::LITERAL:
+            break;
+
+        case ExprKind::UNARY:
+            analyze(static_cast<UnaryExpr*>(expr)->right.get());
+            break;
+
+        case ExprKind::MUT:
+        {
+            MutExpr* mut = static_cast<MutExpr*>(expr);
+            reference(mut->binding, mut->name.lexeme);
+            break;
+        }
+
+        case ExprKind::LOGICAL:
+        {
+            LogicalExpr* logical = static_cast<LogicalExpr*>(expr);
+            analyze(logical->left.get());
+            analyze(logical->right.get());
+            break;
+        }
+
+        case ExprKind::CALL:
+        {
+            CallExpr* call = static_cast<CallExpr*>(expr);
+            analyze(call->callee.get());
+
+            for (const std::shared_ptr<Expr>& argument : call->arguments)
+                analyze(argument.get());
+            break;
+        }
+
+        case ExprKind::FUNCTION:
+            analyze_function(static_cast<FunctionExpr*>(expr), false, false);
+            break;
+
+        case ExprKind::GET:
+            analyze(static_cast<GetExpr*>(expr)->object.get());
+            break;
+
+        case ExprKind::SET:
+        {
+            SetExpr* set = static_cast<SetExpr*>(expr);
+            analyze(set->object.get());
+            analyze(set->value.get());
+            break;
+        }
+
+        case ExprKind::THIS:
+        {
+            ThisExpr* self = static_cast<ThisExpr*>(expr);
+            reference(self->binding, "this");
+            break;
+        }
+
+        case ExprKind::SUPER:
+        {
+            SuperExpr* super = static_cast<SuperExpr*>(expr);
+            reference(super->binding, "super");
+            reference(Binding{super->binding.depth - 1, 0}, "this");
+            break;
+        }
+
+        case ExprKind::LIST:
+            for (const std::shared_ptr<Expr>& element : static_cast<ListExpr*>(expr)->elements)
+                analyze(element.get());
+            break;
+
+        case ExprKind::SUBSCRIPT:
+        {
+            SubscriptExpr* subscript = static_cast<SubscriptExpr*>(expr);
+            analyze(subscript->name.get());
+            analyze(subscript->index.get());
+
+            if (subscript->value != nullptr)
+                analyze(subscript->value.get());
+            break;
+        }
+
+        default:
+            break;
+    }
+}
+
+void AotCompiler::analyze_function(FunctionExpr* fn, bool is_method, bool has_super)
+{
+    const void* enclosing = frame_key;
+    size_t base = stack.size();
+
+    frame_key = fn;
+
+    if (has_super)
+        enter(fn, SUPER, 1).names[0] = "super";
+
+    if (is_method)
+        enter(fn, THIS, 1).names[0] = "this";
+
+    Scope& body = enter(fn, BODY, fn->slot_count);
+
+    for (size_t i = 0; i < fn->parameters.size(); i++)
+        body.names[i] = fn->parameters[i].lexeme;
+
+    analyze(fn->body);
+
+    stack.resize(base);
+    frame_key = enclosing;
+}
+
+void AotCompiler::reference(const Binding& binding, const std::string& name)
+{
+    if (binding.depth < 0)
+    {
+        globals.insert(name);
+        return;
+    }
+
+    Scope* scope = stack[stack.size() - 1 - binding.depth];
+
+    if (scope->frame != frame_key)
+        scope->captured[binding.slot] = true;
+}
+
+void AotCompiler::declare(int slot, const std::string& name)
+{
+    if (slot < 0)
+        globals.insert(name);
+    else
+        stack.back()->names[slot] = name;
+}
+
+// second pass, writes out the C++
+
+void AotCompiler::line(const std::string& text)
+{
+    *out << std::string(indent * 4, ' ') << text << "\n";
+}
+
+std::string AotCompiler::temp(const std::string& init)
+{
+    std::string name = "t" + std::to_string(++counter);
+    line("Value " + name + " = " + init + ";");
+    return name;
+}
+
+AotCompiler::Operand AotCompiler::stable(Operand operand)
+{
+    if (operand.place)
+        return {temp(operand.code), false};
+
+    return operand;
+}
+
+std::string AotCompiler::constant(const std::string& text)
+{
+    std::string name = "s" + std::to_string(++counter);
+    constants.push_back("static const Value " + name + " = std::string(" + quote(text) + ", " + std::to_string(text.size()) + ");");
+    return name;
+}
+
+std::string AotCompiler::name_of(const std::string& property)
+{
+    auto element = names.find(property);
+
+    if (element != names.end())
+        return element->second;
+
+    std::string name = "n" + std::to_string(++counter);
+    constants.push_back("static const std::string " + name + " = " + quote(property) + ";");
+    names[property] = name;
+    return name;
+}
+
+std::string AotCompiler::environment(Scope* scope)
+{
+    return "e" + std::to_string(scope->id);
+}
+
+std::string AotCompiler::local(Scope* scope, int slot)
+{
+    return "l_" + scope->names[slot] + "_" + std::to_string(scope->id);
+}
+
+// where a slot lives: a C++ local, an environment of this frame or one the closure captured
+std::string AotCompiler::storage(Scope* scope, int slot)
+{
+    std::string index = std::to_string(slot);
+
+    if (scope->frame == frame->key)
+        return scope->captured[slot] ? environment(scope) + "->slot(" + index + ")" : local(scope, slot);
+
+    int hops = 0;
+
+    for (size_t i = frame->base; i-- > 0 && stack[i] != scope;)
+        if (stack[i]->has_environment())
+            hops++;
+
+    if (hops == 0)
+        return "self->closure->slot(" + index + ")";
+
+    return "self->closure->ancestor(" + std::to_string(hops) + ")->slot(" + index + ")";
+}
+
+// the environment a function declared here closes over
+std::string AotCompiler::closure()
+{
+    for (size_t i = stack.size(); i-- > frame->base;)
+        if (stack[i]->has_environment())
+            return environment(stack[i]);
+
+    return frame->is_function ? "self->closure" : "nullptr";
+}
+
+void AotCompiler::open(Scope& scope, const std::string& enclosing, int first_local)
+{
+    if (scope.has_environment())
+        line("auto " + environment(&scope) + " = std::make_shared<Environment>(" + enclosing + ", " + std::to_string(scope.captured.size()) + ");");
+
+    for (size_t slot = first_local; slot < scope.captured.size(); slot++)
+        if (!scope.captured[slot])
+            line("Value " + local(&scope, slot) + ";");
+}
+
+// the C++ function a call goes straight to, when the callee is a global only a single fun ever sets
+std::string AotCompiler::direct(CallExpr* expr)
+{
+    if (generic_kind(expr->callee->kind) != ExprKind::MUT)
+        return "";
+
+    MutExpr* callee = static_cast<MutExpr*>(expr->callee.get());
+    const std::string& name = callee->name.lexeme;
+
+    if (callee->binding.depth >= 0 || definitions[name] != 1 || is_native(name))
+        return "";
+
+    auto element = global_functions.find(name);
+
+    if (element == global_functions.end() || element->second->parameters.size() != expr->arguments.size())
+        return "";
+
+    auto function = functions.find(element->second);
+
+    if (function != functions.end())
+        return function->second;
+
+    return functions[element->second] = "f" + std::to_string(++counter) + "_" + name;
+}
+
+// return f(...) where f is the function being generated, the arguments become its parameters and it starts over
+bool AotCompiler::restart(CallExpr* expr)
+{
+    if (!frame->restartable || frame->parameters.size() != expr->arguments.size() || direct(expr) != frame->name)
+        return false;
+
+    std::vector<std::string> values;
+
+    for (const Operand& argument : arguments(expr->arguments))
+        values.push_back(temp(argument.code));
+
+    for (size_t i = 0; i < values.size(); i++)
+        line(frame->parameters[i] + " = std::move(" + values[i] + ");");
+
+    line("goto restart;");
+    frame->restarts = true;
+    return true;
+}
+
+std::string AotCompiler::compile(const std::vector<std::shared_ptr<Stmt>>& statements)
+{
+    frame_key = &statements;
+    analyze(statements);
+
+    emit_frame("script", &statements, statements);
+
+    std::ostringstream result;
+    result << "// generated by nimble --emit-c\n";
+    result << "#include \"runtime.hpp\"\n\n";
+    result << "static Runtime rt;\n\n";
+
+    for (const std::string& global : globals)
+        result << "static Value g_" << global << ";\n" << "static bool d_" << global << " = false;\n";
+
+    result << "\n";
+
+    for (const std::string& constant : constants)
+        result << constant << "\n";
+
+    result << "\n" << prototypes.str() << "\n" << definitions_out.str();
+
+    result << "int main()\n{\n";
+
+    for (const std::string& global : globals)
+        if (is_native(global))
+            result << "    rt.native(" << quote(global) << ", g_" << global << ", d_" << global << ");\n";
+
+    result << "    return rt.run(script, " << max_stack << ");\n}\n";
+    return result.str();
+}
+
+// the script and every module it imports become a void function
+void AotCompiler::emit_frame(const std::string& name, const void* key, const std::vector<std::shared_ptr<Stmt>>& statements)
+{
+    std::vector<Scope*> enclosing_stack = std::move(stack);
+    std::ostringstream* enclosing_out = out;
+    Frame* enclosing_frame = frame;
+    int enclosing_indent = indent;
+
+    std::ostringstream body;
+    Frame current{key, 0};
+
+    stack.clear();
+    frame = &current;
+
+    for (const std::shared_ptr<Stmt>& statement : statements)
+    {
+        // a break outside of any loop skips the rest of the statement it's in
+        std::ostringstream code;
+        current.label = "next" + std::to_string(++counter);
+        current.label_used = false;
+        out = &code;
+        indent = 2;
+
+        emit(statement.get());
+
+        if (current.label_used)
+        {
+            body << "    {\n" << code.str() << "    }\n    " << current.label << ":;\n";
+            continue;
+        }
+
+        std::istringstream lines{code.str()};
+        std::string text;
+
+        while (std::getline(lines, text))
+            body << text.substr(4) << "\n";
+    }
+
+    prototypes << "static void " << name << "();\n";
+    definitions_out << "static void " << name << "()\n{\n" << body.str() << "}\n\n";
+
+    stack = std::move(enclosing_stack);
+    out = enclosing_out;
+    frame = enclosing_frame;
+    indent = enclosing_indent;
+}
+
+std::string AotCompiler::emit_function(FunctionExpr* fn, const std::string& name, bool is_method, bool has_super, bool is_initializer)
+{
+    auto named = functions.find(fn);
+    std::string function = named != functions.end() ? named->second : "f" + std::to_string(++counter) + (name.empty() ? "" : "_" + name);
+
+    functions[fn] = function;
+
+    if (!generated.insert(fn).second)
+        return function;
+
+    std::ostringstream* enclosing_out = out;
+    Frame* enclosing_frame = frame;
+    int enclosing_indent = indent;
+
+    std::ostringstream body;
+    Frame current{fn, stack.size()};
+    current.is_function = true;
+    current.is_initializer = is_initializer;
+    current.name = function;
+
+    frame = &current;
+    out = &body;
+    indent = 1;
+
+    if (has_super)
+    {
+        std::string enclosing = closure();
+        Scope& scope = enter(fn, SUPER, 1);
+
+        if (scope.has_environment())
+        {
+            open(scope, enclosing, 1);
+            line(environment(&scope) + "->slot(0) = self->superclass;");
+        }
+        else
+        {
+            line("const Value& " + local(&scope, 0) + " = self->superclass;");
+        }
+    }
+
+    if (is_method)
+    {
+        std::string enclosing = closure();
+        Scope& scope = enter(fn, THIS, 1);
+
+        if (scope.has_environment())
+        {
+            open(scope, enclosing, 1);
+            line(environment(&scope) + "->slot(0) = receiver;");
+        }
+        else
+        {
+            line("const Value& " + local(&scope, 0) + " = receiver;");
+        }
+    }
+
+    std::string enclosing = closure();
+    Scope& scope = enter(fn, BODY, fn->slot_count);
+    std::string parameters;
+    std::string forward;
+
+    for (size_t i = 0; i < fn->parameters.size(); i++)
+    {
+        std::string parameter = scope.captured[i] ? "p" + std::to_string(i) : local(&scope, i);
+        parameters += ", Value " + parameter;
+        forward += ", arguments[" + std::to_string(i) + "]";
+    }
+
+    open(scope, enclosing, fn->parameters.size());
+
+    for (size_t i = 0; i < fn->parameters.size(); i++)
+        if (scope.captured[i])
+            line(environment(&scope) + "->slot(" + std::to_string(i) + ") = std::move(p" + std::to_string(i) + ");");
+
+    // with nothing captured every call starts from the same C++ locals, so the function can start over in place
+    size_t start = body.tellp();
+
+    current.restartable = !is_method && !scope.has_environment();
+
+    for (size_t i = 0; i < fn->parameters.size(); i++)
+        current.parameters.push_back(local(&scope, i));
+
+    for (const std::shared_ptr<Stmt>& statement : fn->body)
+        emit(statement.get());
+
+    line(is_initializer ? "return receiver;" : "return Value();");
+
+    std::string code = body.str();
+
+    if (current.restarts)
+        code.insert(start, "restart:;\n");
+
+    stack.resize(current.base);
+    out = enclosing_out;
+    frame = enclosing_frame;
+    indent = enclosing_indent;
+
+    std::string signature = "static Value " + function + "(AotFunction* self, const Value& receiver" + parameters + ")";
+    std::string entry = "static Value " + function + "_entry(AotFunction* self, const Value& receiver, Value* arguments)";
+
+    prototypes << signature << ";\n" << entry << ";\n";
+    definitions_out << signature << "\n{\n" << code << "}\n\n";
+    definitions_out << entry << "\n{\n    return " << function << "(self, receiver" << forward << ");\n}\n\n";
+
+    return function;
+}
+
+void AotCompiler::emit(Stmt* stmt)
+{
+    switch (stmt->kind)
+    {
+        case StmtKind::BLOCK:
+        {
+            BlockStmt* block = static_cast<BlockStmt*>(stmt);
+            std::string enclosing = closure();
+
+            line("{");
+            indent++;
+
+            if (block->scoped)
+                open(enter(block, BODY, block->slot_count), enclosing, 0);
+
+            for (const std::shared_ptr<Stmt>& statement : block->statements)
+                emit(statement.get());
+
+            if (block->scoped)
+                stack.pop_back();
+
+            indent--;
+            line("}");
+            break;
+        }
+
+        case StmtKind::EXPRESSION:
+            expression(static_cast<ExpressionStmt*>(stmt)->expression.get());
+            break;
+
+        case StmtKind::PRINT:
+            line("rt.print(" + expression(static_cast<PrintStmt*>(stmt)->expression.get()).code + ");");
+            break;
+
+        case StmtKind::MUT:
+        {
+            MutStmt* mut = static_cast<MutStmt*>(stmt);
+            std::string value = mut->initializer != nullptr ? expression(mut->initializer.get()).code : "Value()";
+            define(mut->slot, mut->name.lexeme, value);
+            break;
+        }
+
+        case StmtKind::IF:
+        {
+            IfStmt* branch = static_cast<IfStmt*>(stmt);
+            line("if (rt.truthy(" + expression(branch->condition.get()).code + "))");
+            emit_branch(branch->then_branch.get());
+
+            if (branch->else_branch != nullptr)
+            {
+                line("else");
+                emit_branch(branch->else_branch.get());
+            }
+            break;
+        }
+
+        case StmtKind::WHILE:
+        {
+            WhileStmt* loop = static_cast<WhileStmt*>(stmt);
+
+            line("while (true)");
+            line("{");
+            indent++;
+
+            line("if (!rt.truthy(" + expression(loop->condition.get()).code + "))");
+            line("    break;");
+
+            frame->loops++;
+            emit(loop->body.get());
+            frame->loops--;
+
+            indent--;
+            line("}");
+            break;
+        }
+
+        case StmtKind::FUNCTION:
+        {
+            FunctionStmt* function = static_cast<FunctionStmt*>(stmt);
+            FunctionExpr* fn = function->fn.get();
+            std::string code = emit_function(fn, function->name.lexeme, false, false, false);
+            std::string value = temp("new AotFunction(" + quote(function->name.lexeme) + ", " + std::to_string(fn->parameters.size()) + ", &" + code + "_entry, " + closure() + ")");
+
+            define(function->slot, function->name.lexeme, value);
+            break;
+        }
+
+        case StmtKind::RETURN:
+        {
+            ReturnStmt* ret = static_cast<ReturnStmt*>(stmt);
+
+            if (ret->tail && restart(static_cast<CallExpr*>(ret->value.get())))
+                break;
+
+            std::string value = ret->value != nullptr ? expression(ret->value.get()).code : "Value()";
+            line(frame->is_initializer ? "return receiver;" : "return " + value + ";");
+            break;
+        }
+
+        case StmtKind::BREAK:
+            if (frame->loops > 0)
+            {
+                line("break;");
+            }
+            else if (frame->is_function) // the function just returns nil
+            {
+                line(frame->is_initializer ? "return receiver;" : "return Value();");
+            }
+            else
+            {
+                line("goto " + frame->label + ";");
+                frame->label_used = true;
+            }
+            break;
+
+        case StmtKind::CLASS:
+            emit_class(static_cast<ClassStmt*>(stmt));
+            break;
+
+        case StmtKind::IMPORT:
+        {
+            Module* imported = module(static_cast<ImportStmt*>(stmt)->target->value.as_string());
+
+            if (!imported->compiled)
+            {
+                imported->compiled = true;
+                emit_frame(imported->name, &imported->statements, imported->statements);
+            }
+
+            line(imported->name + "();");
+            break;
+        }
+    }
+}
+
+void AotCompiler::emit_branch(Stmt* stmt)
+{
+    line("{");
+    indent++;
+    emit(stmt);
+    indent--;
+    line("}");
+}
+
+void AotCompiler::emit_class(ClassStmt* stmt)
+{
+    const std::string& name = stmt->name.lexeme;
+    std::string klass;
+
+    if (stmt->superclass != nullptr)
+    {
+        Operand superclass = expression(stmt->superclass.get());
+        klass = temp("rt.make_class(" + quote(name) + ", " + superclass.code + ", " + std::to_string(stmt->superclass->name.line) + ")");
+    }
+    else
+    {
+        klass = temp("rt.make_class(" + quote(name) + ")");
+    }
+
+    for (const std::shared_ptr<FunctionStmt>& method : stmt->methods)
+    {
+        FunctionExpr* fn = method->fn.get();
+        bool is_initializer = method->name.lexeme == "init";
+        std::string code = emit_function(fn, name + "_" + method->name.lexeme, true, stmt->superclass != nullptr, is_initializer);
+
+        line("rt.add_method(" + klass + ", " + quote(method->name.lexeme) + ", new AotFunction(" + quote(name) + ", " +
+             std::to_string(fn->parameters.size()) + ", &" + code + "_entry, " + closure() + "));");
+    }
+
+    define(stmt->slot, name, klass);
+}
+
+void AotCompiler::define(int slot, const std::string& name, const std::string& value)
+{
+    if (slot < 0)
+    {
+        line("g_" + name + " = " + value + ";");
+        line("d_" + name + " = true;");
+    }
+    else
+    {
+        line(storage(stack.back(), slot) + " = " + value + ";");
+    }
+}
+
+// lowers expr into statements, the operand it returns is a constant, a temporary or a variable
+AotCompiler::Operand AotCompiler::expression(Expr* expr)
+{
+    switch (generic_kind(expr->kind))
+    {
+        case ExprKind::ASSIGN:
+        {
+            AssignExpr* assign = static_cast<AssignExpr*>(expr);
+            Operand value = expression(assign->value.get());
+
+            if (assign->binding.depth < 0)
+            {
+                const std::string& name = assign->name.lexeme;
+                line("if (!d_" + name + ") rt.undefined(" + quote(name) + ", " + std::to_string(assign->name.line) + ");");
+                line("g_" + name + " = " + value.code + ";");
+                return {"g_" + name, true};
+            }
+
+            std::string target = storage(stack[stack.size() - 1 - assign->binding.depth], assign->binding.slot);
+            line(target + " = " + value.code + ";");
+            return {target, true};
+        }
+
+        case ExprKind::BINARY:
+            return binary(static_cast<BinaryExpr*>(expr));
+
+        case ExprKind::GROUPING:
+            return expression(static_cast<GroupingExpr*>(expr)->expression.get());
+
+        case ExprKind::LITERAL:
+        {
+            const Value& value = static_cast<LiteralExpr*>(expr)->value;
+
+            if (value.is_int())
+                return {"Value::integer(" + std::to_string(value.as_int()) + ")"};
+
+            if (value.is_number())
+                return {number(value.as_double())};
+
+            if (value.is_bool())
+                return {value.as_bool() ? "Value(true)" : "Value(false)"};
+
+            if (value.is_string())
+                return {constant(value.as_string())};
+
+            return {"Value()"};
+        }
+
+        case ExprKind::UNARY:
+        {
+            UnaryExpr* unary = static_cast<UnaryExpr*>(expr);
+            Operand right = expression(unary->right.get());
+
+            if (unary->op.type == BANG)
+                return {temp("Value(!rt.truthy(" + right.code + "))")};
+
+            return {temp("rt.negate(" + right.code + ", " + std::to_string(unary->op.line) + ")")};
+        }
+
+        case ExprKind::MUT:
+        {
+            MutExpr* mut = static_cast<MutExpr*>(expr);
+            return variable(mut->binding, mut->name);
+        }
+
+        case ExprKind::LOGICAL:
+        {
+            LogicalExpr* logical = static_cast<LogicalExpr*>(expr);
+            std::string result = temp(expression(logical->left.get()).code);
+
+            line(std::string("if (") + (logical->op.type == OR ? "!" : "") + "rt.truthy(" + result + "))");
+            line("{");
+            indent++;
+            line(result + " = " + expression(logical->right.get()).code + ";");
+            indent--;
+            line("}");
+
+            return {result};
+        }
+
+        case ExprKind::CALL:
+            return call(static_cast<CallExpr*>(expr));
+
+        case ExprKind::FUNCTION:
+        {
+            FunctionExpr* fn = static_cast<FunctionExpr*>(expr);
+            std::string code = emit_function(fn, "", false, false, false);
+            return {temp("new AotFunction(\"\", " + std::to_string(fn->parameters.size()) + ", &" + code + "_entry, " + closure() + ")")};
+        }
+
+        case ExprKind::GET:
+        {
+            GetExpr* get = static_cast<GetExpr*>(expr);
+            Operand object = expression(get->object.get());
+            return {temp("rt.get(" + object.code + ", " + name_of(get->name.lexeme) + ", " + std::to_string(get->name.line) + ")")};
+        }
+
+        case ExprKind::SET:
+        {
+            SetExpr* set = static_cast<SetExpr*>(expr);
+            Operand object = expression(set->object.get());
+
+            line("rt.expect_instance(" + object.code + ", " + std::to_string(set->name.line) + ");");
+
+            if (may_write(set->value.get()))
+                object = stable(object);
+
+            Operand value = expression(set->value.get());
+            line("rt.set(" + object.code + ", " + name_of(set->name.lexeme) + ", " + value.code + ");");
+            return value;
+        }
+
+        case ExprKind::THIS:
+        {
+            ThisExpr* self = static_cast<ThisExpr*>(expr);
+            return variable(self->binding, self->keyword);
+        }
+
+        case ExprKind::SUPER:
+        {
+            SuperExpr* super = static_cast<SuperExpr*>(expr);
+            int depth = super->binding.depth;
+            std::string superclass = storage(stack[stack.size() - 1 - depth], 0);
+            std::string receiver = storage(stack[stack.size() - depth], 0);
+
+            return {temp("rt.super_method(" + superclass + ", " + receiver + ", " + name_of(super->method.lexeme) + ", " + std::to_string(super->method.line) + ")")};
+        }
+
+        case ExprKind::LIST:
+        {
+            std::string elements;
+
+            for (const Operand& element : arguments(static_cast<ListExpr*>(expr)->elements))
+                elements += (elements.empty() ? "" : ", ") + element.code;
+
+            return {temp("rt.list({" + elements + "})")};
+        }
+
+        case ExprKind::SUBSCRIPT:
+        {
+            SubscriptExpr* subscript = static_cast<SubscriptExpr*>(expr);
+            std::string line_number = std::to_string(subscript->paren.line);
+            Operand list = expression(subscript->name.get());
+
+            if (may_write(subscript->index.get()) || may_write(subscript->value.get()))
+                list = stable(list);
+
+            Operand index = expression(subscript->index.get());
+
+            if (subscript->value == nullptr)
+                return {temp("rt.subscript(" + list.code + ", " + index.code + ", " + line_number + ")")};
+
+            if (may_write(subscript->value.get()))
+                index = stable(index);
+
+            std::string target = "l" + std::to_string(++counter);
+            line("ListType* " + target + " = rt.subscript_target(" + list.code + ", " + index.code + ", " + line_number + ");");
+
+            Operand value = expression(subscript->value.get());
+            line("rt.subscript_store(" + target + ", " + index.code + ", " + value.code + ", " + line_number + ");");
+            return value;
+        }
+
+        default:
+            return {"Value()"};
+    }
+}
+
+AotCompiler::Operand AotCompiler::variable(const Binding& binding, const Token& name)
+{
+    if (binding.depth < 0)
+    {
+        line("if (!d_" + name.lexeme + ") rt.undefined(" + quote(name.lexeme) + ", " + std::to_string(name.line) + ");");
+        return {"g_" + name.lexeme, true};
+    }
+
+    return {storage(stack[stack.size() - 1 - binding.depth], binding.slot), true};
+}
+
+AotCompiler::Operand AotCompiler::binary(BinaryExpr* expr)
+{
+    Operand left = expression(expr->left.get());
+
+    if (may_write(expr->right.get()))
+        left = stable(left);
+
+    Operand right = expression(expr->right.get());
+    std::string operands = left.code + ", " + right.code;
+    std::string line_number = std::to_string(expr->op.line);
+
+    switch (expr->op.type)
+    {
+        case PLUS: case PLUS_EQUAL: return {temp("rt.add(" + operands + ", " + line_number + ")")};
+        case MINUS: case MINUS_EQUAL: return {temp("rt.subtract(" + operands + ", " + line_number + ")")};
+        case STAR: case STAR_EQUAL: return {temp("rt.multiply(" + operands + ", " + line_number + ")")};
+        case SLASH: case SLASH_EQUAL: return {temp("rt.divide(" + operands + ", " + line_number + ")")};
+        case LESS: return {temp("rt.less(" + operands + ", " + line_number + ")")};
+        case LESS_EQUAL: return {temp("rt.less_equal(" + operands + ", " + line_number + ")")};
+        case GREATER: return {temp("rt.greater(" + operands + ", " + line_number + ")")};
+        case GREATER_EQUAL: return {temp("rt.greater_equal(" + operands + ", " + line_number + ")")};
+        case EQUAL_EQUAL: return {temp("rt.equal(" + operands + ")")};
+        case BANG_EQUAL: return {temp("rt.not_equal(" + operands + ")")};
+        case PERCENT: return {temp("rt.binary(PERCENT, " + operands + ", " + line_number + ")")};
+        case STAR_STAR: return {temp("rt.binary(STAR_STAR, " + operands + ", " + line_number + ")")};
+        default: return {"Value()"};
+    }
+}
+
+AotCompiler::Operand AotCompiler::call(CallExpr* expr)
+{
+    std::string line_number = std::to_string(expr->paren.line);
+    std::string count = std::to_string(expr->arguments.size());
+    std::string function = direct(expr);
+
+    bool writes = false;
+    for (const std::shared_ptr<Expr>& argument : expr->arguments)
+        writes = writes || may_write(argument.get());
+
+    if (!function.empty())
+    {
+        MutExpr* callee = static_cast<MutExpr*>(expr->callee.get());
+        Operand global = variable(callee->binding, callee->name); // still has to be defined by the time it's called
+
+        std::string code = "rt.call_direct(" + function + ", " + global.code + ".as<AotFunction>(), " + line_number;
+        for (const Operand& argument : arguments(expr->arguments))
+            code += ", " + argument.code;
+
+        return {temp(code + ")")};
+    }
+
+    if (generic_kind(expr->callee->kind) == ExprKind::GET) // a method call doesn't need a bound method
+    {
+        GetExpr* get = static_cast<GetExpr*>(expr->callee.get());
+        Operand object = expression(get->object.get());
+
+        if (writes)
+            object = stable(object);
+
+        std::string callee = "t" + std::to_string(++counter);
+        std::string method = "m" + std::to_string(counter);
+
+        line("Value " + callee + ";");
+        line("AotFunction* " + method + " = rt.lookup(" + object.code + ", " + name_of(get->name.lexeme) + ", " + callee + ", " + std::to_string(get->name.line) + ");");
+
+        std::string tail = pass(arguments(expr->arguments)) + ", " + count + ", " + line_number + ")";
+        return {temp(method + " != nullptr ? rt.invoke(" + method + ", " + object.code + ", " + tail + " : rt.call(" + callee + ", " + tail)};
+    }
+
+    Operand callee = expression(expr->callee.get());
+
+    if (writes)
+        callee = stable(callee);
+
+    return {temp("rt.call(" + callee.code + ", " + pass(arguments(expr->arguments)) + ", " + count + ", " + line_number + ")")};
+}
+
+// evaluates left to right, copying out anything a later expression could overwrite
+std::vector<AotCompiler::Operand> AotCompiler::arguments(const std::vector<std::shared_ptr<Expr>>& expressions)
+{
+    std::vector<Operand> operands;
+
+    for (size_t i = 0; i < expressions.size(); i++)
+    {
+        Operand operand = expression(expressions[i].get());
+
+        for (size_t j = i + 1; j < expressions.size() && operand.place; j++)
+            if (may_write(expressions[j].get()))
+                operand = stable(operand);
+
+        operands.push_back(operand);
+    }
+
+    return operands;
+}
+
+// the argument array of a call through the runtime
+std::string AotCompiler::pass(const std::vector<Operand>& operands)
+{
+    if (operands.empty())
+        return "nullptr";
+
+    std::string array = "a" + std::to_string(++counter);
+    std::string elements;
+
+    for (const Operand& operand : operands)
+        elements += (elements.empty() ? "" : ", ") + operand.code;
+
+    line("Value " + array + "[] = {" + elements + "};");
+    return array;
+}
@@ -5,48 +5,23 @@
 
 #include "builtins.hpp"
 
-int NativeClock::arity()
+static Value native_clock(Interpreter& interpreter, const Token& paren, std::span<Value> args)
 {
-    return 0;
+    return builtin_clock();
 }
 
-std::any NativeClock::call(Interpreter& interpreter, std::vector<std::any> args)
-{
-    auto ticks = std::chrono::system_clock::now().time_since_epoch();
-    return std::chrono::duration<double>{ticks}.count() / 100.0;
-}
-
-std::string NativeClock::to_string()
-{
-    return "<native clock>";
-}
-
-
-int NativeTime::arity()
-{
-    return 0;
-}
-
-std::any NativeTime::call(Interpreter& interpreter, std::vector<std::any> args)
+static Value native_time(Interpreter& interpreter, const Token& paren, std::span<Value> args)
 {
     std::time_t current_time = std::time(nullptr);
     return std::string(std::ctime(&current_time));
 }
 
-std::string NativeTime::to_string()
+static Value native_input(Interpreter& interpreter, const Token& paren, std::span<Value> args)
 {
-    return "<native time>";
-}
+    if (!args[0].is_string())
+        throw RuntimeError(paren, "Prompt must be a string");
 
-
-int NativeInput::arity()
-{
-    return 1;
-}
-
-std::any NativeInput::call(Interpreter& interpreter, std::vector<std::any> args)
-{
-    std::string prompt = std::any_cast<std::string>(args[0]);
+    const std::string& prompt = args[0].as_string();
     std::cout << prompt;
 
     std::string input;
@@ -62,58 +37,70 @@ std::any NativeInput::call(Interpreter& interpreter, std::vector<std::any> args)
     return result;
 }
 
-std::string NativeInput::to_string()
+static Value native_exit(Interpreter& interpreter, const Token& paren, std::span<Value> args)
 {
-    return "<native input>";
-}
-
-
-int NativeExit::arity()
-{
-    return param_count;
-}
+    if (args.size() > 0 && !args[0].is_number())
+        throw RuntimeError(paren, "Exit code must be a number");
 
-std::any NativeExit::call(Interpreter& interpreter, std::vector<std::any> args)
-{
     if (args.size() > 0)
-        exit((int)std::any_cast<double>(args[0]));
+        exit((int)args[0].as_number());
     else
         exit(0);
 }
 
-std::string NativeExit::to_string()
+static Value native_floordiv(Interpreter& interpreter, const Token& paren, std::span<Value> args)
+{
+    return builtin_floordiv(paren, args[0], args[1]);
+}
+
+static Value native_len(Interpreter& interpreter, const Token& paren, std::span<Value> args)
 {
-    return "<native exit>";
+    return builtin_len(paren, args[0]);
 }
 
+static const NativeDef NATIVES[] = {
+    {"clock", 0, 0, native_clock, Intrinsic::CLOCK},
+    {"time", 0, 0, native_time},
+    {"input", 1, 1, native_input},
+    {"exit", 0, 1, native_exit},
+    {"floordiv", 2, 2, native_floordiv, Intrinsic::FLOORDIV},
+    {"len", 1, 1, native_len, Intrinsic::LEN},
+};
 
-int NativeFloorDiv::arity()
+std::span<const NativeDef> natives()
 {
-    return 2;
+    return NATIVES;
 }
 
-std::any NativeFloorDiv::call(Interpreter& interpreter, std::vector<std::any> args)
+Intrinsic find_intrinsic(const std::string& name, size_t argument_count)
 {
-    double div_res = std::any_cast<double>(args[0]) / std::any_cast<double>(args[1]);
-    return floor(div_res);
+    for (const NativeDef& native : NATIVES)
+    {
+        if (native.intrinsic != Intrinsic::NONE && name == native.name
+            && argument_count >= static_cast<size_t>(native.min_arity) && argument_count <= static_cast<size_t>(native.max_arity))
+            return native.intrinsic;
+    }
+
+    return Intrinsic::NONE;
 }
 
-std::string NativeFloorDiv::to_string()
+
+int NblNative::arity()
 {
-    return "<native floordiv>";
+    return def.min_arity;
 }
 
-int NativeArrayLen::arity()
+int NblNative::max_arity()
 {
-    return 1;
+    return def.max_arity;
 }
 
-std::any NativeArrayLen::call(Interpreter& interpreter, std::vector<std::any> args)
+Value NblNative::call(Interpreter& interpreter, const Token& paren, std::span<Value> arguments)
 {
-    return (double)std::any_cast<std::shared_ptr<ListType>>(args[0])->get_length();
+    return def.function(interpreter, paren, arguments);
 }
 
-std::string NativeArrayLen::to_string()
+std::string NblNative::to_string()
 {
-    return "<native len>";
+    return "<native " + std::string(def.name) + ">";
 }
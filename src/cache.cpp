@@ -0,0 +1,63 @@
+//------------------------------------//
+// Copyright 2024 Nam Nguyen
+// Licensed under Apache License v2.0
+//------------------------------------//
+
+#include <iostream>
+
+#include "cache.hpp"
+
+static constexpr size_t GLOBAL_SIZE = 1024;
+
+// shared by megamorphic sites, each (shape, name) pair has one place it can be in. Reading and
+// assigning a missing field mean different things, so they don't share a table
+static CacheEntry load_entries[GLOBAL_SIZE];
+static CacheEntry store_entries[GLOBAL_SIZE];
+
+InlineCache::Stats InlineCache::stats;
+
+static CacheEntry& global_entry(bool store, uint32_t shape, Symbol name)
+{
+    return (store ? store_entries : load_entries)[(shape * 31 + name) & (GLOBAL_SIZE - 1)];
+}
+
+CacheEntry* InlineCache::find_global(uint32_t shape, Symbol name)
+{
+    CacheEntry& entry = global_entry(store, shape, name);
+
+    if (entry.shape == shape && entry.name == name)
+    {
+        stats.global_hits++;
+        return &entry;
+    }
+
+    stats.global_misses++;
+    return nullptr;
+}
+
+CacheEntry* InlineCache::add(const CacheEntry& entry)
+{
+    if (!megamorphic)
+    {
+        for (CacheEntry& free : entries)
+        {
+            if (free.shape == 0)
+            {
+                free = entry;
+                return &free;
+            }
+        }
+
+        megamorphic = true;
+    }
+
+    CacheEntry& global = global_entry(store, entry.shape, entry.name);
+    global = entry;
+    return &global;
+}
+
+void InlineCache::print_stats()
+{
+    std::cerr << "inline caches: " << stats.hits << " hits, " << stats.misses << " misses\n";
+    std::cerr << "megamorphic cache: " << stats.global_hits << " hits, " << stats.global_misses << " misses\n";
+}
@@ -5,39 +5,33 @@
 
 #include "class.hpp"
 
-NblClass::NblClass(std::string name, std::shared_ptr<NblClass> superclass, std::map<std::string, std::shared_ptr<NblFunction>> methods)
-    : name(std::move(name)), superclass(std::move(superclass)), methods(std::move(methods)) {}
-
-std::shared_ptr<NblFunction> NblClass::find_method(const std::string& name)
+NblClass::NblClass(std::string name, Ref<NblClass> superclass, const std::map<std::string, Ref<NblFunction>>& own_methods)
+    : NblCallable(ObjectType::CLASS), name(std::move(name)), superclass(std::move(superclass))
 {
-    auto element = methods.find(name);
-    
-    if (element != methods.end())
-        return element->second;
+    // a lookup never has to walk up the superclasses
+    if (this->superclass != nullptr)
+        methods = this->superclass->methods;
+
+    for (const auto& [method_name, method] : own_methods)
+        methods[intern(method_name)] = method;
 
-    if (superclass != nullptr)
-        return superclass->find_method(name);
+    initializer = find_method(intern("init"));
 
-    return nullptr;
+    if (initializer != nullptr)
+        initializer_arity = initializer->arity();
 }
 
 int NblClass::arity()
 {
-    std::shared_ptr<NblFunction> initializer = find_method("init");
-    
-    if (initializer == nullptr)
-        return 0;
-
-    return initializer->arity();
+    return initializer_arity;
 }
 
-std::any NblClass::call(Interpreter& interpreter, std::vector<std::any> arguments)
+Value NblClass::call(Interpreter& interpreter, const Token& paren, std::span<Value> arguments)
 {
-    auto instance = std::make_shared<NblInstance>(shared_from_this());
-    std::shared_ptr<NblFunction> initializer = find_method("init");
+    Value instance = new NblInstance(this);
 
     if (initializer != nullptr)
-        initializer->bind(instance)->call(interpreter, std::move(arguments));
+        initializer->invoke(interpreter, instance, arguments);
 
     return instance;
 }
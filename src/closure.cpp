@@ -0,0 +1,779 @@
+//------------------------------------//
+// Copyright 2024 Nam Nguyen
+// Licensed under Apache License v2.0
+//------------------------------------//
+
+#include "closure.hpp"
+#include "interpreter.hpp"
+
+ClosureCompiler::ClosureCompiler(Interpreter& interpreter)
+    : interpreter(interpreter) {}
+
+StmtFn ClosureCompiler::compile(const std::vector<std::shared_ptr<Stmt>>& statements)
+{
+    std::vector<StmtFn> program;
+
+    for (const std::shared_ptr<Stmt>& statement : statements)
+        program.push_back(compile(statement.get()));
+
+    // the parser rejects a break outside of a loop, a top-level statement only ends in BREAK if that changes
+    return [program]
+    {
+        for (const StmtFn& statement : program)
+            statement();
+
+        return ExecResult::NORMAL;
+    };
+}
+
+
+// statements
+
+StmtFn ClosureCompiler::compile(Stmt* stmt)
+{
+    Interpreter* in = &interpreter;
+
+    switch (stmt->kind)
+    {
+        case StmtKind::BLOCK:
+        {
+            BlockStmt* block = static_cast<BlockStmt*>(stmt);
+            StmtFn body = compile_sequence(block->statements);
+
+            if (!block->scoped)
+                return body;
+
+            int slot_count = block->slot_count;
+            std::vector<int> cells = block->cells;
+
+            return [in, body, slot_count, cells]
+            {
+                return in->execute_scope(body, slot_count, cells);
+            };
+        }
+
+        case StmtKind::EXPRESSION:
+        {
+            ExprFn expression = compile(static_cast<ExpressionStmt*>(stmt)->expression.get());
+
+            return [expression]
+            {
+                expression();
+                return ExecResult::NORMAL;
+            };
+        }
+
+        case StmtKind::PRINT:
+        {
+            ExprFn expression = compile(static_cast<PrintStmt*>(stmt)->expression.get());
+
+            return [in, expression]
+            {
+                std::cout << in->stringify(expression()) + "\n";
+                return ExecResult::NORMAL;
+            };
+        }
+
+        case StmtKind::MUT: return compile_mut(static_cast<MutStmt*>(stmt));
+        case StmtKind::IF: return compile_if(static_cast<IfStmt*>(stmt));
+        case StmtKind::WHILE: return compile_while(static_cast<WhileStmt*>(stmt));
+        case StmtKind::FUNCTION: return compile_function(static_cast<FunctionStmt*>(stmt));
+        case StmtKind::RETURN: return compile_return(static_cast<ReturnStmt*>(stmt));
+        case StmtKind::BREAK: return [] { return ExecResult::BREAK; };
+        case StmtKind::CLASS: return compile_class(static_cast<ClassStmt*>(stmt));
+
+        default: // imports run the file through interpret(), which compiles it in turn
+            return [in, stmt] { return in->execute(stmt); };
+    }
+}
+
+StmtFn ClosureCompiler::compile_sequence(const std::vector<std::shared_ptr<Stmt>>& statements)
+{
+    std::vector<StmtFn> compiled;
+
+    for (const std::shared_ptr<Stmt>& statement : statements)
+        compiled.push_back(compile(statement.get()));
+
+    if (compiled.size() == 1)
+        return compiled[0];
+
+    return [compiled]
+    {
+        for (const StmtFn& statement : compiled)
+        {
+            ExecResult result = statement();
+
+            if (result != ExecResult::NORMAL)
+                return result;
+        }
+
+        return ExecResult::NORMAL;
+    };
+}
+
+// function bodies are compiled once, every NblFunction created from the declaration shares the result
+std::shared_ptr<StmtFn> ClosureCompiler::compile_body(FunctionExpr* fn)
+{
+    return std::make_shared<StmtFn>(compile_sequence(fn->body));
+}
+
+StmtFn ClosureCompiler::compile_mut(MutStmt* stmt)
+{
+    Interpreter* in = &interpreter;
+    const Token* name = &stmt->name;
+    int slot = stmt->slot;
+
+    if (stmt->initializer == nullptr)
+    {
+        return [in, name, slot]
+        {
+            in->define(*name, slot, nullptr);
+            return ExecResult::NORMAL;
+        };
+    }
+
+    ExprFn initializer = compile(stmt->initializer.get());
+
+    return [in, name, slot, initializer]
+    {
+        in->define(*name, slot, initializer());
+        return ExecResult::NORMAL;
+    };
+}
+
+StmtFn ClosureCompiler::compile_if(IfStmt* stmt)
+{
+    Interpreter* in = &interpreter;
+    ExprFn condition = compile(stmt->condition.get());
+    StmtFn then_branch = compile(stmt->then_branch.get());
+
+    if (stmt->else_branch == nullptr)
+    {
+        return [in, condition, then_branch]
+        {
+            if (in->is_truthy(condition()))
+                return then_branch();
+            return ExecResult::NORMAL;
+        };
+    }
+
+    StmtFn else_branch = compile(stmt->else_branch.get());
+
+    return [in, condition, then_branch, else_branch]
+    {
+        if (in->is_truthy(condition()))
+            return then_branch();
+        return else_branch();
+    };
+}
+
+StmtFn ClosureCompiler::compile_while(WhileStmt* stmt)
+{
+    Interpreter* in = &interpreter;
+    ExprFn condition = compile(stmt->condition.get());
+    StmtFn body = compile(stmt->body.get());
+
+    return [in, condition, body]
+    {
+        while (in->is_truthy(condition()))
+        {
+            ExecResult result = body();
+
+            if (result == ExecResult::BREAK)
+                break;
+
+            if (result == ExecResult::RETURN)
+                return result;
+        }
+
+        return ExecResult::NORMAL;
+    };
+}
+
+StmtFn ClosureCompiler::compile_function(FunctionStmt* stmt)
+{
+    Interpreter* in = &interpreter;
+    const Token* name = &stmt->name;
+    int slot = stmt->slot;
+    std::shared_ptr<FunctionExpr> fn = stmt->fn;
+    std::shared_ptr<StmtFn> body = compile_body(fn.get());
+
+    return [in, name, slot, fn, body]
+    {
+        in->define(*name, slot, new NblFunction(name->lexeme, fn, in->capture(fn.get()), false, body));
+        return ExecResult::NORMAL;
+    };
+}
+
+StmtFn ClosureCompiler::compile_return(ReturnStmt* stmt)
+{
+    Interpreter* in = &interpreter;
+
+    if (stmt->value == nullptr)
+    {
+        return [in]
+        {
+            in->return_value = nullptr;
+            return ExecResult::RETURN;
+        };
+    }
+
+    if (stmt->tail && static_cast<CallExpr*>(stmt->value.get())->callee->kind == ExprKind::GET)
+    {
+        CallExpr* call = static_cast<CallExpr*>(stmt->value.get());
+        GetExpr* get = static_cast<GetExpr*>(call->callee.get());
+        const Token* paren = &call->paren;
+        ExprFn object_fn = compile(get->object.get());
+        std::vector<ExprFn> argument_fns;
+
+        for (const std::shared_ptr<Expr>& argument : call->arguments)
+            argument_fns.push_back(compile(argument.get()));
+
+        return [in, get, paren, object_fn, argument_fns]
+        {
+            Value object = object_fn();
+            Value field;
+            NblFunction* method = in->find_method(get, object, field);
+            CallArguments arguments(*in, argument_fns.size());
+
+            for (size_t i = 0; i < argument_fns.size(); i++)
+                arguments.values[i] = argument_fns[i]();
+
+            in->return_value = nullptr;
+
+            if (method != nullptr)
+                in->return_method(*paren, method, object, arguments.values);
+            else
+                in->return_call(*paren, field, arguments.values);
+
+            return ExecResult::RETURN;
+        };
+    }
+
+    if (stmt->tail)
+    {
+        CallExpr* call = static_cast<CallExpr*>(stmt->value.get());
+        const Token* paren = &call->paren;
+        ExprFn callee_fn = compile(call->callee.get());
+        std::vector<ExprFn> argument_fns;
+
+        for (const std::shared_ptr<Expr>& argument : call->arguments)
+            argument_fns.push_back(compile(argument.get()));
+
+        return [in, paren, callee_fn, argument_fns]
+        {
+            Value callee = callee_fn();
+            CallArguments arguments(*in, argument_fns.size());
+
+            for (size_t i = 0; i < argument_fns.size(); i++)
+                arguments.values[i] = argument_fns[i]();
+
+            in->return_value = nullptr;
+            in->return_call(*paren, callee, arguments.values);
+            return ExecResult::RETURN;
+        };
+    }
+
+    ExprFn value = compile(stmt->value.get());
+
+    return [in, value]
+    {
+        in->return_value = value();
+        return ExecResult::RETURN;
+    };
+}
+
+StmtFn ClosureCompiler::compile_class(ClassStmt* stmt)
+{
+    Interpreter* in = &interpreter;
+    std::vector<std::shared_ptr<StmtFn>> bodies;
+
+    for (const std::shared_ptr<FunctionStmt>& method : stmt->methods)
+        bodies.push_back(compile_body(method->fn.get()));
+
+    return [in, stmt, bodies]
+    {
+        in->declare_class(stmt, bodies);
+        return ExecResult::NORMAL;
+    };
+}
+
+
+// expressions
+
+ExprFn ClosureCompiler::compile(Expr* expr)
+{
+    Interpreter* in = &interpreter;
+
+    switch (expr->kind)
+    {
+        case ExprKind::LITERAL:
+        {
+            Value value = static_cast<LiteralExpr*>(expr)->value;
+            return [value] { return value; };
+        }
+
+        case ExprKind::GROUPING: // parentheses leave nothing behind
+            return compile(static_cast<GroupingExpr*>(expr)->expression.get());
+
+        case ExprKind::MUT:
+        {
+            MutExpr* mut = static_cast<MutExpr*>(expr);
+            return compile_variable(mut->name, mut->binding);
+        }
+
+        case ExprKind::THIS:
+        {
+            ThisExpr* self = static_cast<ThisExpr*>(expr);
+            return compile_variable(self->keyword, self->binding);
+        }
+
+        case ExprKind::FUNCTION:
+        {
+            std::shared_ptr<FunctionExpr> fn = static_cast<FunctionExpr*>(expr)->shared_from_this();
+            std::shared_ptr<StmtFn> body = compile_body(fn.get());
+
+            return [in, fn, body]
+            {
+                return Value(new NblFunction("", fn, in->capture(fn.get()), false, body));
+            };
+        }
+
+        case ExprKind::ASSIGN: return compile_assign(static_cast<AssignExpr*>(expr));
+        case ExprKind::BINARY: return compile_binary(static_cast<BinaryExpr*>(expr));
+        case ExprKind::SQUARE: return compile_square(static_cast<BinaryExpr*>(expr));
+        case ExprKind::UNARY: return compile_unary(static_cast<UnaryExpr*>(expr));
+        case ExprKind::LOGICAL: return compile_logical(static_cast<LogicalExpr*>(expr));
+        case ExprKind::CALL: return compile_call(static_cast<CallExpr*>(expr));
+        case ExprKind::GET: return compile_get(static_cast<GetExpr*>(expr));
+        case ExprKind::SET: return compile_set(static_cast<SetExpr*>(expr));
+        case ExprKind::LIST: return compile_list(static_cast<ListExpr*>(expr));
+
+        default: // super, subscripts
+            return delegate(expr);
+    }
+}
+
+ExprFn ClosureCompiler::compile_variable(const Token& name, const Binding& binding)
+{
+    Interpreter* in = &interpreter;
+    int depth = binding.depth;
+    int slot = binding.slot;
+
+    if (binding.receiver)
+        return [in] { return *in->receiver; };
+
+    if (depth < 0)
+    {
+        const Token* global = &name;
+        return [in, slot, global] { return in->globals->get(slot, *global); };
+    }
+
+    if (binding.upvalue >= 0)
+    {
+        int index = binding.upvalue;
+        return [in, index] { return (*in->upvalues)[index]->value; };
+    }
+
+    if (binding.cell)
+        return [in, depth, slot] { return in->environment->ancestor(depth)->slots[slot].as<Cell>()->value; };
+
+    return [in, depth, slot] { return in->environment->get_at(depth, slot); };
+}
+
+ExprFn ClosureCompiler::compile_assign(AssignExpr* expr)
+{
+    Interpreter* in = &interpreter;
+    const Token* name = &expr->name;
+    int depth = expr->binding.depth;
+    int slot = expr->binding.slot;
+
+    // captured variables go through their cell
+    if (expr->binding.upvalue >= 0 || expr->binding.cell)
+    {
+        const Binding* binding = &expr->binding;
+        ExprFn value = compile(expr->value.get());
+
+        return [in, binding, value]
+        {
+            Value result = value();
+            in->local(*binding) = result;
+            return result;
+        };
+    }
+
+    // i += 1 on a number is an add in place
+    BinaryExpr* binary = dynamic_cast<BinaryExpr*>(expr->value.get());
+    MutExpr* target = binary != nullptr ? dynamic_cast<MutExpr*>(binary->left.get()) : nullptr;
+    LiteralExpr* increment = binary != nullptr ? dynamic_cast<LiteralExpr*>(binary->right.get()) : nullptr;
+
+    bool is_increment = target != nullptr && increment != nullptr && increment->value.is_number()
+        && (binary->op.type == PLUS || binary->op.type == PLUS_EQUAL)
+        && target->name.lexeme == name->lexeme && target->binding.depth == depth && target->binding.slot == slot;
+
+    ExprFn value = compile(expr->value.get());
+
+    if (is_increment && depth >= 0)
+    {
+        Value amount = increment->value;
+
+        return [in, depth, slot, amount, value]
+        {
+            Value& variable = in->environment->ancestor(depth)->slots[slot];
+
+            if (variable.is_number())
+                return variable = num_add(variable, amount);
+
+            Value result = value();
+            in->environment->assign_at(depth, slot, result);
+            return result;
+        };
+    }
+
+    if (is_increment)
+    {
+        Value amount = increment->value;
+
+        return [in, slot, name, amount, value]
+        {
+            Value* global = in->globals->global(slot);
+
+            if (global != nullptr && global->is_number())
+                return *global = num_add(*global, amount);
+
+            Value result = value();
+            in->globals->assign(slot, *name, result);
+            return result;
+        };
+    }
+
+    if (depth >= 0)
+    {
+        return [in, depth, slot, value]
+        {
+            Value result = value();
+            in->environment->assign_at(depth, slot, result);
+            return result;
+        };
+    }
+
+    return [in, slot, name, value]
+    {
+        Value result = value();
+        in->globals->assign(slot, *name, result);
+        return result;
+    };
+}
+
+// number fast path for an operator, specialized on whether the left operand
+// is a local and the right one a number literal
+template<typename Op>
+ExprFn ClosureCompiler::compile_numbers(BinaryExpr* expr, Op op)
+{
+    Interpreter* in = &interpreter;
+    const Token* token = &expr->op;
+
+    MutExpr* local = dynamic_cast<MutExpr*>(expr->left.get());
+    LiteralExpr* constant = dynamic_cast<LiteralExpr*>(expr->right.get());
+
+    if (local != nullptr && (local->binding.depth < 0 || local->binding.upvalue >= 0 || local->binding.cell))
+        local = nullptr;
+
+    if (constant != nullptr && !constant->value.is_number())
+        constant = nullptr;
+
+    if (local != nullptr && constant != nullptr)
+    {
+        int depth = local->binding.depth;
+        int slot = local->binding.slot;
+        Value right = constant->value;
+
+        return [in, token, op, depth, slot, right]
+        {
+            Value left = in->environment->get_at(depth, slot);
+
+            if (left.is_number())
+                return Value(op(left, right));
+            return in->binary_operation(*token, left, right);
+        };
+    }
+
+    ExprFn right_fn = compile(expr->right.get());
+
+    if (local != nullptr)
+    {
+        int depth = local->binding.depth;
+        int slot = local->binding.slot;
+
+        return [in, token, op, depth, slot, right_fn]
+        {
+            Value left = in->environment->get_at(depth, slot);
+            Value right = right_fn();
+
+            if (left.is_number() && right.is_number())
+                return Value(op(left, right));
+            return in->binary_operation(*token, left, right);
+        };
+    }
+
+    ExprFn left_fn = compile(expr->left.get());
+
+    return [in, token, op, left_fn, right_fn]
+    {
+        Value left = left_fn();
+        Value right = right_fn();
+
+        if (left.is_number() && right.is_number())
+            return Value(op(left, right));
+        return in->binary_operation(*token, left, right);
+    };
+}
+
+// see Interpreter::eval_square
+ExprFn ClosureCompiler::compile_square(BinaryExpr* expr)
+{
+    Interpreter* in = &interpreter;
+    const Token* token = &expr->op;
+    ExprFn left_fn = compile(expr->left.get());
+    Value exponent = static_cast<LiteralExpr*>(expr->right.get())->value;
+
+    return [in, token, left_fn, exponent]
+    {
+        Value left = left_fn();
+
+        if (left.is_number())
+            return num_multiply(left, left);
+        return in->binary_operation(*token, left, exponent);
+    };
+}
+
+ExprFn ClosureCompiler::compile_binary(BinaryExpr* expr)
+{
+    switch (expr->op.type)
+    {
+        case PLUS: case PLUS_EQUAL: return compile_numbers(expr, [](const Value& a, const Value& b) { return num_add(a, b); });
+        case MINUS: case MINUS_EQUAL: return compile_numbers(expr, [](const Value& a, const Value& b) { return num_subtract(a, b); });
+        case STAR: case STAR_EQUAL: return compile_numbers(expr, [](const Value& a, const Value& b) { return num_multiply(a, b); });
+        case SLASH: case SLASH_EQUAL: return compile_numbers(expr, [](const Value& a, const Value& b) { return num_divide(a, b); });
+        case PERCENT: return compile_numbers(expr, [](const Value& a, const Value& b) { return num_modulo(a, b); });
+        case LESS: return compile_numbers(expr, [](const Value& a, const Value& b) { return num_less(a, b); });
+        case LESS_EQUAL: return compile_numbers(expr, [](const Value& a, const Value& b) { return num_less_equal(a, b); });
+        case GREATER: return compile_numbers(expr, [](const Value& a, const Value& b) { return num_greater(a, b); });
+        case GREATER_EQUAL: return compile_numbers(expr, [](const Value& a, const Value& b) { return num_greater_equal(a, b); });
+        case EQUAL_EQUAL: return compile_numbers(expr, [](const Value& a, const Value& b) { return num_equal(a, b); });
+        case BANG_EQUAL: return compile_numbers(expr, [](const Value& a, const Value& b) { return !num_equal(a, b); });
+        default: break;
+    }
+
+    Interpreter* in = &interpreter;
+    const Token* token = &expr->op;
+    ExprFn left_fn = compile(expr->left.get());
+    ExprFn right_fn = compile(expr->right.get());
+
+    return [in, token, left_fn, right_fn]
+    {
+        Value left = left_fn();
+        Value right = right_fn();
+        return in->binary_operation(*token, left, right);
+    };
+}
+
+ExprFn ClosureCompiler::compile_unary(UnaryExpr* expr)
+{
+    Interpreter* in = &interpreter;
+    const Token* token = &expr->op;
+    ExprFn right = compile(expr->right.get());
+
+    if (expr->op.type == BANG)
+        return [in, right] { return Value(!in->is_truthy(right())); };
+
+    return [in, token, right]
+    {
+        Value operand = right();
+        in->check_num_operand(*token, operand);
+        return num_negate(operand);
+    };
+}
+
+ExprFn ClosureCompiler::compile_logical(LogicalExpr* expr)
+{
+    Interpreter* in = &interpreter;
+    ExprFn left_fn = compile(expr->left.get());
+    ExprFn right_fn = compile(expr->right.get());
+
+    if (expr->op.type == OR)
+    {
+        return [in, left_fn, right_fn]
+        {
+            Value left = left_fn();
+            return in->is_truthy(left) ? left : right_fn();
+        };
+    }
+
+    return [in, left_fn, right_fn]
+    {
+        Value left = left_fn();
+        return !in->is_truthy(left) ? left : right_fn();
+    };
+}
+
+ExprFn ClosureCompiler::compile_call(CallExpr* expr)
+{
+    if (expr->callee->kind == ExprKind::GET)
+        return compile_invoke(expr);
+
+    Interpreter* in = &interpreter;
+    const Token* paren = &expr->paren;
+    ExprFn callee_fn = compile(expr->callee.get());
+    std::vector<ExprFn> argument_fns;
+
+    for (const std::shared_ptr<Expr>& argument : expr->arguments)
+        argument_fns.push_back(compile(argument.get()));
+
+    if (expr->intrinsic != Intrinsic::NONE)
+        return compile_intrinsic(expr, callee_fn, argument_fns);
+
+    return [in, paren, callee_fn, argument_fns]
+    {
+        Value callee = callee_fn();
+        CallArguments arguments(*in, argument_fns.size());
+
+        for (size_t i = 0; i < argument_fns.size(); i++)
+            arguments.values[i] = argument_fns[i]();
+
+        // NIMBLE functions skip the callable lookup
+        if (callee.is_object(ObjectType::FUNCTION))
+        {
+            NblFunction* function = callee.as<NblFunction>();
+
+            if (arguments.values.size() == static_cast<size_t>(function->arity()))
+            {
+                in->check_stack(*paren);
+                return function->call(*in, *paren, arguments.values);
+            }
+        }
+
+        return in->call(*paren, callee, arguments.values);
+    };
+}
+
+// a call the resolver found an intrinsic for, see Interpreter::eval_call_intrinsic
+ExprFn ClosureCompiler::compile_intrinsic(CallExpr* expr, const ExprFn& callee_fn, const std::vector<ExprFn>& argument_fns)
+{
+    Interpreter* in = &interpreter;
+    const Token* paren = &expr->paren;
+    Intrinsic intrinsic = expr->intrinsic;
+
+    return [in, paren, intrinsic, callee_fn, argument_fns]
+    {
+        Value callee = callee_fn();
+        Value values[2];
+        std::span<Value> arguments(values, argument_fns.size());
+
+        for (size_t i = 0; i < arguments.size(); i++)
+            arguments[i] = argument_fns[i]();
+
+        if (!is_intrinsic(callee, intrinsic))
+            return in->call(*paren, callee, arguments);
+
+        return run_intrinsic(intrinsic, *paren, arguments);
+    };
+}
+
+// object.name(...) without a bound method, see Interpreter::eval_invoke
+ExprFn ClosureCompiler::compile_invoke(CallExpr* expr)
+{
+    Interpreter* in = &interpreter;
+    GetExpr* get = static_cast<GetExpr*>(expr->callee.get());
+    const Token* paren = &expr->paren;
+    ExprFn object_fn = compile(get->object.get());
+    std::vector<ExprFn> argument_fns;
+
+    for (const std::shared_ptr<Expr>& argument : expr->arguments)
+        argument_fns.push_back(compile(argument.get()));
+
+    return [in, get, paren, object_fn, argument_fns]
+    {
+        Value object = object_fn();
+        Value field;
+        NblFunction* method = in->find_method(get, object, field);
+        CallArguments arguments(*in, argument_fns.size());
+
+        for (size_t i = 0; i < argument_fns.size(); i++)
+            arguments.values[i] = argument_fns[i]();
+
+        if (method == nullptr)
+            return in->call(*paren, field, arguments.values);
+
+        if (arguments.values.size() != static_cast<size_t>(method->arity()))
+            throw RuntimeError(*paren, method->arity_error(arguments.values.size()));
+
+        in->check_stack(*paren);
+        return method->invoke(*in, object, arguments.values);
+    };
+}
+
+ExprFn ClosureCompiler::compile_get(GetExpr* expr)
+{
+    const Token* name = &expr->name;
+    Symbol symbol = expr->symbol;
+    InlineCache* cache = &expr->cache;
+    ExprFn object_fn = compile(expr->object.get());
+
+    return [name, symbol, cache, object_fn]
+    {
+        Value object = object_fn();
+
+        if (object.is_object(ObjectType::INSTANCE))
+            return object.as<NblInstance>()->get(*name, symbol, *cache);
+
+        throw RuntimeError(*name, "Only instances have properties");
+    };
+}
+
+ExprFn ClosureCompiler::compile_set(SetExpr* expr)
+{
+    const Token* name = &expr->name;
+    Symbol symbol = expr->symbol;
+    InlineCache* cache = &expr->cache;
+    ExprFn object_fn = compile(expr->object.get());
+    ExprFn value_fn = compile(expr->value.get());
+
+    return [name, symbol, cache, object_fn, value_fn]
+    {
+        Value object = object_fn();
+
+        if (!object.is_object(ObjectType::INSTANCE))
+            throw RuntimeError(*name, "Only instances have fields");
+
+        Value value = value_fn();
+        object.as<NblInstance>()->set(symbol, value, *cache);
+
+        return value;
+    };
+}
+
+ExprFn ClosureCompiler::compile_list(ListExpr* expr)
+{
+    std::vector<ExprFn> element_fns;
+
+    for (const std::shared_ptr<Expr>& element : expr->elements)
+        element_fns.push_back(compile(element.get()));
+
+    return [element_fns]
+    {
+        Ref<ListType> list = new ListType();
+
+        for (const ExprFn& element : element_fns)
+            list->append(element());
+
+        return Value(list);
+    };
+}
+
+// rare nodes are left to the tree-walker, they run against the same environment
+ExprFn ClosureCompiler::delegate(Expr* expr)
+{
+    Interpreter* in = &interpreter;
+    return [in, expr] { return in->evaluate(expr); };
+}
@@ -0,0 +1,730 @@
+//------------------------------------//
+// Copyright 2024 Nam Nguyen
+// Licensed under Apache License v2.0
+//------------------------------------//
+
+#include "compiler.hpp"
+
+Ref<VmFunction> Compiler::compile_script(const std::vector<std::shared_ptr<Stmt>>& statements)
+{
+    FunctionState state;
+    begin_function(state, FunctionType::NONE, "");
+
+    // the parser rejects a break outside of a loop, this only gives one a target if that changes
+    for (const std::shared_ptr<Stmt>& statement : statements)
+    {
+        current->loops.push_back(LoopState{0, {}});
+        compile(statement);
+
+        for (int jump : current->loops.back().break_jumps)
+            patch_jump(jump);
+        current->loops.pop_back();
+    }
+
+    return end_function();
+}
+
+Ref<VmFunction> Compiler::compile_expression(std::shared_ptr<Expr> expr)
+{
+    FunctionState state;
+    begin_function(state, FunctionType::NONE, "");
+    compile(expr);
+    emit(OP_RETURN);
+    return end_function();
+}
+
+
+Value Compiler::visitAssignExpr(std::shared_ptr<AssignExpr> expr)
+{
+    compile(expr->value);
+    line = expr->name.line;
+    assign_variable(expr->name);
+    return {};
+}
+
+Value Compiler::visitBinaryExpr(std::shared_ptr<BinaryExpr> expr)
+{
+    compile(expr->left);
+
+    // x ** 2 multiplies x by itself, OP_SQUARE fails on the same operands OP_POWER does
+    if (expr->kind == ExprKind::SQUARE)
+    {
+        line = expr->op.line;
+        emit(OP_SQUARE);
+        return {};
+    }
+
+    compile(expr->right);
+    line = expr->op.line;
+
+    switch (expr->op.type)
+    {
+        case BANG_EQUAL: emit(OP_NOT_EQUAL); break;
+        case EQUAL_EQUAL: emit(OP_EQUAL); break;
+        case GREATER: emit(OP_GREATER); break;
+        case GREATER_EQUAL: emit(OP_GREATER_EQUAL); break;
+        case LESS: emit(OP_LESS); break;
+        case LESS_EQUAL: emit(OP_LESS_EQUAL); break;
+        case STAR_STAR: emit(OP_POWER); break;
+        case PLUS: case PLUS_EQUAL: emit(OP_ADD); break;
+        case MINUS: case MINUS_EQUAL: emit(OP_SUBTRACT); break;
+        case STAR: case STAR_EQUAL: emit(OP_MULTIPLY); break;
+        case SLASH: case SLASH_EQUAL: emit(OP_DIVIDE); break;
+        case PERCENT: emit(OP_MODULO); break;
+        default: break;
+    }
+
+    return {};
+}
+
+Value Compiler::visitGroupingExpr(std::shared_ptr<GroupingExpr> expr)
+{
+    compile(expr->expression);
+    return {};
+}
+
+Value Compiler::visitLiteralExpr(std::shared_ptr<LiteralExpr> expr)
+{
+    if (expr->value.is_nil())
+        emit(OP_NIL);
+    else if (expr->value.is_bool())
+        emit(expr->value.as_bool() ? OP_TRUE : OP_FALSE);
+    else
+        emit_short(OP_CONSTANT, make_constant(expr->value));
+
+    return {};
+}
+
+Value Compiler::visitUnaryExpr(std::shared_ptr<UnaryExpr> expr)
+{
+    compile(expr->right);
+    line = expr->op.line;
+
+    if (expr->op.type == BANG)
+        emit(OP_NOT);
+    else if (expr->op.type == MINUS)
+        emit(OP_NEGATE);
+
+    return {};
+}
+
+Value Compiler::visitMutExpr(std::shared_ptr<MutExpr> expr)
+{
+    line = expr->name.line;
+    named_variable(expr->name);
+    return {};
+}
+
+Value Compiler::visitLogicalExpr(std::shared_ptr<LogicalExpr> expr)
+{
+    compile(expr->left);
+    line = expr->op.line;
+
+    if (expr->op.type == OR)
+    {
+        int else_jump = emit_jump(OP_JUMP_IF_FALSE);
+        int end_jump = emit_jump(OP_JUMP);
+        patch_jump(else_jump);
+        emit(OP_POP);
+        compile(expr->right);
+        patch_jump(end_jump);
+    }
+    else
+    {
+        int end_jump = emit_jump(OP_JUMP_IF_FALSE);
+        emit(OP_POP);
+        compile(expr->right);
+        patch_jump(end_jump);
+    }
+
+    return {};
+}
+
+Value Compiler::visitCallExpr(std::shared_ptr<CallExpr> expr)
+{
+    if (invoke(expr.get()))
+        return {};
+
+    compile(expr->callee);
+
+    for (const std::shared_ptr<Expr>& argument : expr->arguments)
+        compile(argument);
+
+    line = expr->paren.line;
+
+    if (expr->intrinsic != Intrinsic::NONE)
+    {
+        emit(OP_INTRINSIC, static_cast<uint8_t>(expr->intrinsic));
+        emit(expr->arguments.size());
+        return {};
+    }
+
+    emit(OP_CALL, expr->arguments.size());
+    return {};
+}
+
+// object.name(...) calls the method straight off the receiver, without an OP_GET_PROPERTY making a bound method
+bool Compiler::invoke(CallExpr* call)
+{
+    if (call->callee->kind != ExprKind::GET)
+        return false;
+
+    GetExpr* get = static_cast<GetExpr*>(call->callee.get());
+    compile(get->object);
+
+    for (const std::shared_ptr<Expr>& argument : call->arguments)
+        compile(argument);
+
+    line = call->paren.line;
+    emit_short(OP_INVOKE, identifier_constant(get->name.lexeme));
+    emit(call->arguments.size());
+    return true;
+}
+
+Value Compiler::visitFunctionExpr(std::shared_ptr<FunctionExpr> expr)
+{
+    function(expr, FunctionType::FUNCTION, "");
+    return {};
+}
+
+Value Compiler::visitGetExpr(std::shared_ptr<GetExpr> expr)
+{
+    compile(expr->object);
+    line = expr->name.line;
+    emit_short(OP_GET_PROPERTY, identifier_constant(expr->name.lexeme));
+    return {};
+}
+
+Value Compiler::visitSetExpr(std::shared_ptr<SetExpr> expr)
+{
+    compile(expr->object);
+    compile(expr->value);
+    line = expr->name.line;
+    emit_short(OP_SET_PROPERTY, identifier_constant(expr->name.lexeme));
+    return {};
+}
+
+Value Compiler::visitThisExpr(std::shared_ptr<ThisExpr> expr)
+{
+    line = expr->keyword.line;
+    named_variable(expr->keyword);
+    return {};
+}
+
+Value Compiler::visitSuperExpr(std::shared_ptr<SuperExpr> expr)
+{
+    line = expr->keyword.line;
+    named_variable(Token{THIS, "this", nullptr, line});
+    named_variable(expr->keyword);
+    emit_short(OP_GET_SUPER, identifier_constant(expr->method.lexeme));
+    return {};
+}
+
+Value Compiler::visitListExpr(std::shared_ptr<ListExpr> expr)
+{
+    for (const std::shared_ptr<Expr>& element : expr->elements)
+        compile(element);
+
+    emit(OP_LIST, expr->elements.size());
+    return {};
+}
+
+Value Compiler::visitSubscriptExpr(std::shared_ptr<SubscriptExpr> expr)
+{
+    compile(expr->name);
+    compile(expr->index);
+
+    if (expr->value != nullptr)
+    {
+        compile(expr->value);
+        line = expr->paren.line;
+        emit(OP_SET_SUBSCRIPT);
+    }
+    else
+    {
+        line = expr->paren.line;
+        emit(OP_GET_SUBSCRIPT);
+    }
+
+    return {};
+}
+
+Value Compiler::visitBlockStmt(std::shared_ptr<BlockStmt> stmt)
+{
+    begin_scope();
+    compile(stmt->statements);
+    end_scope();
+    return {};
+}
+
+Value Compiler::visitExpressionStmt(std::shared_ptr<ExpressionStmt> stmt)
+{
+    compile(stmt->expression);
+    emit(OP_POP);
+    return {};
+}
+
+Value Compiler::visitPrintStmt(std::shared_ptr<PrintStmt> stmt)
+{
+    compile(stmt->expression);
+    emit(OP_PRINT);
+    return {};
+}
+
+Value Compiler::visitMutStmt(std::shared_ptr<MutStmt> stmt)
+{
+    if (stmt->initializer != nullptr)
+        compile(stmt->initializer);
+    else
+        emit(OP_NIL);
+
+    line = stmt->name.line;
+    declare_variable(stmt->name);
+    define_variable(stmt->name);
+    return {};
+}
+
+Value Compiler::visitIfStmt(std::shared_ptr<IfStmt> stmt)
+{
+    compile(stmt->condition);
+
+    int then_jump = emit_jump(OP_JUMP_IF_FALSE);
+    emit(OP_POP);
+    compile(stmt->then_branch);
+
+    int else_jump = emit_jump(OP_JUMP);
+    patch_jump(then_jump);
+    emit(OP_POP);
+
+    if (stmt->else_branch != nullptr)
+        compile(stmt->else_branch);
+    patch_jump(else_jump);
+
+    return {};
+}
+
+Value Compiler::visitWhileStmt(std::shared_ptr<WhileStmt> stmt)
+{
+    int loop_start = chunk().code.size();
+    compile(stmt->condition);
+
+    int exit_jump = emit_jump(OP_JUMP_IF_FALSE);
+    emit(OP_POP);
+
+    current->loops.push_back(LoopState{current->scope_depth, {}});
+    compile(stmt->body);
+    emit_loop(loop_start);
+
+    patch_jump(exit_jump);
+    emit(OP_POP);
+
+    // break jumps land after the condition has been popped
+    for (int jump : current->loops.back().break_jumps)
+        patch_jump(jump);
+    current->loops.pop_back();
+
+    return {};
+}
+
+Value Compiler::visitFunctionStmt(std::shared_ptr<FunctionStmt> stmt)
+{
+    line = stmt->name.line;
+    declare_variable(stmt->name); // declared before the body so the function can call itself
+    function(stmt->fn, FunctionType::FUNCTION, stmt->name.lexeme);
+    define_variable(stmt->name);
+    return {};
+}
+
+Value Compiler::visitReturnStmt(std::shared_ptr<ReturnStmt> stmt)
+{
+    line = stmt->keyword.line;
+
+    if (current->type == FunctionType::INITIALIZER)
+    {
+        emit(OP_GET_LOCAL, 0);
+    }
+    else if (stmt->tail && invoke(static_cast<CallExpr*>(stmt->value.get())))
+    {
+        // methods are invoked, the OP_RETURN below returns their result
+    }
+    else if (stmt->tail)
+    {
+        // the OP_RETURN below only runs when the callee isn't a closure that took over the frame
+        std::shared_ptr<CallExpr> call = std::static_pointer_cast<CallExpr>(stmt->value);
+
+        compile(call->callee);
+
+        for (const std::shared_ptr<Expr>& argument : call->arguments)
+            compile(argument);
+
+        line = call->paren.line;
+        emit(OP_TAIL_CALL, call->arguments.size());
+    }
+    else if (stmt->value != nullptr)
+    {
+        compile(stmt->value);
+    }
+    else
+    {
+        emit(OP_NIL);
+    }
+
+    emit(OP_RETURN);
+    return {};
+}
+
+Value Compiler::visitBreakStmt(std::shared_ptr<BreakStmt> stmt)
+{
+    // unreachable while the parser rejects a break outside of a loop, returns nil rather than read past loops
+    if (current->loops.empty())
+    {
+        emit_return();
+        return {};
+    }
+
+    LoopState& loop = current->loops.back();
+
+    // discard the locals of every scope the break jumps out of
+    for (int i = current->locals.size() - 1; i >= 0 && current->locals[i].depth > loop.scope_depth; i--)
+        emit(current->locals[i].is_captured ? OP_CLOSE_UPVALUE : OP_POP);
+
+    loop.break_jumps.push_back(emit_jump(OP_JUMP));
+    return {};
+}
+
+Value Compiler::visitClassStmt(std::shared_ptr<ClassStmt> stmt)
+{
+    line = stmt->name.line;
+    int name_constant = identifier_constant(stmt->name.lexeme);
+
+    declare_variable(stmt->name);
+    emit_short(OP_CLASS, name_constant);
+    define_variable(stmt->name);
+
+    if (stmt->superclass != nullptr)
+    {
+        named_variable(stmt->superclass->name);
+
+        // superclass stays on the stack as a local named "super" for the methods to capture
+        begin_scope();
+        add_local("super");
+
+        named_variable(stmt->name);
+        emit(OP_INHERIT);
+    }
+
+    named_variable(stmt->name);
+    for (const std::shared_ptr<FunctionStmt>& method : stmt->methods)
+    {
+        FunctionType type = method->name.lexeme == "init" ? FunctionType::INITIALIZER : FunctionType::METHOD;
+
+        // methods are named after their class, same as NblFunction in the tree-walker
+        function(method->fn, type, stmt->name.lexeme);
+        line = method->name.line;
+        emit_short(OP_METHOD, identifier_constant(method->name.lexeme));
+    }
+    emit(OP_POP);
+
+    if (stmt->superclass != nullptr)
+        end_scope();
+
+    return {};
+}
+
+Value Compiler::visitImportStmt(std::shared_ptr<ImportStmt> stmt)
+{
+    line = stmt->keyword.line;
+    emit_short(OP_IMPORT, make_constant(stmt->target->value));
+    return {};
+}
+
+
+Chunk& Compiler::chunk()
+{
+    return current->function->chunk;
+}
+
+void Compiler::emit(uint8_t byte)
+{
+    chunk().write(byte, line);
+}
+
+void Compiler::emit(uint8_t op, uint8_t operand)
+{
+    emit(op);
+    emit(operand);
+}
+
+void Compiler::emit_short(uint8_t op, int operand)
+{
+    emit(op);
+    emit((operand >> 8) & 0xff);
+    emit(operand & 0xff);
+}
+
+int Compiler::emit_jump(uint8_t op)
+{
+    emit(op);
+    emit(0xff);
+    emit(0xff);
+    return chunk().code.size() - 2;
+}
+
+void Compiler::patch_jump(int offset)
+{
+    // -2 to adjust for the jump offset itself
+    int jump = chunk().code.size() - offset - 2;
+
+    if (jump > UINT16_MAX)
+        Error::error(line, "Too much code to jump over");
+
+    chunk().code[offset] = (jump >> 8) & 0xff;
+    chunk().code[offset + 1] = jump & 0xff;
+}
+
+void Compiler::emit_loop(int loop_start)
+{
+    emit(OP_LOOP);
+
+    int offset = chunk().code.size() - loop_start + 2;
+    if (offset > UINT16_MAX)
+        Error::error(line, "Loop body too large");
+
+    emit((offset >> 8) & 0xff);
+    emit(offset & 0xff);
+}
+
+void Compiler::emit_return()
+{
+    if (current->type == FunctionType::INITIALIZER)
+        emit(OP_GET_LOCAL, 0);
+    else
+        emit(OP_NIL);
+
+    emit(OP_RETURN);
+}
+
+int Compiler::make_constant(Value value)
+{
+    int constant = chunk().add_constant(std::move(value));
+
+    if (constant > UINT16_MAX)
+    {
+        Error::error(line, "Too many constants in one chunk");
+        return 0;
+    }
+
+    return constant;
+}
+
+int Compiler::identifier_constant(const std::string& name)
+{
+    return make_constant(name);
+}
+
+int Compiler::global_operand(const std::string& name)
+{
+    int slot = global_slot(name);
+
+    if (slot > UINT16_MAX)
+    {
+        Error::error(line, "Too many global variables");
+        return 0;
+    }
+
+    return slot;
+}
+
+
+void Compiler::compile(std::shared_ptr<Stmt> stmt)
+{
+    stmt->accept(*this);
+}
+
+void Compiler::compile(const std::vector<std::shared_ptr<Stmt>>& statements)
+{
+    for (const std::shared_ptr<Stmt>& statement : statements)
+        compile(statement);
+}
+
+void Compiler::compile(std::shared_ptr<Expr> expr)
+{
+    expr->accept(*this);
+}
+
+void Compiler::function(std::shared_ptr<FunctionExpr> fn, FunctionType type, const std::string& name)
+{
+    FunctionState state;
+    begin_function(state, type, name);
+    state.function->arity = fn->parameters.size();
+
+    // parameters and the body share one scope, like Resolver::resolve_function
+    begin_scope();
+    for (const Token& param : fn->parameters)
+        add_local(param.lexeme);
+    compile(fn->body);
+
+    Ref<VmFunction> function = end_function();
+    emit_short(OP_CLOSURE, make_constant(function));
+
+    for (const UpvalueRef& upvalue : state.upvalues)
+    {
+        emit(upvalue.is_local ? 1 : 0);
+        emit(upvalue.index);
+    }
+}
+
+void Compiler::begin_function(FunctionState& state, FunctionType type, const std::string& name)
+{
+    state.enclosing = current;
+    state.function = new VmFunction();
+    state.function->name = name;
+    state.type = type;
+
+    // slot 0 holds the callee, or the receiver for methods
+    bool has_receiver = type == FunctionType::METHOD || type == FunctionType::INITIALIZER;
+    state.locals.push_back(Local{has_receiver ? "this" : "", 0});
+
+    current = &state;
+}
+
+Ref<VmFunction> Compiler::end_function()
+{
+    emit_return();
+
+    Ref<VmFunction> function = current->function;
+    function->upvalue_count = current->upvalues.size();
+    current = current->enclosing;
+
+    return function;
+}
+
+void Compiler::begin_scope()
+{
+    current->scope_depth++;
+}
+
+void Compiler::end_scope()
+{
+    current->scope_depth--;
+
+    while (!current->locals.empty() && current->locals.back().depth > current->scope_depth)
+    {
+        emit(current->locals.back().is_captured ? OP_CLOSE_UPVALUE : OP_POP);
+        current->locals.pop_back();
+    }
+}
+
+void Compiler::add_local(const std::string& name)
+{
+    if (current->locals.size() > UINT8_MAX)
+    {
+        Error::error(line, "Too many local variables in function");
+        return;
+    }
+
+    current->locals.push_back(Local{name, current->scope_depth});
+}
+
+void Compiler::declare_variable(const Token& name)
+{
+    // globals live in the VM's table, in the slot their name was given
+    if (current->scope_depth == 0)
+        return;
+
+    add_local(name.lexeme);
+}
+
+void Compiler::define_variable(const Token& name)
+{
+    if (current->scope_depth > 0)
+        return; // the value on top of the stack is the local's slot
+
+    emit_short(OP_DEFINE_GLOBAL, global_operand(name.lexeme));
+}
+
+int Compiler::resolve_local(FunctionState* state, const std::string& name)
+{
+    // first match is the outermost scope, mirroring Resolver::resolve_local
+    for (int i = 0; i < static_cast<int>(state->locals.size()); i++)
+    {
+        if (state->locals[i].name == name)
+            return i;
+    }
+
+    return -1;
+}
+
+int Compiler::resolve_upvalue(FunctionState* state, const std::string& name)
+{
+    if (state->enclosing == nullptr)
+        return -1;
+
+    // outer functions take precedence over inner ones
+    int upvalue = resolve_upvalue(state->enclosing, name);
+    if (upvalue != -1)
+        return add_upvalue(state, upvalue, false);
+
+    int local = resolve_local(state->enclosing, name);
+    if (local != -1)
+    {
+        state->enclosing->locals[local].is_captured = true;
+        return add_upvalue(state, local, true);
+    }
+
+    return -1;
+}
+
+int Compiler::add_upvalue(FunctionState* state, uint8_t index, bool is_local)
+{
+    for (int i = 0; i < static_cast<int>(state->upvalues.size()); i++)
+    {
+        if (state->upvalues[i].index == index && state->upvalues[i].is_local == is_local)
+            return i;
+    }
+
+    if (state->upvalues.size() > UINT8_MAX)
+    {
+        Error::error(line, "Too many closure variables in function");
+        return 0;
+    }
+
+    state->upvalues.push_back(UpvalueRef{index, is_local});
+    return state->upvalues.size() - 1;
+}
+
+void Compiler::named_variable(const Token& name)
+{
+    int arg = resolve_upvalue(current, name.lexeme);
+
+    if (arg != -1)
+    {
+        emit(OP_GET_UPVALUE, arg);
+    }
+    else if ((arg = resolve_local(current, name.lexeme)) != -1)
+    {
+        emit(OP_GET_LOCAL, arg);
+    }
+    else
+    {
+        emit_short(OP_GET_GLOBAL, global_operand(name.lexeme));
+    }
+}
+
+void Compiler::assign_variable(const Token& name)
+{
+    int arg = resolve_upvalue(current, name.lexeme);
+
+    if (arg != -1)
+    {
+        emit(OP_SET_UPVALUE, arg);
+    }
+    else if ((arg = resolve_local(current, name.lexeme)) != -1)
+    {
+        emit(OP_SET_LOCAL, arg);
+    }
+    else
+    {
+        emit_short(OP_SET_GLOBAL, global_operand(name.lexeme));
+    }
+}
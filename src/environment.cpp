@@ -4,56 +4,74 @@
 //------------------------------------//
 
 #include "environment.hpp"
+#include "symbol.hpp"
 
 Environment::Environment()
     : enclosing(nullptr) {}
 
-Environment::Environment(std::shared_ptr<Environment> enclosing)
-    : enclosing(std::move(enclosing)) {}
-
+// an environment on the heap, only --emit-c makes these for scopes its closures capture
+Environment::Environment(std::shared_ptr<Environment> enclosing, int slot_count)
+    : enclosing(enclosing.get()), owner(std::move(enclosing)), storage(slot_count)
+{
+    slots = storage.data();
+}
 
-std::any Environment::get(const Token& name)
+// a scope run by the interpreter, slots points into its frame stack or is null when the stack is full.
+// captured locals get their cells up front, so closures created before the declaration runs share them
+Environment::Environment(Environment* enclosing, Value* slots, int slot_count, const std::vector<int>& cells)
+    : enclosing(enclosing), slots(slots)
 {
-    auto element = values.find(name.lexeme);
+    if (slots == nullptr)
+    {
+        storage.resize(slot_count);
+        this->slots = storage.data();
+    }
 
-    // key found
-    if (element != values.end())
-        return element->second;
+    for (int slot : cells)
+        this->slots[slot] = new Cell();
+}
 
-    // enclosing environment
-    if (enclosing != nullptr)
-        return enclosing->get(name);
 
-    throw RuntimeError(name, "Undefined variable: '" + name.lexeme + "'");
+void Environment::assign(int slot, const Token& name, Value value)
+{
+    Value* found = global(slot);
+
+    if (found == nullptr)
+        undefined(name);
+
+    *found = std::move(value);
 }
 
-void Environment::assign(const Token& name, std::any value)
+// redefining a global reuses its slot
+void Environment::define(const std::string& name, Value value)
 {
-    auto element = values.find(name.lexeme);
+    size_t slot = global_slot(name);
 
-    if (element != values.end())
-    {
-        element->second = std::move(value);
-        return;
-    }
+    if (slot >= globals.size())
+        globals.resize(slot + 1);
 
-    if (enclosing != nullptr)
-    {
-        enclosing->assign(name, std::move(value));
-        return;
-    }
+    if (globals[slot] == nullptr)
+        globals[slot] = std::make_unique<Value>(std::move(value));
+    else
+        *globals[slot] = std::move(value);
+}
 
+void Environment::undefined(const Token& name)
+{
     throw RuntimeError(name, "Undefined variable: '" + name.lexeme + "'");
 }
 
-void Environment::define(const std::string& name, std::any value)
+void Environment::define_slot(int slot, Value value)
 {
-    values[name] = std::move(value);
+    if (slots[slot].is_object(ObjectType::CELL))
+        slots[slot].as<Cell>()->value = std::move(value);
+    else
+        slots[slot] = std::move(value);
 }
 
-std::shared_ptr<Environment> Environment::ancestor(int distance)
+Environment* Environment::ancestor(int distance)
 {
-    std::shared_ptr<Environment> environment = shared_from_this();
+    Environment* environment = this;
 
     for (int i = 0; i < distance; i++)
         environment = environment->enclosing;
@@ -61,12 +79,12 @@ std::shared_ptr<Environment> Environment::ancestor(int distance)
     return environment;
 }
 
-std::any Environment::get_at(int distance, const std::string& name)
+Value Environment::get_at(int distance, int slot)
 {
-    return ancestor(distance)->values[name];
+    return ancestor(distance)->slots[slot];
 }
 
-void Environment::assign_at(int distance, const Token& name, std::any value)
+void Environment::assign_at(int distance, int slot, Value value)
 {
-    ancestor(distance)->values[name.lexeme] = std::move(value);
+    ancestor(distance)->slots[slot] = std::move(value);
 }
@@ -7,133 +7,133 @@
 
 
 AssignExpr::AssignExpr(Token name, std::shared_ptr<Expr> value)
-    : name(std::move(name)), value(std::move(value)) {}
+    : Expr(ExprKind::ASSIGN), name(std::move(name)), value(std::move(value)) {}
 
-std::any AssignExpr::accept(ExprVisitor& visitor)
+Value AssignExpr::accept(ExprVisitor& visitor)
 {
     return visitor.visitAssignExpr(shared_from_this());
 }
 
 
 BinaryExpr::BinaryExpr(std::shared_ptr<Expr> left, Token op, std::shared_ptr<Expr> right)
-    : left(std::move(left)), op(std::move(op)), right(std::move(right)) {}
+    : Expr(ExprKind::BINARY), left(std::move(left)), op(std::move(op)), right(std::move(right)) {}
 
-std::any BinaryExpr::accept(ExprVisitor& visitor)
+Value BinaryExpr::accept(ExprVisitor& visitor)
 {
     return visitor.visitBinaryExpr(shared_from_this());
 }
 
 
 GroupingExpr::GroupingExpr(std::shared_ptr<Expr> expression)
-    : expression(std::move(expression)) {}
+    : Expr(ExprKind::GROUPING), expression(std::move(expression)) {}
 
-std::any GroupingExpr::accept(ExprVisitor& visitor)
+Value GroupingExpr::accept(ExprVisitor& visitor)
 {
     return visitor.visitGroupingExpr(shared_from_this());
 }
 
 
-LiteralExpr::LiteralExpr(std::any value)
-    : value(std::move(value)) {}
+LiteralExpr::LiteralExpr(Value value)
+    : Expr(ExprKind::LITERAL), value(std::move(value)) {}
 
-std::any LiteralExpr::accept(ExprVisitor& visitor)
+Value LiteralExpr::accept(ExprVisitor& visitor)
 {
     return visitor.visitLiteralExpr(shared_from_this());
 }
 
 
 UnaryExpr::UnaryExpr(Token op, std::shared_ptr<Expr> right)
-    : op(std::move(op)), right(std::move(right)) {}
+    : Expr(ExprKind::UNARY), op(std::move(op)), right(std::move(right)) {}
 
-std::any UnaryExpr::accept(ExprVisitor& visitor)
+Value UnaryExpr::accept(ExprVisitor& visitor)
 {
     return visitor.visitUnaryExpr(shared_from_this());
 }
 
 MutExpr::MutExpr(Token name)
-    : name(std::move(name)) {}
+    : Expr(ExprKind::MUT), name(std::move(name)) {}
 
-std::any MutExpr::accept(ExprVisitor& visitor)
+Value MutExpr::accept(ExprVisitor& visitor)
 {
     return visitor.visitMutExpr(shared_from_this());
 }
 
 
 LogicalExpr::LogicalExpr(std::shared_ptr<Expr> left, Token op, std::shared_ptr<Expr> right)
-    : left(std::move(left)), op(std::move(op)), right(std::move(right)) {}
+    : Expr(ExprKind::LOGICAL), left(std::move(left)), op(std::move(op)), right(std::move(right)) {}
 
-std::any LogicalExpr::accept(ExprVisitor& visitor)
+Value LogicalExpr::accept(ExprVisitor& visitor)
 {
     return visitor.visitLogicalExpr(shared_from_this());
 }
 
 CallExpr::CallExpr(std::shared_ptr<Expr> callee, Token paren, std::vector<std::shared_ptr<Expr>> arguments)
-    : callee{std::move(callee)}, paren{std::move(paren)}, arguments{std::move(arguments)} {}
+    : Expr(ExprKind::CALL), callee{std::move(callee)}, paren{std::move(paren)}, arguments{std::move(arguments)} {}
 
-std::any CallExpr::accept(ExprVisitor& visitor)
+Value CallExpr::accept(ExprVisitor& visitor)
 {
     return visitor.visitCallExpr(shared_from_this());
 }
 
 
 FunctionExpr::FunctionExpr(std::vector<Token> parameters, std::vector<std::shared_ptr<Stmt>> body)
-    : parameters(std::move(parameters)), body(std::move(body)) {}
+    : Expr(ExprKind::FUNCTION), parameters(std::move(parameters)), body(std::move(body)) {}
 
-std::any FunctionExpr::accept(ExprVisitor& visitor)
+Value FunctionExpr::accept(ExprVisitor& visitor)
 {
     return visitor.visitFunctionExpr(shared_from_this());
 }
 
 
 GetExpr::GetExpr(std::shared_ptr<Expr> object, Token name)
-    : object(std::move(object)), name(std::move(name)) {}
+    : Expr(ExprKind::GET), object(std::move(object)), name(std::move(name)), symbol(intern(this->name.lexeme)) {}
 
-std::any GetExpr::accept(ExprVisitor& visitor)
+Value GetExpr::accept(ExprVisitor& visitor)
 {
     return visitor.visitGetExpr(shared_from_this());
 }
 
 
 SetExpr::SetExpr(std::shared_ptr<Expr> object, Token name, std::shared_ptr<Expr> value)
-    : object(std::move(object)), name(std::move(name)), value(std::move(value)) {}
+    : Expr(ExprKind::SET), object(std::move(object)), name(std::move(name)), symbol(intern(this->name.lexeme)), value(std::move(value)) {}
 
-std::any SetExpr::accept(ExprVisitor& visitor)
+Value SetExpr::accept(ExprVisitor& visitor)
 {
     return visitor.visitSetExpr(shared_from_this());
 }
 
 
 ThisExpr::ThisExpr(Token keyword)
-    : keyword(std::move(keyword)) {}
+    : Expr(ExprKind::THIS), keyword(std::move(keyword)) {}
 
-std::any ThisExpr::accept(ExprVisitor& visitor)
+Value ThisExpr::accept(ExprVisitor& visitor)
 {
     return visitor.visitThisExpr(shared_from_this());
 }
 
 
 SuperExpr::SuperExpr(Token keyword, Token method)
-    : keyword(std::move(keyword)), method(std::move(method)) {}
+    : Expr(ExprKind::SUPER), keyword(std::move(keyword)), method(std::move(method)), symbol(intern(this->method.lexeme)) {}
 
-std::any SuperExpr::accept(ExprVisitor& visitor)
+Value SuperExpr::accept(ExprVisitor& visitor)
 {
     return visitor.visitSuperExpr(shared_from_this());
 }
 
 
 ListExpr::ListExpr(std::vector<std::shared_ptr<Expr>> elements)
-    : elements(std::move(elements)) {}
+    : Expr(ExprKind::LIST), elements(std::move(elements)) {}
 
-std::any ListExpr::accept(ExprVisitor& visitor)
+Value ListExpr::accept(ExprVisitor& visitor)
 {
     return visitor.visitListExpr(shared_from_this());
 }
 
 
 SubscriptExpr::SubscriptExpr(std::shared_ptr<Expr> name, Token paren, std::shared_ptr<Expr> index, std::shared_ptr<Expr> value)
-    : name(std::move(name)), paren(std::move(paren)), index(std::move(index)), value(std::move(value)) {}
+    : Expr(ExprKind::SUBSCRIPT), name(std::move(name)), paren(std::move(paren)), index(std::move(index)), value(std::move(value)) {}
 
-std::any SubscriptExpr::accept(ExprVisitor& visitor)
+Value SubscriptExpr::accept(ExprVisitor& visitor)
 {
     return visitor.visitSubscriptExpr(shared_from_this());
 }
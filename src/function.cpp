@@ -7,14 +7,14 @@
 
 #include "function.hpp"
 
-NblFunction::NblFunction(std::string name, std::shared_ptr<FunctionExpr> declaration, std::shared_ptr<Environment> closure, bool is_initializer)
-    : name(name), declaration(declaration), closure(closure), is_initializer(is_initializer) {}
+NblFunction::NblFunction(std::string name, std::shared_ptr<FunctionExpr> declaration, std::vector<Ref<Cell>> upvalues, bool is_initializer, std::shared_ptr<StmtFn> body)
+    : NblCallable(ObjectType::FUNCTION), name(name), declaration(declaration), upvalues(std::move(upvalues)), is_initializer(is_initializer), body(std::move(body)) {}
 
-std::shared_ptr<NblFunction> NblFunction::bind(std::shared_ptr<NblInstance> instance)
+Ref<NblFunction> NblFunction::bind(Ref<NblInstance> instance)
 {
-    auto environment = std::make_shared<Environment>(closure);
-    environment->define("this", instance);
-    return std::make_shared<NblFunction>(name, declaration, environment, is_initializer);
+    Ref<NblFunction> bound = new NblFunction(name, declaration, upvalues, is_initializer, body);
+    bound->receiver = instance;
+    return bound;
 }
 
 int NblFunction::arity()
@@ -22,27 +22,111 @@ int NblFunction::arity()
     return declaration->parameters.size();
 }
 
-std::any NblFunction::call(Interpreter& interpreter, std::vector<std::any> arguments)
+Value NblFunction::call(Interpreter& interpreter, const Token& paren, std::span<Value> arguments)
 {
-    auto environment = std::make_shared<Environment>(closure);
+    return invoke(interpreter, receiver, arguments);
+}
 
-    for (int i = 0; i < declaration->parameters.size(); i++)
-        environment->define(declaration->parameters[i].lexeme, arguments[i]);
+Value NblFunction::invoke(Interpreter& interpreter, const Value& self, std::span<Value> arguments)
+{
+    Value result = run(interpreter, self, arguments);
+
+    if (interpreter.tail_call == nullptr)
+        return result;
 
-    try
+    // a return in tail position leaves its call to us, running it here instead of in the
+    // function that returned it keeps the C++ stack and the frame stack from growing
+    std::vector<Value> pending;
+
+    while (interpreter.tail_call != nullptr)
     {
-        interpreter.execute_block(declaration->body, environment);
+        Ref<NblFunction> function = std::move(interpreter.tail_call);
+        Value target = std::move(interpreter.tail_receiver);
+        // swapping hands the buffers back and forth, so a loop of tail calls doesn't allocate
+        std::swap(pending, interpreter.tail_arguments);
+        result = function->run(interpreter, target, pending);
     }
-    catch(NblReturn r)
+
+    return result;
+}
+
+Value NblFunction::run(Interpreter& interpreter, const Value& self, std::span<Value> arguments)
+{
+    if (interpreter.jit_enabled && !jit_disabled && !is_initializer)
     {
-        if (is_initializer)
-            return closure->get_at(0, "this");
-        return r.value;
+        if (jit == nullptr && ++calls >= JitCompiler::THRESHOLD)
+        {
+            jit = JitCompiler::compile(this, interpreter);
+            jit_disabled = jit == nullptr;
+        }
+
+        Value result;
+        if (jit != nullptr && call_native(arguments, result))
+            return result;
     }
+
+    // nothing outside of the function is reachable through its environment, only through its upvalues,
+    // so the environment never outlives the call and its slots go on the frame stack
+    Value* frame = interpreter.push_frame(declaration->slot_count);
+    Environment environment(nullptr, frame, declaration->slot_count, declaration->cells);
+
+    for (int i = 0; i < declaration->parameters.size(); i++)
+        environment.define_slot(i, std::move(arguments[i]));
+
+    Value result = nullptr;
+    ExecResult completion;
+    std::vector<Ref<Cell>>* enclosing_upvalues = std::exchange(interpreter.upvalues, &upvalues);
+    const Value* enclosing_receiver = std::exchange(interpreter.receiver, &self);
+    interpreter.depth++;
+
+    if (body != nullptr)
+        completion = interpreter.execute_block(*body, &environment);
+    else
+        completion = interpreter.execute_block(declaration->body, &environment);
+
+    interpreter.upvalues = enclosing_upvalues;
+    interpreter.receiver = enclosing_receiver;
+    interpreter.pop_frame(frame);
+    interpreter.depth--;
+
+    if (completion == ExecResult::RETURN)
+        result = interpreter.take_return_value();
     
     if (is_initializer)
-        return closure->get_at(0, "this");
-    return nullptr;
+        return self;
+    return result;
+}
+
+// runs the native code, false sends the call to the interpreter
+bool NblFunction::call_native(std::span<Value> arguments, Value& result)
+{
+    double numbers[JitCompiler::MAX_ARGUMENTS];
+
+    for (size_t i = 0; i < arguments.size(); i++)
+    {
+        if (!arguments[i].is_number())
+            return false;
+        numbers[i] = arguments[i].as_number();
+    }
+
+    double number;
+
+    switch (jit->entry(numbers, &number))
+    {
+        case JIT_NUMBER:
+            result = number;
+            return true;
+
+        case JIT_NIL:
+            result = nullptr;
+            return true;
+
+        default:
+            // a guard failed somewhere down the call chain, the code only ever touched
+            // its own locals so running the call again in the interpreter is safe
+            jit_disabled = true;
+            return false;
+    }
 }
 
 std::string NblFunction::to_string()
@@ -3,29 +3,68 @@
 // Licensed under Apache License v2.0
 //------------------------------------//
 
+#include <algorithm>
+
 #include "instance.hpp"
 
-NblInstance::NblInstance(std::shared_ptr<NblClass> klass)
-    : klass(std::move(klass)) {}
+NblInstance::NblInstance(Ref<NblClass> klass)
+    : Object(ObjectType::INSTANCE), klass(std::move(klass))
+{
+    shape = &this->klass->shape;
+    fields.reserve(this->klass->field_count);
+}
 
-std::any NblInstance::get(const Token& name)
+const CacheEntry* NblInstance::lookup(Symbol name, InlineCache& cache)
 {
-    auto element = fields.find(name.lexeme);
+    if (const CacheEntry* entry = cache.find(shape->id, name))
+        return entry;
+
+    CacheEntry entry{shape->id, name, shape->find(name)};
+
+    if (entry.slot < 0)
+    {
+        entry.method = klass->find_method(name);
+
+        if (entry.method == nullptr)
+            return nullptr;
+    }
 
-    if (element != fields.end())
-        return element->second;
+    return cache.add(entry);
+}
+
+Value NblInstance::get(const Token& name, Symbol symbol, InlineCache& cache)
+{
+    const CacheEntry* entry = lookup(symbol, cache);
 
-    std::shared_ptr<NblFunction> method = klass->find_method(name.lexeme);
+    if (entry == nullptr)
+        throw RuntimeError(name, "Undefined property '" + name.lexeme + "'");
 
-    if (method != nullptr)
-        return method->bind(shared_from_this());
+    if (entry->slot >= 0)
+        return fields[entry->slot];
 
-    throw RuntimeError(name, "Undefined property '" + name.lexeme + "'");
+    return entry->method->bind(this);
 }
 
-void NblInstance::set(const Token& name, std::any value)
+void NblInstance::set(Symbol name, Value value, InlineCache& cache)
 {
-    fields[name.lexeme] = std::move(value);
+    const CacheEntry* entry = cache.find(shape->id, name);
+
+    if (entry == nullptr)
+    {
+        int slot = shape->find(name);
+        entry = cache.add(slot >= 0 ? CacheEntry{shape->id, name, slot}
+                                    : CacheEntry{shape->id, name, static_cast<int>(fields.size()), nullptr, shape->add(name)});
+    }
+
+    if (entry->next == nullptr)
+    {
+        fields[entry->slot] = std::move(value);
+        return;
+    }
+
+    shape = entry->next;
+    fields.push_back(std::move(value));
+    klass->field_count = std::max(klass->field_count, fields.size());
 }
 
 std::string NblInstance::to_string()
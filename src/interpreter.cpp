@@ -7,248 +7,355 @@
 
 Interpreter::Interpreter()
 {
-    globals->define("clock", std::make_shared<NativeClock>());
-    globals->define("time", std::make_shared<NativeTime>());
-    globals->define("input", std::make_shared<NativeInput>());
-    globals->define("exit", std::make_shared<NativeExit>());
-    globals->define("floordiv", std::make_shared<NativeFloorDiv>());
-    globals->define("len", std::make_shared<NativeArrayLen>());
+    for (const NativeDef& native : natives())
+        globals->define(native.name, new NblNative(native));
+}
+
+void Interpreter::set_engine(Engine engine)
+{
+    vm = nullptr;
+    closures = nullptr;
+
+    if (engine == Engine::BYTECODE)
+        vm = std::make_shared<VM>(*this);
+    else if (engine == Engine::CLOSURE)
+        closures = std::make_shared<ClosureCompiler>(*this);
 }
 
 void Interpreter::interpret(const std::vector<std::shared_ptr<Stmt>>& statements)
 {
+    if (vm != nullptr)
+    {
+        vm->interpret(statements);
+        return;
+    }
+
     try
     {
+        if (closures != nullptr)
+        {
+            closures->compile(statements)();
+            return;
+        }
+
+        // the parser rejects a break outside of a loop, so no top-level statement finishes with BREAK
         for (const std::shared_ptr<Stmt>& statement : statements)
-            execute(statement);
+            execute(statement.get());
     }
     catch (RuntimeError error)
     {
         Error::runtime_error(error);
+        unwind();
     }
 }
 
 std::string Interpreter::interpret(const std::shared_ptr<Expr>& expr)
 {
+    if (vm != nullptr)
+        return vm->interpret(expr);
+
     try
     {
-        std::any value = evaluate(expr);
+        Value value = closures != nullptr ? closures->compile(expr.get())() : evaluate(expr.get());
         return stringify(value);
     }
     catch(RuntimeError error)
     {
         Error::runtime_error(error);
+        unwind();
         return "";
     }
 }
 
-void Interpreter::resolve(std::shared_ptr<Expr> expr, int depth)
+// the error may have left us inside a block or function
+void Interpreter::unwind()
 {
-    locals[expr] = depth;
+    environment = globals.get();
+    pop_frame(stack.get());
+    tail_call = nullptr;
+    upvalues = nullptr;
+    receiver = nullptr;
+    depth = 0;
 }
 
-std::any Interpreter::visitBlockStmt(std::shared_ptr<BlockStmt> stmt)
+ExecResult Interpreter::exec_block(BlockStmt* stmt)
 {
-    execute_block(stmt->statements, std::make_shared<Environment>(environment));
-    return {};
+    if (!stmt->scoped)
+        return execute_block(stmt->statements, environment);
+
+    return execute_scope(stmt->statements, stmt->slot_count, stmt->cells);
 }
 
-std::any Interpreter::visitExpressionStmt(std::shared_ptr<ExpressionStmt> stmt)
+ExecResult Interpreter::exec_expression(ExpressionStmt* stmt)
 {
-    evaluate(stmt->expression);
-    return {};
+    evaluate(stmt->expression.get());
+    return ExecResult::NORMAL;
 }
 
-std::any Interpreter::visitPrintStmt(std::shared_ptr<PrintStmt> stmt)
+ExecResult Interpreter::exec_print(PrintStmt* stmt)
 {
-    std::any value = evaluate(stmt->expression);
+    Value value = evaluate(stmt->expression.get());
     std::cout << stringify(value) + "\n";
-    return {};
+    return ExecResult::NORMAL;
 }
 
-std::any Interpreter::visitMutStmt(std::shared_ptr<MutStmt> stmt)
+ExecResult Interpreter::exec_mut(MutStmt* stmt)
 {
-    std::any value = nullptr;
+    Value value = nullptr;
 
     if (stmt->initializer != nullptr)
-        value = evaluate(stmt->initializer);
+        value = evaluate(stmt->initializer.get());
 
-    environment->define(stmt->name.lexeme, std::move(value));
+    define(stmt->name, stmt->slot, std::move(value));
     
-    return {};
+    return ExecResult::NORMAL;
 }
 
-std::any Interpreter::visitIfStmt(std::shared_ptr<IfStmt> stmt)
+ExecResult Interpreter::exec_if(IfStmt* stmt)
 {
-    if (is_truthy(evaluate(stmt->condition)))
-        execute(stmt->then_branch);
+    if (is_truthy(evaluate(stmt->condition.get())))
+        return execute(stmt->then_branch.get());
     else if (stmt->else_branch != nullptr)
-        execute(stmt->else_branch);
+        return execute(stmt->else_branch.get());
     
-    return {};
+    return ExecResult::NORMAL;
 }
 
-std::any Interpreter::visitWhileStmt(std::shared_ptr<WhileStmt> stmt)
+ExecResult Interpreter::exec_while(WhileStmt* stmt)
 {
-    try
-    {
-        while (is_truthy(evaluate(stmt->condition)))
-            execute(stmt->body);
-    }
-    catch (BreakException* bex)
+    while (true)
     {
-        // pass
+        ExecResult result;
+
+        // held here too, a callout can throw the trace away while it runs
+        std::shared_ptr<LoopTrace> trace = jit_enabled ? stmt->trace : nullptr;
+
+        // a trace runs whole iterations natively, a side exit hands one back finished
+        if (trace == nullptr || !trace->run(*this, result))
+        {
+            if (!is_truthy(evaluate(stmt->condition.get())))
+                break;
+
+            if (jit_enabled && stmt->trace == nullptr && stmt->traceable && ++stmt->iterations >= LoopTrace::THRESHOLD)
+                result = TraceRecorder(*this, stmt).record();
+            else
+                result = execute(stmt->body.get());
+        }
+
+        if (trace != nullptr && trace->worn_out())
+        {
+            stmt->trace = nullptr;
+            stmt->traceable = false;
+        }
+
+        if (result == ExecResult::BREAK)
+            break;
+
+        if (result == ExecResult::RETURN)
+            return result;
     }
 
-    return {};
+    return ExecResult::NORMAL;
 }
 
-std::any Interpreter::visitFunctionStmt(std::shared_ptr<FunctionStmt> stmt)
+ExecResult Interpreter::exec_function(FunctionStmt* stmt)
 {
-    std::string func_name = stmt->name.lexeme;
-    auto function = std::make_shared<NblFunction>(func_name, stmt->fn, environment, false);
-    environment->define(func_name, function);
-    return {};
+    define(stmt->name, stmt->slot, new NblFunction(stmt->name.lexeme, stmt->fn, capture(stmt->fn.get()), false));
+    return ExecResult::NORMAL;
 }
 
-std::any Interpreter::visitReturnStmt(std::shared_ptr<ReturnStmt> stmt)
+ExecResult Interpreter::exec_return(ReturnStmt* stmt)
 {
-    std::any value = nullptr;
+    return_value = nullptr;
+
+    if (stmt->tail)
+    {
+        CallExpr* call = static_cast<CallExpr*>(stmt->value.get());
+        Value callee;
+        Value object;
+        NblFunction* method = nullptr;
+
+        if (call->callee->kind == ExprKind::GET)
+        {
+            GetExpr* get = static_cast<GetExpr*>(call->callee.get());
+            object = evaluate(get->object.get());
+            method = find_method(get, object, callee);
+        }
+        else
+        {
+            callee = evaluate(call->callee.get());
+        }
+
+        CallArguments arguments(*this, call->arguments.size());
 
-    if (stmt->value != nullptr)
-        value = evaluate(stmt->value);
+        for (size_t i = 0; i < call->arguments.size(); i++)
+            arguments.values[i] = evaluate(call->arguments[i].get());
 
-    throw NblReturn{value};
+        if (method != nullptr)
+            return_method(call->paren, method, object, arguments.values);
+        else
+            return_call(call->paren, callee, arguments.values);
+    }
+    else if (stmt->value != nullptr)
+    {
+        return_value = evaluate(stmt->value.get());
+    }
+
+    return ExecResult::RETURN;
+}
+
+ExecResult Interpreter::exec_break(BreakStmt* stmt)
+{
+    return ExecResult::BREAK;
 }
 
-std::any Interpreter::visitBreakStmt(std::shared_ptr<BreakStmt> stmt)
+ExecResult Interpreter::exec_class(ClassStmt* stmt)
 {
-    throw new BreakException();
+    declare_class(stmt, {});
+    return ExecResult::NORMAL;
 }
 
-std::any Interpreter::visitClassStmt(std::shared_ptr<ClassStmt> stmt)
+// bodies holds the methods' compiled bodies when running on the closure engine, and is empty otherwise
+void Interpreter::declare_class(ClassStmt* stmt, const std::vector<std::shared_ptr<StmtFn>>& bodies)
 {
-    std::any superclass;
+    Value superclass;
     if (stmt->superclass != nullptr)
     {
-        superclass = evaluate(stmt->superclass);
+        superclass = evaluate(stmt->superclass.get());
 
-        if (superclass.type() != typeid(std::shared_ptr<NblClass>))
+        if (!superclass.is_object(ObjectType::CLASS))
             throw RuntimeError(stmt->superclass->name, "Superclass must be a class");
     }
 
-    environment->define(stmt->name.lexeme, nullptr);
+    define(stmt->name, stmt->slot, nullptr);
+
+    std::optional<Environment> super_scope;
+    Value* frame = nullptr;
 
     if (stmt->superclass != nullptr)
     {
-        environment = std::make_shared<Environment>(environment);
-        environment->define("super", superclass);
+        // "super" is only ever used by methods, it always lives in a cell
+        frame = push_frame(1);
+        super_scope.emplace(environment, frame, 1, std::vector<int>{0});
+        super_scope->define_slot(0, superclass);
+        environment = &*super_scope;
     }
 
-    std::map<std::string, std::shared_ptr<NblFunction>> methods;
-    for (std::shared_ptr<FunctionStmt> method : stmt->methods)
+    std::map<std::string, Ref<NblFunction>> methods;
+    for (size_t i = 0; i < stmt->methods.size(); i++)
     {
+        const std::shared_ptr<FunctionStmt>& method = stmt->methods[i];
         bool is_method_init = method->name.lexeme == "init";
-        auto function = std::make_shared<NblFunction>(stmt->name.lexeme, method->fn, environment, is_method_init);
-        methods[method->name.lexeme] = function;
+        std::shared_ptr<StmtFn> body = bodies.empty() ? nullptr : bodies[i];
+
+        methods[method->name.lexeme] = new NblFunction(stmt->name.lexeme, method->fn, capture(method->fn.get()), is_method_init, std::move(body));
     }
 
-    std::shared_ptr<NblClass> superklass = nullptr;
-    if (superclass.type() == typeid(std::shared_ptr<NblClass>))
-        superklass = std::any_cast<std::shared_ptr<NblClass>>(superclass);
+    Ref<NblClass> superklass = nullptr;
+    if (superclass.is_object(ObjectType::CLASS))
+        superklass = superclass.as<NblClass>();
 
-    auto klass = std::make_shared<NblClass>(stmt->name.lexeme, superklass, methods);
+    Value klass = new NblClass(stmt->name.lexeme, superklass, std::move(methods));
 
     if (superklass != nullptr)
+    {
         environment = environment->enclosing;
+        pop_frame(frame);
+    }
 
-    environment->assign(stmt->name, std::move(klass));
-
-    return {};
+    define(stmt->name, stmt->slot, std::move(klass));
 }
 
-std::any Interpreter::visitImportStmt(std::shared_ptr<ImportStmt> stmt)
+ExecResult Interpreter::exec_import(ImportStmt* stmt)
 {
-    std::string target = std::any_cast<std::string>(stmt->target->value);
+    const std::string& target = stmt->target->value.as_string();
     run_file(target, *this);
-    return {};
+    return ExecResult::NORMAL;
 }
 
 
-std::any Interpreter::visitAssignExpr(std::shared_ptr<AssignExpr> expr)
+Value Interpreter::eval_assign(AssignExpr* expr)
 {
-    std::any value = evaluate(expr->value);
+    Value value = evaluate(expr->value.get());
     // environment->assign(expr->name, value);
 
-    auto element = locals.find(expr);
-
-    if (element != locals.end())
+    if (expr->binding.depth >= 0)
     {
-        int distance = element->second;
-        environment->assign_at(distance, expr->name, value);
+        local(expr->binding) = value;
     }
     else
     {
-        globals->assign(expr->name, value);
+        globals->assign(expr->binding.slot, expr->name, value);
     }
 
+    if (!expr->generic && value.is_number())
+        quicken_assign(expr);
+
     return value;
 }
 
-std::any Interpreter::visitBinaryExpr(std::shared_ptr<BinaryExpr> expr)
+Value Interpreter::eval_binary(BinaryExpr* expr)
 {
     // evaluate binary operators
-    std::any left = evaluate(expr->left);
-    std::any right = evaluate(expr->right);
+    Value left = evaluate(expr->left.get());
+    Value right = evaluate(expr->right.get());
 
-    switch (expr->op.type)
+    if (!expr->generic && left.is_number() && right.is_number())
+        quicken_binary(expr);
+
+    return binary_operation(expr->op, left, right);
+}
+
+Value Interpreter::binary_operation(const Token& op, const Value& left, const Value& right)
+{
+    switch (op.type)
     {
         // comparisors
         case BANG_EQUAL: return !is_equal(left, right);
         case EQUAL_EQUAL: return is_equal(left, right);
         case GREATER:
-            check_num_operands(expr->op, left, right);
-            return std::any_cast<double>(left) > std::any_cast<double>(right);
+            check_num_operands(op, left, right);
+            return num_greater(left, right);
         case GREATER_EQUAL:
-            check_num_operands(expr->op, left, right);
-            return std::any_cast<double>(left) >= std::any_cast<double>(right);
+            check_num_operands(op, left, right);
+            return num_greater_equal(left, right);
         case LESS:
-            check_num_operands(expr->op, left, right);
-            return std::any_cast<double>(left) < std::any_cast<double>(right);
+            check_num_operands(op, left, right);
+            return num_less(left, right);
         case LESS_EQUAL:
-            check_num_operands(expr->op, left, right);
-            return std::any_cast<double>(left) <= std::any_cast<double>(right);
+            check_num_operands(op, left, right);
+            return num_less_equal(left, right);
         case STAR_STAR:
-            check_num_operands(expr->op, left, right);
-            return pow(std::any_cast<double>(left), std::any_cast<double>(right));
+            check_num_operands(op, left, right);
+            return num_power(left, right);
 
         // arithmetics
         case PLUS: case PLUS_EQUAL:
-            if (left.type() == typeid(double) && right.type() == typeid(double))
-                return std::any_cast<double>(left) + std::any_cast<double>(right);
+            if (left.is_number() && right.is_number())
+                return num_add(left, right);
 
-            if (left.type() == typeid(std::string) && right.type() == typeid(std::string))
-                return std::any_cast<std::string>(left) + std::any_cast<std::string>(right);
+            if (left.is_string() && right.is_string())
+                return left.as_string() + right.as_string();
 
-            if (left.type() == typeid(std::string) && right.type() == typeid(double))
-                return std::any_cast<std::string>(left) + int_or_double(right);
+            if (left.is_string() && right.is_number())
+                return left.as_string() + stringify(right);
 
-            if (left.type() == typeid(double) && right.type() == typeid(std::string))
-                return int_or_double(left) + std::any_cast<std::string>(right);
+            if (left.is_number() && right.is_string())
+                return stringify(left) + right.as_string();
 
-            throw RuntimeError{expr->op, "Operands must be 2 numbers, 2 strings, or 1 number and 1 string"};
+            throw RuntimeError{op, "Operands must be 2 numbers, 2 strings, or 1 number and 1 string"};
         case MINUS: case MINUS_EQUAL:
-            if (left.type() == typeid(double) && right.type() == typeid(double))
-                return std::any_cast<double>(left) - std::any_cast<double>(right);
+            if (left.is_number() && right.is_number())
+                return num_subtract(left, right);
         case STAR: case STAR_EQUAL:
-            if (left.type() == typeid(double) && right.type() == typeid(double))
-                return std::any_cast<double>(left) * std::any_cast<double>(right);
+            if (left.is_number() && right.is_number())
+                return num_multiply(left, right);
         case SLASH: case SLASH_EQUAL:
-            if (left.type() == typeid(double) && right.type() == typeid(double))
-                return std::any_cast<double>(left) / std::any_cast<double>(right);
+            if (left.is_number() && right.is_number())
+                return num_divide(left, right);
         case PERCENT:
-            if (left.type() == typeid(double) && right.type() == typeid(double))
-                return fmod(std::any_cast<double>(left), std::any_cast<double>(right));
+            if (left.is_number() && right.is_number())
+                return num_modulo(left, right);
     
         default: break;
     }
@@ -256,22 +363,22 @@ std::any Interpreter::visitBinaryExpr(std::shared_ptr<BinaryExpr> expr)
     return {}; // unreachable, here to make the compiler happy
 }
 
-std::any Interpreter::visitGroupingExpr(std::shared_ptr<GroupingExpr> expr)
+Value Interpreter::eval_grouping(GroupingExpr* expr)
 {
     // evaluating parentheses
-    return evaluate(expr->expression);
+    return evaluate(expr->expression.get());
 }
 
-std::any Interpreter::visitLiteralExpr(std::shared_ptr<LiteralExpr> expr)
+Value Interpreter::eval_literal(LiteralExpr* expr)
 {
     // evaluating literals
     return expr->value;
 }
 
-std::any Interpreter::visitUnaryExpr(std::shared_ptr<UnaryExpr> expr)
+Value Interpreter::eval_unary(UnaryExpr* expr)
 {
     // evaluate unary expressions
-    std::any right = evaluate(expr->right);
+    Value right = evaluate(expr->right.get());
 
     switch (expr->op.type)
     {
@@ -280,7 +387,7 @@ std::any Interpreter::visitUnaryExpr(std::shared_ptr<UnaryExpr> expr)
 
         case MINUS:
             check_num_operand(expr->op, right);
-            return -std::any_cast<double>(right);
+            return num_negate(right);
         
         default:
             break;
@@ -289,21 +396,21 @@ std::any Interpreter::visitUnaryExpr(std::shared_ptr<UnaryExpr> expr)
     return {}; // unreachable, here to make the compiler happy
 }
 
-std::any Interpreter::visitMutExpr(std::shared_ptr<MutExpr> expr)
+Value Interpreter::eval_mut(MutExpr* expr)
 {
-    // std::any value = environment->get(expr->name);
+    // Value value = environment->get(expr->name);
 
     // if (value.type() == typeid(nullptr))
     //     throw RuntimeError{expr->name, "Variable not initialized"};
 
     // return value;
 
-    return lookup_mut(expr->name, expr);
+    return lookup_mut(expr->name, expr->binding);
 }
 
-std::any Interpreter::visitLogicalExpr(std::shared_ptr<LogicalExpr> expr)
+Value Interpreter::eval_logical(LogicalExpr* expr)
 {
-    std::any left = evaluate(expr->left);
+    Value left = evaluate(expr->left.get());
 
     if (expr->op.type == OR)
     {
@@ -316,136 +423,378 @@ std::any Interpreter::visitLogicalExpr(std::shared_ptr<LogicalExpr> expr)
             return left;
     }
 
-    return evaluate(expr->right);
+    return evaluate(expr->right.get());
 }
 
-std::any Interpreter::visitCallExpr(std::shared_ptr<CallExpr> expr)
+Value Interpreter::eval_call(CallExpr* expr)
 {
-    std::any callee = evaluate(expr->callee);
-    std::vector<std::any> arguments;
+    if (expr->callee->kind == ExprKind::GET)
+        return eval_invoke(expr);
 
-    for (const std::shared_ptr<Expr>& argument : expr->arguments)
-        arguments.push_back(evaluate(argument));
+    Value callee = evaluate(expr->callee.get());
 
-    // pointers in a std::any wrapper must be unwrapped before they can be cast
-    std::shared_ptr<NblCallable> function;
+    if (!expr->generic && callee.is_object(ObjectType::FUNCTION))
+        expr->kind = ExprKind::CALL_FUNCTION;
+    else if (!expr->generic && expr->intrinsic != Intrinsic::NONE && is_intrinsic(callee, expr->intrinsic))
+        expr->kind = ExprKind::CALL_INTRINSIC;
 
-    if (callee.type() == typeid(std::shared_ptr<NblFunction>))
-    {
-        function = std::any_cast<std::shared_ptr<NblFunction>>(callee);
-    }
-    else if (callee.type() == typeid(std::shared_ptr<NblClass>))
-    {
-        function = std::any_cast<std::shared_ptr<NblClass>>(callee);
-    }
-    else if (callee.type() == typeid(std::shared_ptr<NativeClock>))
+    return call_value(expr, callee);
+}
+
+// object.name(...) runs the method with object as its receiver, no bound method is created
+Value Interpreter::eval_invoke(CallExpr* expr)
+{
+    GetExpr* get = static_cast<GetExpr*>(expr->callee.get());
+    Value object = evaluate(get->object.get());
+    Value field;
+    NblFunction* method = find_method(get, object, field);
+
+    if (method == nullptr) // a field, called like any other value
+        return call_value(expr, field);
+
+    CallArguments arguments(*this, expr->arguments.size());
+
+    for (size_t i = 0; i < expr->arguments.size(); i++)
+        arguments.values[i] = evaluate(expr->arguments[i].get());
+
+    if (arguments.values.size() != static_cast<size_t>(method->arity()))
+        throw RuntimeError(expr->paren, method->arity_error(arguments.values.size()));
+
+    check_stack(expr->paren);
+    return method->invoke(*this, object, arguments.values);
+}
+
+// what get names on object, a method is returned unbound and a field is put in field instead
+NblFunction* Interpreter::find_method(GetExpr* get, const Value& object, Value& field)
+{
+    if (!object.is_object(ObjectType::INSTANCE))
+        throw RuntimeError(get->name, "Only instances have properties");
+
+    NblInstance* instance = object.as<NblInstance>();
+
+    const CacheEntry* entry = instance->lookup(get->symbol, get->cache);
+
+    if (entry == nullptr)
+        throw RuntimeError(get->name, "Undefined property '" + get->name.lexeme + "'");
+
+    if (entry->slot >= 0)
+        field = instance->fields[entry->slot];
+
+    return entry->method;
+}
+
+Value Interpreter::call_value(CallExpr* expr, const Value& callee)
+{
+    CallArguments arguments(*this, expr->arguments.size());
+
+    for (size_t i = 0; i < expr->arguments.size(); i++)
+        arguments.values[i] = evaluate(expr->arguments[i].get());
+
+    return call(expr->paren, callee, arguments.values);
+}
+
+Value Interpreter::call(const Token& paren, const Value& callee, std::span<Value> arguments)
+{
+    NblCallable* function = as_callable(callee);
+
+    if (function == nullptr)
+        throw RuntimeError(paren, "Can only call functions");
+
+    if (!function->accepts(arguments.size()))
+        throw RuntimeError(paren, function->arity_error(arguments.size()));
+
+    check_stack(paren);
+    return function->call(*this, paren, arguments);
+}
+
+// a call in tail position, a script function is left for NblFunction::call to run once the
+// function returning it is gone, anything else is called right away
+void Interpreter::return_call(const Token& paren, const Value& callee, std::span<Value> arguments)
+{
+    if (!callee.is_object(ObjectType::FUNCTION))
     {
-        function = std::any_cast<std::shared_ptr<NativeClock>>(callee);
+        return_value = call(paren, callee, arguments);
+        return;
     }
-    else if (callee.type() == typeid(std::shared_ptr<NativeTime>))
+
+    NblFunction* function = callee.as<NblFunction>();
+    return_method(paren, function, function->receiver, arguments);
+}
+
+void Interpreter::return_method(const Token& paren, NblFunction* method, const Value& receiver, std::span<Value> arguments)
+{
+    if (arguments.size() != static_cast<size_t>(method->arity()))
+        throw RuntimeError(paren, method->arity_error(arguments.size()));
+
+    if (method->is_initializer)
     {
-        function = std::any_cast<std::shared_ptr<NativeTime>>(callee);
+        check_stack(paren);
+        return_value = method->invoke(*this, receiver, arguments);
+        return;
     }
-    else if (callee.type() == typeid(std::shared_ptr<NativeInput>))
+
+    tail_call = method;
+    tail_receiver = receiver;
+    tail_arguments.assign(std::make_move_iterator(arguments.begin()), std::make_move_iterator(arguments.end()));
+}
+
+// quickened expressions, each checks the guard its node was specialized on and
+// falls back to the generic version for good if it doesn't hold
+
+static void despecialize(Expr* expr, ExprKind kind)
+{
+    expr->kind = kind;
+    expr->generic = true;
+}
+
+static const Value& increment_of(AssignExpr* expr)
+{
+    BinaryExpr* binary = static_cast<BinaryExpr*>(expr->value.get());
+    return static_cast<LiteralExpr*>(binary->right.get())->value;
+}
+
+void Interpreter::quicken_binary(BinaryExpr* expr)
+{
+    switch (expr->op.type)
     {
-        function = std::any_cast<std::shared_ptr<NativeInput>>(callee);
+        case PLUS: case PLUS_EQUAL: expr->kind = ExprKind::ADD_NUMBERS; break;
+        case MINUS: case MINUS_EQUAL: expr->kind = ExprKind::SUBTRACT_NUMBERS; break;
+        case STAR: case STAR_EQUAL: expr->kind = ExprKind::MULTIPLY_NUMBERS; break;
+        case SLASH: case SLASH_EQUAL: expr->kind = ExprKind::DIVIDE_NUMBERS; break;
+        case PERCENT: expr->kind = ExprKind::MODULO_NUMBERS; break;
+        case LESS_EQUAL: expr->kind = ExprKind::LESS_EQUAL_NUMBERS; break;
+        case GREATER: expr->kind = ExprKind::GREATER_NUMBERS; break;
+        case GREATER_EQUAL: expr->kind = ExprKind::GREATER_EQUAL_NUMBERS; break;
+        case EQUAL_EQUAL: expr->kind = ExprKind::EQUAL_NUMBERS; break;
+        case BANG_EQUAL: expr->kind = ExprKind::NOT_EQUAL_NUMBERS; break;
+
+        case LESS:
+        {
+            // loop conditions like i < n read the local straight from its slot
+            MutExpr* local = dynamic_cast<MutExpr*>(expr->left.get());
+            expr->kind = local != nullptr && local->binding.depth >= 0 ? ExprKind::LESS_LOCAL_NUMBERS : ExprKind::LESS_NUMBERS;
+            break;
+        }
+
+        default:
+            expr->generic = true; // no number variant
+            break;
     }
-    else if (callee.type() == typeid(std::shared_ptr<NativeExit>))
+}
+
+// i += 1 (or i = i + 1) becomes a single add in place
+void Interpreter::quicken_assign(AssignExpr* expr)
+{
+    expr->generic = true; // one try, whether it matches or not
+
+    BinaryExpr* binary = dynamic_cast<BinaryExpr*>(expr->value.get());
+
+    if (binary == nullptr || (binary->op.type != PLUS && binary->op.type != PLUS_EQUAL))
+        return;
+
+    MutExpr* target = dynamic_cast<MutExpr*>(binary->left.get());
+    LiteralExpr* increment = dynamic_cast<LiteralExpr*>(binary->right.get());
+
+    if (target == nullptr || increment == nullptr || !increment->value.is_number())
+        return;
+
+    if (target->name.lexeme != expr->name.lexeme || target->binding.depth != expr->binding.depth || target->binding.slot != expr->binding.slot)
+        return;
+
+    expr->kind = expr->binding.depth >= 0 ? ExprKind::INCREMENT_LOCAL : ExprKind::INCREMENT_GLOBAL;
+}
+
+Value Interpreter::eval_binary_numbers(BinaryExpr* expr)
+{
+    Value left = evaluate(expr->left.get());
+    Value right = evaluate(expr->right.get());
+
+    if (!left.is_number() || !right.is_number())
     {
-        std::shared_ptr<NativeExit> func = std::any_cast<std::shared_ptr<NativeExit>>(callee);
-        func->param_count = arguments.size() > 0 ? 1 : 0;
-        function = func;
+        despecialize(expr, ExprKind::BINARY);
+        return binary_operation(expr->op, left, right);
     }
-    else if (callee.type() == typeid(std::shared_ptr<NativeFloorDiv>))
+
+    switch (expr->kind)
     {
-        function = std::any_cast<std::shared_ptr<NativeFloorDiv>>(callee);
+        case ExprKind::ADD_NUMBERS: return num_add(left, right);
+        case ExprKind::SUBTRACT_NUMBERS: return num_subtract(left, right);
+        case ExprKind::MULTIPLY_NUMBERS: return num_multiply(left, right);
+        case ExprKind::DIVIDE_NUMBERS: return num_divide(left, right);
+        case ExprKind::MODULO_NUMBERS: return num_modulo(left, right);
+        case ExprKind::LESS_NUMBERS: return num_less(left, right);
+        case ExprKind::LESS_EQUAL_NUMBERS: return num_less_equal(left, right);
+        case ExprKind::GREATER_NUMBERS: return num_greater(left, right);
+        case ExprKind::GREATER_EQUAL_NUMBERS: return num_greater_equal(left, right);
+        case ExprKind::EQUAL_NUMBERS: return num_equal(left, right);
+        case ExprKind::NOT_EQUAL_NUMBERS: return !num_equal(left, right);
+        default: break;
     }
-    else if (callee.type() == typeid(std::shared_ptr<NativeArrayLen>))
+
+    return {}; // unreachable
+}
+
+Value Interpreter::eval_less_local(BinaryExpr* expr)
+{
+    MutExpr* local = static_cast<MutExpr*>(expr->left.get());
+    Value left = this->local(local->binding);
+    Value right = evaluate(expr->right.get());
+
+    if (left.is_number() && right.is_number())
+        return num_less(left, right);
+
+    despecialize(expr, ExprKind::BINARY);
+    return binary_operation(expr->op, left, right);
+}
+
+// x ** 2 as x * x, the operand is only evaluated once
+Value Interpreter::eval_square(BinaryExpr* expr)
+{
+    Value left = evaluate(expr->left.get());
+
+    if (left.is_number())
+        return num_multiply(left, left);
+
+    return binary_operation(expr->op, left, static_cast<LiteralExpr*>(expr->right.get())->value);
+}
+
+Value Interpreter::eval_increment_local(AssignExpr* expr)
+{
+    Value& slot = local(expr->binding);
+
+    if (slot.is_number())
+        return slot = num_add(slot, increment_of(expr));
+
+    despecialize(expr, ExprKind::ASSIGN);
+    return eval_assign(expr);
+}
+
+Value Interpreter::eval_increment_global(AssignExpr* expr)
+{
+    Value* global = globals->global(expr->binding.slot);
+
+    if (global != nullptr && global->is_number())
+        return *global = num_add(*global, increment_of(expr));
+
+    despecialize(expr, ExprKind::ASSIGN);
+    return eval_assign(expr);
+}
+
+Value Interpreter::eval_call_function(CallExpr* expr)
+{
+    Value callee = evaluate(expr->callee.get());
+
+    if (!callee.is_object(ObjectType::FUNCTION))
     {
-        function = std::any_cast<std::shared_ptr<NativeArrayLen>>(callee);
+        despecialize(expr, ExprKind::CALL);
+        return call_value(expr, callee);
     }
-    else
+
+    NblFunction* function = callee.as<NblFunction>();
+    CallArguments arguments(*this, expr->arguments.size());
+
+    for (size_t i = 0; i < expr->arguments.size(); i++)
+        arguments.values[i] = evaluate(expr->arguments[i].get());
+
+    if (arguments.values.size() != static_cast<size_t>(function->arity()))
+        throw RuntimeError(expr->paren, function->arity_error(arguments.values.size()));
+
+    check_stack(expr->paren);
+    return function->call(*this, expr->paren, arguments.values);
+}
+
+// len(list) and the like, run right here while the global still holds the builtin
+Value Interpreter::eval_call_intrinsic(CallExpr* expr)
+{
+    Value callee = evaluate(expr->callee.get());
+    Value values[2];
+    std::span<Value> arguments(values, expr->arguments.size());
+
+    for (size_t i = 0; i < arguments.size(); i++)
+        arguments[i] = evaluate(expr->arguments[i].get());
+
+    if (!is_intrinsic(callee, expr->intrinsic))
     {
-        throw RuntimeError(expr->paren, "Can only call functions");
+        despecialize(expr, ExprKind::CALL);
+        return call(expr->paren, callee, arguments);
     }
 
-    if (arguments.size() != function->arity())
-        throw RuntimeError(expr->paren, "Expected " + std::to_string(function->arity()) + " arguments but got " + std::to_string(arguments.size()));
-
-    return function->call(*this, std::move(arguments));
+    return run_intrinsic(expr->intrinsic, expr->paren, arguments);
 }
 
-std::any Interpreter::visitFunctionExpr(std::shared_ptr<FunctionExpr> expr)
+Value Interpreter::eval_function(FunctionExpr* expr)
 {
-    return std::make_shared<NblFunction>("", expr, environment, false);
+    return new NblFunction("", expr->shared_from_this(), capture(expr), false);
 }
 
-std::any Interpreter::visitGetExpr(std::shared_ptr<GetExpr> expr)
+Value Interpreter::eval_get(GetExpr* expr)
 {
-    std::any object = evaluate(expr->object);
+    Value object = evaluate(expr->object.get());
 
-    if (object.type() == typeid(std::shared_ptr<NblInstance>))
-        return std::any_cast<std::shared_ptr<NblInstance>>(object)->get(expr->name);
+    if (object.is_object(ObjectType::INSTANCE))
+        return object.as<NblInstance>()->get(expr->name, expr->symbol, expr->cache);
 
     throw RuntimeError(expr->name, "Only instances have properties");
 }
 
-std::any Interpreter::visitSetExpr(std::shared_ptr<SetExpr> expr)
+Value Interpreter::eval_set(SetExpr* expr)
 {
-    std::any object = evaluate(expr->object);
+    Value object = evaluate(expr->object.get());
 
-    if (object.type() != typeid(std::shared_ptr<NblInstance>))
+    if (!object.is_object(ObjectType::INSTANCE))
         throw RuntimeError(expr->name, "Only instances have fields");
 
-    std::any value = evaluate(expr->value);
-    std::any_cast<std::shared_ptr<NblInstance>>(object)->set(expr->name, value);
+    Value value = evaluate(expr->value.get());
+    object.as<NblInstance>()->set(expr->symbol, value, expr->cache);
 
     return value;
 }
 
-std::any Interpreter::visitThisExpr(std::shared_ptr<ThisExpr> expr)
+Value Interpreter::eval_this(ThisExpr* expr)
 {
-    return lookup_mut(expr->keyword, expr);
+    if (expr->binding.receiver)
+        return *receiver;
+
+    return lookup_mut(expr->keyword, expr->binding);
 }
 
-std::any Interpreter::visitSuperExpr(std::shared_ptr<SuperExpr> expr)
+Value Interpreter::eval_super(SuperExpr* expr)
 {
-    int distance = locals[expr];
-    auto superclass = std::any_cast<std::shared_ptr<NblClass>>(environment->get_at(distance, "super"));
-    auto obj = std::any_cast<std::shared_ptr<NblInstance>>(environment->get_at(distance - 1, "this"));
-    std::shared_ptr<NblFunction> method = superclass->find_method(expr->method.lexeme);
+    Value superclass = local(expr->binding);
+    Value obj = expr->this_binding.receiver ? *receiver : local(expr->this_binding);
+    NblFunction* method = superclass.as<NblClass>()->find_method(expr->symbol);
 
     if (method == nullptr) // can't find method
         throw RuntimeError(expr->method, "Undefined property '" + expr->method.lexeme + "'");
 
-    return method->bind(obj);
+    return method->bind(obj.as<NblInstance>());
 }
 
-std::any Interpreter::visitListExpr(std::shared_ptr<ListExpr> expr)
+Value Interpreter::eval_list(ListExpr* expr)
 {
-    auto list = std::make_shared<ListType>();
+    Ref<ListType> list = new ListType();
 
-    for (std::shared_ptr<Expr>& value : expr->elements)
-        list->append(evaluate(value));
+    for (const std::shared_ptr<Expr>& value : expr->elements)
+        list->append(evaluate(value.get()));
 
     return list;
 }
 
-std::any Interpreter::visitSubscriptExpr(std::shared_ptr<SubscriptExpr> expr)
+Value Interpreter::eval_subscript(SubscriptExpr* expr)
 {
-    std::any name = evaluate(expr->name);
-    std::any index = evaluate(expr->index);
+    Value name = evaluate(expr->name.get());
+    Value index = evaluate(expr->index.get());
 
-    if (name.type() == typeid(std::shared_ptr<ListType>))
+    if (name.is_object(ObjectType::LIST))
     {
-        if (index.type() == typeid(double))
+        if (index.is_number())
         {
-            std::shared_ptr<ListType> list = std::any_cast<std::shared_ptr<ListType>>(name);
-            int casted_index = std::any_cast<double>(index);
+            ListType* list = name.as<ListType>();
+            int casted_index = num_index(index);
 
             if (expr->value != nullptr)
             {
-                std::any value = evaluate(expr->value);
+                Value value = evaluate(expr->value.get());
 
                 if (list->set_element_at(casted_index, value))
                     return value;
@@ -474,112 +823,245 @@ std::any Interpreter::visitSubscriptExpr(std::shared_ptr<SubscriptExpr> expr)
 }
 
 
-std::any Interpreter::lookup_mut(const Token& name, std::shared_ptr<Expr> expr)
+Value Interpreter::lookup_mut(const Token& name, const Binding& binding)
 {
-    auto element = locals.find(expr);
-
-    if (element != locals.end())
+    if (binding.depth >= 0)
     {
-        int distance = element->second;
-        return environment->get_at(distance, name.lexeme);
+        return local(binding);
     }
     else
     {
-        return globals->get(name);
+        return globals->get(binding.slot, name);
     }
 }
 
-std::any Interpreter::evaluate(std::shared_ptr<Expr> expr)
+// the cells a function closes over, taken from where it's being created
+std::vector<Ref<Cell>> Interpreter::capture(FunctionExpr* fn)
 {
-    // send expression back into interpreter's visitor methods for evaluation
-    return expr->accept(*this);
+    std::vector<Ref<Cell>> cells;
+    cells.reserve(fn->captures.size());
+
+    for (const Capture& capture : fn->captures)
+    {
+        switch (capture.kind)
+        {
+            case Capture::LOCAL:
+                cells.push_back(environment->ancestor(capture.depth)->slots[capture.slot].as<Cell>());
+                break;
+            case Capture::UPVALUE:
+                cells.push_back((*upvalues)[capture.index]);
+                break;
+            case Capture::THIS:
+            {
+                // "this" can't be assigned to, every closure may as well get a cell of its own
+                Ref<Cell> self = new Cell();
+                self->value = *receiver;
+                cells.push_back(std::move(self));
+                break;
+            }
+        }
+    }
+
+    return cells;
 }
 
-void Interpreter::execute(std::shared_ptr<Stmt> stmt)
+Value Interpreter::evaluate(Expr* expr)
 {
-    stmt->accept(*this);
+    // dispatch on the node kind, the static_casts are safe since each kind has one node type
+    switch (expr->kind)
+    {
+        case ExprKind::ASSIGN: return eval_assign(static_cast<AssignExpr*>(expr));
+        case ExprKind::BINARY: return eval_binary(static_cast<BinaryExpr*>(expr));
+        case ExprKind::GROUPING: return eval_grouping(static_cast<GroupingExpr*>(expr));
+        case ExprKind::LITERAL: return eval_literal(static_cast<LiteralExpr*>(expr));
+        case ExprKind::UNARY: return eval_unary(static_cast<UnaryExpr*>(expr));
+        case ExprKind::MUT: return eval_mut(static_cast<MutExpr*>(expr));
+        case ExprKind::LOGICAL: return eval_logical(static_cast<LogicalExpr*>(expr));
+        case ExprKind::CALL: return eval_call(static_cast<CallExpr*>(expr));
+        case ExprKind::FUNCTION: return eval_function(static_cast<FunctionExpr*>(expr));
+        case ExprKind::GET: return eval_get(static_cast<GetExpr*>(expr));
+        case ExprKind::SET: return eval_set(static_cast<SetExpr*>(expr));
+        case ExprKind::THIS: return eval_this(static_cast<ThisExpr*>(expr));
+        case ExprKind::SUPER: return eval_super(static_cast<SuperExpr*>(expr));
+        case ExprKind::LIST: return eval_list(static_cast<ListExpr*>(expr));
+        case ExprKind::SUBSCRIPT: return eval_subscript(static_cast<SubscriptExpr*>(expr));
+
+        case ExprKind::ADD_NUMBERS:
+        case ExprKind::SUBTRACT_NUMBERS:
+        case ExprKind::MULTIPLY_NUMBERS:
+        case ExprKind::DIVIDE_NUMBERS:
+        case ExprKind::MODULO_NUMBERS:
+        case ExprKind::LESS_NUMBERS:
+        case ExprKind::LESS_EQUAL_NUMBERS:
+        case ExprKind::GREATER_NUMBERS:
+        case ExprKind::GREATER_EQUAL_NUMBERS:
+        case ExprKind::EQUAL_NUMBERS:
+        case ExprKind::NOT_EQUAL_NUMBERS:
+            return eval_binary_numbers(static_cast<BinaryExpr*>(expr));
+        case ExprKind::LESS_LOCAL_NUMBERS: return eval_less_local(static_cast<BinaryExpr*>(expr));
+        case ExprKind::INCREMENT_LOCAL: return eval_increment_local(static_cast<AssignExpr*>(expr));
+        case ExprKind::INCREMENT_GLOBAL: return eval_increment_global(static_cast<AssignExpr*>(expr));
+        case ExprKind::CALL_FUNCTION: return eval_call_function(static_cast<CallExpr*>(expr));
+        case ExprKind::CALL_INTRINSIC: return eval_call_intrinsic(static_cast<CallExpr*>(expr));
+        case ExprKind::SQUARE: return eval_square(static_cast<BinaryExpr*>(expr));
+    }
+
+    return {}; // unreachable, here to make the compiler happy
 }
 
-void Interpreter::execute_block(const std::vector<std::shared_ptr<Stmt>>& statements, std::shared_ptr<Environment> environment)
+// declarations in a local scope go straight to their slot
+void Interpreter::define(const Token& name, int slot, Value value)
 {
-    std::shared_ptr<Environment> previous_env = this->environment;
+    if (slot < 0)
+        environment->define(name.lexeme, std::move(value));
+    else
+        environment->define_slot(slot, std::move(value));
+}
 
-    try
+ExecResult Interpreter::execute(Stmt* stmt)
+{
+    switch (stmt->kind)
     {
-        this->environment = environment;
-
-        for (const std::shared_ptr<Stmt>& statement : statements)
-            execute(statement);
+        case StmtKind::BLOCK: return exec_block(static_cast<BlockStmt*>(stmt));
+        case StmtKind::EXPRESSION: return exec_expression(static_cast<ExpressionStmt*>(stmt));
+        case StmtKind::PRINT: return exec_print(static_cast<PrintStmt*>(stmt));
+        case StmtKind::MUT: return exec_mut(static_cast<MutStmt*>(stmt));
+        case StmtKind::IF: return exec_if(static_cast<IfStmt*>(stmt));
+        case StmtKind::WHILE: return exec_while(static_cast<WhileStmt*>(stmt));
+        case StmtKind::FUNCTION: return exec_function(static_cast<FunctionStmt*>(stmt));
+        case StmtKind::RETURN: return exec_return(static_cast<ReturnStmt*>(stmt));
+        case StmtKind::BREAK: return exec_break(static_cast<BreakStmt*>(stmt));
+        case StmtKind::CLASS: return exec_class(static_cast<ClassStmt*>(stmt));
+        case StmtKind::IMPORT: return exec_import(static_cast<ImportStmt*>(stmt));
     }
-    catch (...)
+
+    return ExecResult::NORMAL; // unreachable
+}
+
+ExecResult Interpreter::execute_block(const std::vector<std::shared_ptr<Stmt>>& statements, Environment* environment)
+{
+    Environment* previous_env = this->environment;
+    this->environment = environment;
+
+    ExecResult result = ExecResult::NORMAL;
+
+    for (const std::shared_ptr<Stmt>& statement : statements)
     {
-        this->environment = previous_env;
-        throw;
+        result = execute(statement.get());
+
+        if (result != ExecResult::NORMAL)
+            break;
     }
 
+    // runtime errors don't restore the environment, interpret() resets it
     this->environment = previous_env;
+    return result;
+}
+
+// runs a body compiled by the closure engine, see execute_block above
+ExecResult Interpreter::execute_block(const StmtFn& body, Environment* environment)
+{
+    Environment* previous_env = this->environment;
+    this->environment = environment;
+
+    ExecResult result = body();
+
+    this->environment = previous_env;
+    return result;
+}
+
+// runs a block in a scope of its own, nothing outlives the scope but the cells of captured locals,
+// so its slots are on the frame stack and its environment on the C++ stack
+ExecResult Interpreter::execute_scope(const std::vector<std::shared_ptr<Stmt>>& statements, int slot_count, const std::vector<int>& cells)
+{
+    Value* frame = push_frame(slot_count);
+    Environment scope(environment, frame, slot_count, cells);
+
+    ExecResult result = execute_block(statements, &scope);
+
+    pop_frame(frame);
+    return result;
+}
+
+ExecResult Interpreter::execute_scope(const StmtFn& body, int slot_count, const std::vector<int>& cells)
+{
+    Value* frame = push_frame(slot_count);
+    Environment scope(environment, frame, slot_count, cells);
+
+    ExecResult result = execute_block(body, &scope);
+
+    pop_frame(frame);
+    return result;
+}
+
+Value Interpreter::take_return_value()
+{
+    return std::move(return_value);
 }
 
-void Interpreter::check_num_operand(const Token& op, const std::any& operand)
+void Interpreter::check_num_operand(const Token& op, const Value& operand)
 {
-    if (operand.type() == typeid(double))
+    if (operand.is_number())
         return;
     
     throw RuntimeError{op, "Operand must be a number"};
 }
 
-void Interpreter::check_num_operands(const Token& op, const std::any& left, const std::any& right)
+void Interpreter::check_num_operands(const Token& op, const Value& left, const Value& right)
 {
-    if (left.type() == typeid(double) && right.type() == typeid(double))
+    if (left.is_number() && right.is_number())
         return;
     
     throw RuntimeError{op, "Operands must be numbers"};
 }
 
-bool Interpreter::is_truthy(const std::any& obj)
+bool Interpreter::is_truthy(const Value& obj)
 {
-    if (obj.type() == typeid(nullptr))
-        return false;
-    
-    if (obj.type() == typeid(bool))
-        return std::any_cast<bool>(obj);
-    
-    return true;
+    return !obj.is_falsey();
 }
 
-bool Interpreter::is_equal(const std::any& obj1, const std::any& obj2)
+bool Interpreter::is_equal(const Value& obj1, const Value& obj2)
 {
-    if (obj1.type() == typeid(nullptr) && obj2.type() == typeid(nullptr))
-        return true;
+    if (obj1.is_number() && obj2.is_number())
+        return num_equal(obj1, obj2);
 
-    if (obj1.type() == typeid(nullptr))
-        return false;
+    if (obj1.is_string() && obj2.is_string())
+        return obj1.as_string() == obj2.as_string();
 
-    if (obj1.type() == typeid(std::string) && obj2.type() == typeid(std::string))
-        return std::any_cast<std::string>(obj1) == std::any_cast<std::string>(obj2);
+    // nil and booleans are equal when their bits are, any other object never is
+    return !obj1.is_object() && obj1.same(obj2);
+}
 
-    if (obj1.type() == typeid(double) && obj2.type() == typeid(double))
-        return std::any_cast<double>(obj1) == std::any_cast<double>(obj2);
+NblCallable* Interpreter::as_callable(const Value& obj)
+{
+    if (!obj.is_object())
+        return nullptr;
 
-    if (obj1.type() == typeid(bool) && obj2.type() == typeid(bool))
-        return std::any_cast<bool>(obj1) == std::any_cast<bool>(obj2);
+    switch (obj.as_object()->type)
+    {
+        case ObjectType::FUNCTION:
+        case ObjectType::CLASS:
+        case ObjectType::NATIVE:
+            return obj.as<NblCallable>();
 
-    return false;
+        default:
+            return nullptr;
+    }
 }
 
-std::string Interpreter::int_or_double(const std::any& obj)
+std::string Interpreter::int_or_double(double number)
 {
     std::string text;
 
-    if (std::any_cast<double>(obj) == static_cast<int>(std::any_cast<double>(obj)))
+    if (number == static_cast<int>(number))
     {
         // is an integer
-        text = std::to_string(static_cast<int>(std::any_cast<double>(obj)));
+        text = std::to_string(static_cast<int>(number));
     }
     else
     {
         // is a double
-        text = std::to_string(std::any_cast<double>(obj));
+        text = std::to_string(number);
 
         if (text[text.length() - 2] == '.' && text[text.length() - 1] == '0')
             text = text.substr(0, text.length() - 2);
@@ -588,66 +1070,51 @@ std::string Interpreter::int_or_double(const std::any& obj)
     return text;
 }
 
-std::string Interpreter::stringify(const std::any& obj)
+std::string Interpreter::stringify(const Value& obj)
 {
-    if (obj.type() == typeid(nullptr))
+    if (obj.is_nil())
         return "nil";
 
-    if (obj.type() == typeid(double))
-        return int_or_double(obj);
-
-    if (obj.type() == typeid(std::string))
-        return std::any_cast<std::string>(obj);
-
-    if (obj.type() == typeid(bool))
-        return std::any_cast<bool>(obj) ? "true" : "false";
-    
-    if (obj.type() == typeid(std::shared_ptr<NblFunction>))
-        return std::any_cast<std::shared_ptr<NblFunction>>(obj)->to_string();
-
-    if (obj.type() == typeid(std::shared_ptr<NblClass>))
-        return std::any_cast<std::shared_ptr<NblClass>>(obj)->to_string();
+    // an int prints as the double it equals, so no program can tell the two apart
+    if (obj.is_number())
+        return int_or_double(obj.as_number());
 
-    if (obj.type() == typeid(std::shared_ptr<NblInstance>))
-        return std::any_cast<std::shared_ptr<NblInstance>>(obj)->to_string();
-    
-    if (obj.type() == typeid(std::shared_ptr<NativeClock>))
-        return std::any_cast<std::shared_ptr<NativeClock>>(obj)->to_string();
+    if (obj.is_bool())
+        return obj.as_bool() ? "true" : "false";
 
-    if (obj.type() == typeid(std::shared_ptr<NativeTime>))
-        return std::any_cast<std::shared_ptr<NativeTime>>(obj)->to_string();
-    
-    if (obj.type() == typeid(std::shared_ptr<NativeInput>))
-        return std::any_cast<std::shared_ptr<NativeInput>>(obj)->to_string();
+    switch (obj.as_object()->type)
+    {
+        case ObjectType::STRING:
+            return obj.as_string();
 
-    if (obj.type() == typeid(std::shared_ptr<NativeExit>))
-        return std::any_cast<std::shared_ptr<NativeExit>>(obj)->to_string();
+        case ObjectType::FUNCTION:
+        case ObjectType::CLASS:
+        case ObjectType::NATIVE:
+            return obj.as<NblCallable>()->to_string();
 
-    if (obj.type() == typeid(std::shared_ptr<NativeFloorDiv>))
-        return std::any_cast<std::shared_ptr<NativeFloorDiv>>(obj)->to_string();
+        case ObjectType::INSTANCE:
+            return obj.as<NblInstance>()->to_string();
 
-    if (obj.type() == typeid(std::shared_ptr<NativeArrayLen>))
-        return std::any_cast<std::shared_ptr<NativeArrayLen>>(obj)->to_string();
+        case ObjectType::LIST:
+        {
+            std::string result = "[";
+            std::vector<Value>& elements = obj.as<ListType>()->elements;
 
-    if (obj.type() == typeid(std::shared_ptr<ListType>))
-    {
-        std::string result = "[";
-        std::shared_ptr<ListType> list = std::any_cast<std::shared_ptr<ListType>>(obj);
-        std::vector<std::any> elements = list->elements;
+            for (auto i = elements.begin(); i != elements.end(); i++)
+            {
+                auto next = i + 1;
 
-        for (auto i = elements.begin(); i != elements.end(); i++)
-        {
-            auto next = i + 1;
+                result.append(stringify(*i));
 
-            result.append(stringify(*i));
+                if (next != elements.end())
+                    result.append(", ");
+            }
 
-            if (next != elements.end())
-                result.append(", ");
+            result.append("]");
+            return result;
         }
 
-        result.append("]");
-        return result;
+        default:
+            return "Error in stringify: Invalid object type";
     }
-
-    return "Error in stringify: Invalid object type";
 }
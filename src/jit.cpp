@@ -0,0 +1,661 @@
+//------------------------------------//
+// Copyright 2024 Nam Nguyen
+// Licensed under Apache License v2.0
+//------------------------------------//
+
+#include <cmath>
+#include <cstring>
+
+#include "assembler.hpp"
+#include "jit.hpp"
+#include "function.hpp"
+#include "environment.hpp"
+
+#ifdef NBL_JIT
+#include <sys/mman.h>
+#endif
+
+JitCode::~JitCode()
+{
+#ifdef NBL_JIT
+    if (memory != nullptr)
+        munmap(memory, size);
+#endif
+}
+
+#ifdef NBL_JIT
+
+bool Assembler::install(JitCode& result)
+{
+    void* memory = mmap(nullptr, code.size(), PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+
+    if (memory == MAP_FAILED)
+        return false;
+
+    std::memcpy(memory, code.data(), code.size());
+
+    if (mprotect(memory, code.size(), PROT_READ | PROT_EXEC) != 0)
+    {
+        munmap(memory, code.size());
+        return false;
+    }
+
+    result.memory = memory;
+    result.size = code.size();
+    result.entry = reinterpret_cast<JitEntry>(memory);
+    return true;
+}
+
+// thrown while emitting when the function uses something the JIT doesn't handle
+struct JitUnsupported {};
+
+// Emits code for one function. Every value is a double kept in the stack frame:
+//   [rbp - 8]           result pointer
+//   [rbp - 16 - 8 * i]  local i (parameters first, then the locals of every block)
+//   after the locals    temporaries
+// xmm0 holds the value of the expression being emitted.
+class JitEmitter : Assembler
+{
+    private:
+        NblFunction* function;
+        Environment& globals;
+        size_t* depth; // the interpreter's, compiled calls count towards --max-stack too
+        size_t max_depth;
+
+        std::vector<int> scopes; // index of each open scope's slot 0
+        int next_local = 0;
+        int local_count = 0;
+        int temps = 0;
+        int max_temps = 0;
+
+        size_t body_start = 0; // right after the parameters are loaded, where a tail call jumps back to
+        std::vector<size_t> bail_jumps;
+        std::vector<std::vector<size_t>> loop_exits; // break jumps of each enclosing loop
+        std::shared_ptr<JitCode> result = std::make_shared<JitCode>();
+
+        int32_t local_offset(int local) { return -16 - 8 * local; }
+        int32_t temp_offset(int temp) { return -16 - 8 * (local_count + temp); }
+
+        int push_temp(int count = 1)
+        {
+            int temp = temps;
+            temps += count;
+            max_temps = std::max(max_temps, temps);
+            return temp;
+        }
+
+        void pop_temp(int count = 1) { temps -= count; }
+
+        int local(const Binding& binding)
+        {
+            int scope = static_cast<int>(scopes.size()) - 1 - binding.depth;
+
+            if (binding.depth < 0 || scope < 0 || binding.cell) // globals and captured variables stay in the interpreter
+                throw JitUnsupported{};
+
+            return scopes[scope] + binding.slot;
+        }
+
+        void load(int32_t offset) { emit({0xF2, 0x0F, 0x10, 0x85}); emit32(offset); } // movsd xmm0, [rbp + offset]
+        void store(int32_t offset) { emit({0xF2, 0x0F, 0x11, 0x85}); emit32(offset); } // movsd [rbp + offset], xmm0
+
+        void load_constant(double number)
+        {
+            uint64_t bits;
+            std::memcpy(&bits, &number, 8);
+            emit({0x48, 0xB8}); emit64(bits); // mov rax, imm64
+            emit({0x66, 0x48, 0x0F, 0x6E, 0xC0}); // movq xmm0, rax
+        }
+
+        void leave_with(int status)
+        {
+            emit({0x48, 0xB9}); emit64(reinterpret_cast<uint64_t>(depth)); // mov rcx, &depth
+            emit({0x48, 0xFF, 0x09}); // dec qword [rcx]
+            emit({0xB8}); emit32(status); // mov eax, status
+            emit({0xC9, 0xC3}); // leave, ret
+        }
+
+        // left in xmm0, right in xmm1
+        void operands(BinaryExpr* expr)
+        {
+            number(expr->left.get());
+            int temp = push_temp();
+            store(temp_offset(temp));
+            number(expr->right.get());
+            emit({0xF2, 0x0F, 0x10, 0xC8}); // movsd xmm1, xmm0
+            load(temp_offset(temp));
+            pop_temp();
+        }
+
+        void number(Expr* expr);
+        void guard(const Value& global);
+        void call(CallExpr* expr);
+        bool tail_call(CallExpr* expr);
+        void branch(Expr* expr, bool when, std::vector<size_t>& targets);
+        void statement(Stmt* stmt);
+        void count_locals(Stmt* stmt);
+
+    public:
+        JitEmitter(NblFunction* function, Interpreter& interpreter)
+            : function(function), globals(*interpreter.globals), depth(&interpreter.depth), max_depth(interpreter.max_stack) {}
+
+        std::shared_ptr<JitCode> compile();
+};
+
+void JitEmitter::number(Expr* expr)
+{
+    switch (generic_kind(expr->kind))
+    {
+        case ExprKind::LITERAL:
+        {
+            const Value& value = static_cast<LiteralExpr*>(expr)->value;
+
+            if (!value.is_number())
+                throw JitUnsupported{};
+
+            load_constant(value.as_number());
+            return;
+        }
+
+        case ExprKind::GROUPING:
+            number(static_cast<GroupingExpr*>(expr)->expression.get());
+            return;
+
+        case ExprKind::MUT:
+            load(local_offset(local(static_cast<MutExpr*>(expr)->binding)));
+            return;
+
+        case ExprKind::ASSIGN:
+        {
+            AssignExpr* assign = static_cast<AssignExpr*>(expr);
+            int target = local(assign->binding);
+
+            number(assign->value.get());
+            store(local_offset(target));
+            return;
+        }
+
+        case ExprKind::UNARY:
+        {
+            UnaryExpr* unary = static_cast<UnaryExpr*>(expr);
+
+            if (unary->op.type != MINUS)
+                throw JitUnsupported{};
+
+            number(unary->right.get());
+            emit({0x48, 0xB8}); emit64(0x8000000000000000); // mov rax, sign bit
+            emit({0x66, 0x48, 0x0F, 0x6E, 0xC8}); // movq xmm1, rax
+            emit({0x66, 0x0F, 0x57, 0xC1}); // xorpd xmm0, xmm1
+            return;
+        }
+
+        case ExprKind::CALL:
+            call(static_cast<CallExpr*>(expr));
+            return;
+
+        case ExprKind::BINARY:
+        {
+            BinaryExpr* binary = static_cast<BinaryExpr*>(expr);
+
+            switch (binary->op.type)
+            {
+                case PLUS: case PLUS_EQUAL:
+                    operands(binary);
+                    emit({0xF2, 0x0F, 0x58, 0xC1}); // addsd xmm0, xmm1
+                    return;
+                case MINUS: case MINUS_EQUAL:
+                    operands(binary);
+                    emit({0xF2, 0x0F, 0x5C, 0xC1}); // subsd xmm0, xmm1
+                    return;
+                case STAR: case STAR_EQUAL:
+                    operands(binary);
+                    emit({0xF2, 0x0F, 0x59, 0xC1}); // mulsd xmm0, xmm1
+                    return;
+                case SLASH: case SLASH_EQUAL:
+                    operands(binary);
+                    emit({0xF2, 0x0F, 0x5E, 0xC1}); // divsd xmm0, xmm1
+                    return;
+                case PERCENT:
+                    operands(binary);
+                    call_absolute(reinterpret_cast<const void*>(static_cast<double (*)(double, double)>(&std::fmod)));
+                    return;
+                case STAR_STAR:
+                    operands(binary);
+                    call_absolute(reinterpret_cast<const void*>(static_cast<double (*)(double, double)>(&std::pow)));
+                    return;
+                default:
+                    throw JitUnsupported{}; // comparisons only appear as conditions
+            }
+        }
+
+        default:
+            throw JitUnsupported{};
+    }
+}
+
+// calls to a global function that is this one or already compiled, guarded on the global still holding it
+void JitEmitter::call(CallExpr* expr)
+{
+    MutExpr* callee = dynamic_cast<MutExpr*>(expr->callee.get());
+
+    if (callee == nullptr || callee->binding.depth >= 0 || expr->arguments.size() > JitCompiler::MAX_ARGUMENTS)
+        throw JitUnsupported{};
+
+    Value* global = globals.global(callee->binding.slot);
+
+    if (global == nullptr || !global->is_object(ObjectType::FUNCTION))
+        throw JitUnsupported{};
+
+    NblFunction* target = global->as<NblFunction>();
+    bool is_self = target == function;
+
+    if (!is_self && (target->jit == nullptr || target->jit_disabled))
+        throw JitUnsupported{};
+
+    if (static_cast<int>(expr->arguments.size()) != target->arity())
+        throw JitUnsupported{};
+
+    guard(*global);
+
+    // arguments go into consecutive temporaries, first argument at the lowest address
+    int count = expr->arguments.size();
+    int base = push_temp(count + 1); // the last one receives the result
+
+    for (int i = 0; i < count; i++)
+    {
+        number(expr->arguments[i].get());
+        store(temp_offset(base + count - 1 - i));
+    }
+
+    emit({0x48, 0x8D, 0xBD}); emit32(temp_offset(base + count - 1)); // lea rdi, [arguments]
+    emit({0x48, 0x8D, 0xB5}); emit32(temp_offset(base + count)); // lea rsi, [result]
+
+    if (is_self)
+    {
+        emit({0xE8}); emit32(0); // call rel32 to our own entry
+        patch(code.size() - 4, 0);
+    }
+    else
+    {
+        call_absolute(reinterpret_cast<const void*>(target->jit->entry));
+        result->callees.push_back(*global);
+        result->dependencies.push_back(target->jit);
+    }
+
+    emit({0x85, 0xC0}); // test eax, eax
+    bail_jumps.push_back(jump({0x0F, 0x85})); // anything but a number: jnz bail
+
+    load(temp_offset(base + count));
+    pop_temp(count + 1);
+}
+
+// return f(...) where f is this function, the arguments become the parameters and the body starts over
+bool JitEmitter::tail_call(CallExpr* expr)
+{
+    MutExpr* callee = dynamic_cast<MutExpr*>(expr->callee.get());
+
+    if (callee == nullptr || callee->binding.depth >= 0)
+        return false;
+
+    Value* global = globals.global(callee->binding.slot);
+
+    if (global == nullptr || !global->is_object(ObjectType::FUNCTION))
+        return false;
+
+    if (global->as<NblFunction>() != function || static_cast<int>(expr->arguments.size()) != function->arity())
+        return false;
+
+    guard(*global);
+
+    // every argument is evaluated before the first parameter is overwritten
+    int count = expr->arguments.size();
+    int base = push_temp(count);
+
+    for (int i = 0; i < count; i++)
+    {
+        number(expr->arguments[i].get());
+        store(temp_offset(base + i));
+    }
+
+    for (int i = 0; i < count; i++)
+    {
+        load(temp_offset(base + i));
+        store(local_offset(i));
+    }
+
+    pop_temp(count);
+    patch(jump({0xE9}), body_start);
+    return true;
+}
+
+// bails out unless the global's bits haven't changed since compiling
+void JitEmitter::guard(const Value& global)
+{
+    uint64_t expected;
+    std::memcpy(&expected, &global, 8);
+    emit({0x48, 0xB8}); emit64(reinterpret_cast<uint64_t>(&global)); // mov rax, &global
+    emit({0x48, 0x8B, 0x00}); // mov rax, [rax]
+    emit({0x48, 0xB9}); emit64(expected); // mov rcx, expected
+    emit({0x48, 0x39, 0xC8}); // cmp rax, rcx
+    bail_jumps.push_back(jump({0x0F, 0x85})); // jne bail
+}
+
+// jumps to targets when expr evaluates to when, falls through otherwise
+void JitEmitter::branch(Expr* expr, bool when, std::vector<size_t>& targets)
+{
+    switch (generic_kind(expr->kind))
+    {
+        case ExprKind::GROUPING:
+            branch(static_cast<GroupingExpr*>(expr)->expression.get(), when, targets);
+            return;
+
+        case ExprKind::LITERAL:
+        {
+            const Value& value = static_cast<LiteralExpr*>(expr)->value;
+
+            if (!value.is_bool())
+                throw JitUnsupported{};
+
+            if (value.as_bool() == when)
+                targets.push_back(jump({0xE9})); // jmp
+            return;
+        }
+
+        case ExprKind::UNARY:
+        {
+            UnaryExpr* unary = static_cast<UnaryExpr*>(expr);
+
+            if (unary->op.type != BANG)
+                throw JitUnsupported{};
+
+            branch(unary->right.get(), !when, targets);
+            return;
+        }
+
+        case ExprKind::LOGICAL:
+        {
+            LogicalExpr* logical = static_cast<LogicalExpr*>(expr);
+            bool is_or = logical->op.type == OR;
+
+            // "a or b" jumping on true and "a and b" jumping on false short circuit straight to the target
+            if (is_or == when)
+            {
+                branch(logical->left.get(), when, targets);
+                branch(logical->right.get(), when, targets);
+                return;
+            }
+
+            std::vector<size_t> skip;
+            branch(logical->left.get(), !when, skip);
+            branch(logical->right.get(), when, targets);
+            patch_all(skip, code.size());
+            return;
+        }
+
+        case ExprKind::BINARY:
+            break;
+
+        default:
+            throw JitUnsupported{};
+    }
+
+    BinaryExpr* binary = static_cast<BinaryExpr*>(expr);
+    TokenType op = binary->op.type;
+
+    if (op != LESS && op != LESS_EQUAL && op != GREATER && op != GREATER_EQUAL && op != EQUAL_EQUAL && op != BANG_EQUAL)
+        throw JitUnsupported{};
+
+    operands(binary);
+
+    // ucomisd sets CF and ZF (and PF) for unordered, so NaN compares false like in C++
+    if (op == LESS || op == LESS_EQUAL)
+        emit({0x66, 0x0F, 0x2E, 0xC8}); // ucomisd xmm1, xmm0
+    else
+        emit({0x66, 0x0F, 0x2E, 0xC1}); // ucomisd xmm0, xmm1
+
+    switch (op)
+    {
+        case LESS: case GREATER:
+            targets.push_back(jump({0x0F, static_cast<uint8_t>(when ? 0x87 : 0x86)})); // ja / jbe
+            return;
+
+        case LESS_EQUAL: case GREATER_EQUAL:
+            targets.push_back(jump({0x0F, static_cast<uint8_t>(when ? 0x83 : 0x82)})); // jae / jb
+            return;
+
+        default:
+            break;
+    }
+
+    // equal means ZF set and PF clear
+    bool jump_on_equal = (op == EQUAL_EQUAL) == when;
+
+    if (jump_on_equal)
+    {
+        size_t unordered = jump({0x0F, 0x8A}); // jp over
+        targets.push_back(jump({0x0F, 0x84})); // je
+        patch(unordered, code.size());
+    }
+    else
+    {
+        targets.push_back(jump({0x0F, 0x85})); // jne
+        targets.push_back(jump({0x0F, 0x8A})); // jp
+    }
+}
+
+void JitEmitter::statement(Stmt* stmt)
+{
+    switch (stmt->kind)
+    {
+        case StmtKind::BLOCK:
+        {
+            BlockStmt* block = static_cast<BlockStmt*>(stmt);
+
+            if (block->scoped)
+            {
+                scopes.push_back(next_local);
+                next_local += block->slot_count;
+            }
+
+            for (const std::shared_ptr<Stmt>& inner : block->statements)
+                statement(inner.get());
+
+            if (block->scoped)
+                scopes.pop_back();
+            return;
+        }
+
+        case StmtKind::EXPRESSION:
+            number(static_cast<ExpressionStmt*>(stmt)->expression.get());
+            return;
+
+        case StmtKind::MUT:
+        {
+            MutStmt* mut = static_cast<MutStmt*>(stmt);
+
+            if (mut->initializer == nullptr || mut->slot < 0) // nil isn't a number
+                throw JitUnsupported{};
+
+            number(mut->initializer.get());
+            store(local_offset(scopes.back() + mut->slot));
+            return;
+        }
+
+        case StmtKind::IF:
+        {
+            IfStmt* branch_stmt = static_cast<IfStmt*>(stmt);
+            std::vector<size_t> else_jumps;
+
+            branch(branch_stmt->condition.get(), false, else_jumps);
+            statement(branch_stmt->then_branch.get());
+
+            if (branch_stmt->else_branch == nullptr)
+            {
+                patch_all(else_jumps, code.size());
+                return;
+            }
+
+            size_t end = jump({0xE9});
+            patch_all(else_jumps, code.size());
+            statement(branch_stmt->else_branch.get());
+            patch(end, code.size());
+            return;
+        }
+
+        case StmtKind::WHILE:
+        {
+            WhileStmt* loop = static_cast<WhileStmt*>(stmt);
+            size_t start = code.size();
+            std::vector<size_t> exits;
+
+            branch(loop->condition.get(), false, exits);
+
+            loop_exits.emplace_back();
+            statement(loop->body.get());
+            size_t back = jump({0xE9});
+            patch(back, start);
+
+            patch_all(exits, code.size());
+            patch_all(loop_exits.back(), code.size());
+            loop_exits.pop_back();
+            return;
+        }
+
+        case StmtKind::BREAK:
+            if (loop_exits.empty())
+                throw JitUnsupported{};
+
+            loop_exits.back().push_back(jump({0xE9}));
+            return;
+
+        case StmtKind::RETURN:
+        {
+            ReturnStmt* ret = static_cast<ReturnStmt*>(stmt);
+
+            if (ret->value == nullptr)
+            {
+                leave_with(JIT_NIL);
+                return;
+            }
+
+            if (ret->tail && tail_call(static_cast<CallExpr*>(ret->value.get())))
+                return;
+
+            number(ret->value.get());
+            emit({0x48, 0x8B, 0x85}); emit32(-8); // mov rax, [rbp - 8]
+            emit({0xF2, 0x0F, 0x11, 0x00}); // movsd [rax], xmm0
+            leave_with(JIT_NUMBER);
+            return;
+        }
+
+        default:
+            throw JitUnsupported{};
+    }
+}
+
+void JitEmitter::count_locals(Stmt* stmt)
+{
+    switch (stmt->kind)
+    {
+        case StmtKind::BLOCK:
+            local_count += static_cast<BlockStmt*>(stmt)->slot_count;
+
+            for (const std::shared_ptr<Stmt>& inner : static_cast<BlockStmt*>(stmt)->statements)
+                count_locals(inner.get());
+            return;
+
+        case StmtKind::IF:
+            count_locals(static_cast<IfStmt*>(stmt)->then_branch.get());
+
+            if (static_cast<IfStmt*>(stmt)->else_branch != nullptr)
+                count_locals(static_cast<IfStmt*>(stmt)->else_branch.get());
+            return;
+
+        case StmtKind::WHILE:
+            count_locals(static_cast<WhileStmt*>(stmt)->body.get());
+            return;
+
+        default:
+            return;
+    }
+}
+
+std::shared_ptr<JitCode> JitEmitter::compile()
+{
+    FunctionExpr* declaration = function->declaration.get();
+    int arity = declaration->parameters.size();
+
+    if (arity > JitCompiler::MAX_ARGUMENTS)
+        return nullptr;
+
+    local_count = declaration->slot_count;
+    for (const std::shared_ptr<Stmt>& stmt : declaration->body)
+        count_locals(stmt.get());
+
+    try
+    {
+        emit({0x55}); // push rbp
+        emit({0x48, 0x89, 0xE5}); // mov rbp, rsp
+        size_t frame = jump({0x48, 0x81, 0xEC}); // sub rsp, frame size, patched below
+        emit({0x48, 0x89, 0xB5}); emit32(-8); // mov [rbp - 8], rsi
+
+        for (int i = 0; i < arity; i++)
+        {
+            emit({0xF2, 0x0F, 0x10, 0x87}); emit32(8 * i); // movsd xmm0, [rdi + 8 * i]
+            store(local_offset(i));
+        }
+
+        // the call nests one deeper, bail before going past the limit, the interpreter reports it
+        emit({0x48, 0xB8}); emit64(reinterpret_cast<uint64_t>(depth)); // mov rax, &depth
+        emit({0x48, 0x8B, 0x08}); // mov rcx, [rax]
+        emit({0x48, 0xBA}); emit64(max_depth); // mov rdx, max_depth
+        emit({0x48, 0x39, 0xD1}); // cmp rcx, rdx
+        size_t overflow = jump({0x0F, 0x83}); // jae overflow
+        emit({0x48, 0xFF, 0xC1}); // inc rcx
+        emit({0x48, 0x89, 0x08}); // mov [rax], rcx
+
+        body_start = code.size();
+        scopes.push_back(0);
+        next_local = declaration->slot_count;
+
+        for (const std::shared_ptr<Stmt>& stmt : declaration->body)
+            statement(stmt.get());
+
+        leave_with(JIT_NIL); // fell off the end
+
+        patch_all(bail_jumps, code.size());
+        leave_with(JIT_BAIL);
+
+        patch(overflow, code.size()); // depth wasn't counted yet
+        emit({0xB8}); emit32(JIT_BAIL); // mov eax, JIT_BAIL
+        emit({0xC9, 0xC3}); // leave, ret
+
+        // keep rsp 16 byte aligned for calls
+        int32_t frame_size = 8 * (1 + local_count + max_temps);
+        frame_size = (frame_size + 15) & ~15;
+        std::memcpy(&code[frame], &frame_size, 4);
+    }
+    catch (JitUnsupported)
+    {
+        return nullptr;
+    }
+
+    if (!install(*result))
+        return nullptr;
+
+    return result;
+}
+
+std::shared_ptr<JitCode> JitCompiler::compile(NblFunction* function, Interpreter& interpreter)
+{
+    return JitEmitter(function, interpreter).compile();
+}
+
+#else
+
+std::shared_ptr<JitCode> JitCompiler::compile(NblFunction* function, Interpreter& interpreter)
+{
+    return nullptr; // no code generator for this platform
+}
+
+#endif
@@ -5,27 +5,22 @@
 
 #include "list.hpp"
 
-void ListType::append(std::any value)
+void ListType::append(Value value)
 {
-    elements.push_back(value);
+    elements.push_back(std::move(value));
 }
 
-std::any ListType::get_element_at(int index)
+Value ListType::get_element_at(int index)
 {
     return elements.at(index);
 }
 
-int ListType::get_length()
-{
-    return elements.size();
-}
-
-bool ListType::set_element_at(int index, std::any value)
+bool ListType::set_element_at(int index, Value value)
 {
     if (index == get_length())
-        elements.insert(elements.begin() + index, value);
+        elements.insert(elements.begin() + index, std::move(value));
     else if (index < get_length() && index >= 0)
-        elements[index] = value;
+        elements[index] = std::move(value);
     else
         return false;
     
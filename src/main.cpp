@@ -4,21 +4,89 @@
 //------------------------------------//
 
 #include <iostream>
+#include <cctype>
+#include <cerrno>
 
 #include "util.hpp"
+#include "stack.hpp"
 
 Interpreter interpreter{};
 
+static void usage()
+{
+    std::cout << "Usage: nimble [--engine=tree|vm|closure] [--no-jit] [--max-stack=<calls>] [--cache-stats] [-O0|-O1|-O2] [--print-ast-after-opt] [--emit-c] <script>.nbl\n";
+    exit(1);
+}
+
 int main(int argc, char* argv[])
 {
-    if (argc > 2) // too many arguments
+    char* script = nullptr;
+    bool emit_c = false;
+
+    for (int i = 1; i < argc; i++)
     {
-        std::cout << "Usage: nimble <script>.nbl\n";
-        exit(1);
+        if (strncmp(argv[i], "--engine=", 9) == 0)
+        {
+            const char* engine = argv[i] + 9;
+
+            if (strcmp(engine, "tree") == 0)
+                interpreter.set_engine(Engine::TREE_WALKER);
+            else if (strcmp(engine, "vm") == 0)
+                interpreter.set_engine(Engine::BYTECODE);
+            else if (strcmp(engine, "closure") == 0)
+                interpreter.set_engine(Engine::CLOSURE);
+            else
+                usage();
+        }
+        else if (strcmp(argv[i], "--no-jit") == 0)
+        {
+            interpreter.jit_enabled = false;
+        }
+        else if (strncmp(argv[i], "--max-stack=", 12) == 0)
+        {
+            // strtoull would take "-5" or " 5" and wrap the first around to a huge limit
+            const char* calls = argv[i] + 12;
+            char* end;
+
+            if (!isdigit(static_cast<unsigned char>(calls[0])))
+                usage();
+
+            errno = 0;
+            interpreter.max_stack = strtoull(calls, &end, 10);
+
+            if (*end != '\0' || errno == ERANGE || interpreter.max_stack == 0)
+                usage();
+        }
+        else if (strcmp(argv[i], "--cache-stats") == 0)
+        {
+            // scripts end through exit(), errors included
+            atexit(InlineCache::print_stats);
+        }
+        else if (strcmp(argv[i], "-O0") == 0 || strcmp(argv[i], "-O1") == 0 || strcmp(argv[i], "-O2") == 0)
+        {
+            interpreter.optimize_level = argv[i][2] - '0';
+        }
+        else if (strcmp(argv[i], "--print-ast-after-opt") == 0)
+        {
+            interpreter.print_ast = true;
+        }
+        else if (strcmp(argv[i], "--emit-c") == 0)
+        {
+            emit_c = true;
+        }
+        else if (script == nullptr)
+        {
+            script = argv[i];
+        }
+        else // too many arguments
+        {
+            usage();
+        }
     }
-    else if (argc == 2) // run script file
+
+    if (script != nullptr) // run script file
     {
-        char* point = strrchr(argv[1], '.');
+        char* point = strrchr(script, '.');
 
         if(point != NULL)
         {
@@ -34,11 +102,27 @@ int main(int argc, char* argv[])
             exit(1);
         }
 
-        run_file(argv[1], interpreter);
+        if (emit_c)
+            emit_file(script, interpreter.max_stack);
+        else
+        {
+            run_on_script_stack(interpreter.max_stack, [script](const char* limit)
+            {
+                interpreter.native_limit = limit;
+                run_file(script, interpreter);
+                // exits from here so globals like a long linked list are destroyed on this stack too
+                exit(0);
+            });
+        }
     }
     else // run interactive mode
     {
-        run_prompt(interpreter);
+        run_on_script_stack(interpreter.max_stack, [](const char* limit)
+        {
+            interpreter.native_limit = limit;
+            run_prompt(interpreter);
+            exit(0);
+        });
         // prompt_load("./example/function/function-8.nbl");
     }
 
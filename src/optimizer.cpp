@@ -0,0 +1,306 @@
+//------------------------------------//
+// Copyright 2024 Nam Nguyen
+// Licensed under Apache License v2.0
+//------------------------------------//
+
+#include "optimizer.hpp"
+#include "interpreter.hpp"
+
+Optimizer::Optimizer(Interpreter& interpreter, int level)
+    : interpreter(interpreter), level(level) {}
+
+// a list of statements, anything after a return or break in it never runs
+void Optimizer::optimize(std::vector<std::shared_ptr<Stmt>>& statements)
+{
+    if (level < 1)
+        return;
+
+    std::vector<std::shared_ptr<Stmt>> kept;
+
+    for (std::shared_ptr<Stmt> statement : statements)
+    {
+        optimize(statement);
+
+        if (statement == nullptr)
+            continue;
+
+        kept.push_back(statement);
+
+        if (statement->kind == StmtKind::RETURN || statement->kind == StmtKind::BREAK)
+            break;
+    }
+
+    statements = std::move(kept);
+}
+
+
+// statements, one that does nothing is set to null
+
+void Optimizer::optimize(std::shared_ptr<Stmt>& stmt)
+{
+    switch (stmt->kind)
+    {
+        case StmtKind::BLOCK:
+        {
+            BlockStmt* block = static_cast<BlockStmt*>(stmt.get());
+            optimize(block->statements);
+
+            if (block->statements.empty() && !block->scoped)
+                stmt = nullptr;
+            break;
+        }
+
+        case StmtKind::EXPRESSION:
+        {
+            ExpressionStmt* expression = static_cast<ExpressionStmt*>(stmt.get());
+            optimize(expression->expression);
+
+            if (expression->expression->kind == ExprKind::LITERAL)
+                stmt = nullptr;
+            break;
+        }
+
+        case StmtKind::PRINT:
+            optimize(static_cast<PrintStmt*>(stmt.get())->expression);
+            break;
+
+        case StmtKind::MUT:
+        {
+            MutStmt* mut = static_cast<MutStmt*>(stmt.get());
+
+            if (mut->initializer != nullptr)
+                optimize(mut->initializer);
+            break;
+        }
+
+        case StmtKind::IF:
+        {
+            IfStmt* branch = static_cast<IfStmt*>(stmt.get());
+            optimize(branch->condition);
+
+            if (branch->condition->kind == ExprKind::LITERAL)
+            {
+                // only the branch the condition picks is left
+                std::shared_ptr<Stmt> taken = interpreter.is_truthy(static_cast<LiteralExpr*>(branch->condition.get())->value) ? branch->then_branch : branch->else_branch;
+
+                if (taken != nullptr)
+                    optimize(taken);
+
+                stmt = taken;
+                break;
+            }
+
+            optimize_branch(branch->then_branch);
+
+            if (branch->else_branch != nullptr)
+                optimize(branch->else_branch);
+            break;
+        }
+
+        case StmtKind::WHILE:
+        {
+            WhileStmt* loop = static_cast<WhileStmt*>(stmt.get());
+            optimize(loop->condition);
+
+            if (loop->condition->kind == ExprKind::LITERAL && !interpreter.is_truthy(static_cast<LiteralExpr*>(loop->condition.get())->value))
+            {
+                stmt = nullptr;
+                break;
+            }
+
+            optimize_branch(loop->body);
+            break;
+        }
+
+        case StmtKind::FUNCTION:
+            optimize(static_cast<FunctionStmt*>(stmt.get())->fn->body);
+            break;
+
+        case StmtKind::RETURN:
+        {
+            ReturnStmt* ret = static_cast<ReturnStmt*>(stmt.get());
+
+            if (ret->value != nullptr)
+                optimize(ret->value);
+            break;
+        }
+
+        case StmtKind::CLASS:
+        {
+            for (const std::shared_ptr<FunctionStmt>& method : static_cast<ClassStmt*>(stmt.get())->methods)
+                optimize(method->fn->body);
+            break;
+        }
+
+        case StmtKind::BREAK:
+        case StmtKind::IMPORT:
+            break;
+    }
+}
+
+// the body of an if or a loop, which has to stay a statement even when it does nothing
+void Optimizer::optimize_branch(std::shared_ptr<Stmt>& stmt)
+{
+    optimize(stmt);
+
+    if (stmt == nullptr)
+    {
+        std::shared_ptr<BlockStmt> empty = std::make_shared<BlockStmt>(std::vector<std::shared_ptr<Stmt>>{});
+        empty->scoped = false;
+        stmt = empty;
+    }
+}
+
+
+// expressions, replaced by a LiteralExpr once their value is known
+
+void Optimizer::optimize(std::shared_ptr<Expr>& expr)
+{
+    switch (expr->kind)
+    {
+        case ExprKind::GROUPING: // parentheses only matter to the parser
+        {
+            std::shared_ptr<Expr> inner = static_cast<GroupingExpr*>(expr.get())->expression;
+            optimize(inner);
+            expr = inner;
+            break;
+        }
+
+        case ExprKind::BINARY: optimize_binary(expr); break;
+        case ExprKind::UNARY: optimize_unary(expr); break;
+        case ExprKind::LOGICAL: optimize_logical(expr); break;
+        case ExprKind::MUT: optimize_mut(expr); break;
+
+        case ExprKind::ASSIGN:
+            optimize(static_cast<AssignExpr*>(expr.get())->value);
+            break;
+
+        case ExprKind::CALL:
+        {
+            CallExpr* call = static_cast<CallExpr*>(expr.get());
+            optimize(call->callee);
+
+            for (std::shared_ptr<Expr>& argument : call->arguments)
+                optimize(argument);
+            break;
+        }
+
+        case ExprKind::FUNCTION:
+            optimize(static_cast<FunctionExpr*>(expr.get())->body);
+            break;
+
+        case ExprKind::GET:
+            optimize(static_cast<GetExpr*>(expr.get())->object);
+            break;
+
+        case ExprKind::SET:
+        {
+            SetExpr* set = static_cast<SetExpr*>(expr.get());
+            optimize(set->object);
+            optimize(set->value);
+            break;
+        }
+
+        case ExprKind::LIST:
+        {
+            for (std::shared_ptr<Expr>& element : static_cast<ListExpr*>(expr.get())->elements)
+                optimize(element);
+            break;
+        }
+
+        case ExprKind::SUBSCRIPT:
+        {
+            SubscriptExpr* subscript = static_cast<SubscriptExpr*>(expr.get());
+            optimize(subscript->name);
+            optimize(subscript->index);
+
+            if (subscript->value != nullptr)
+                optimize(subscript->value);
+            break;
+        }
+
+        default: // literals, this and super
+            break;
+    }
+}
+
+void Optimizer::optimize_binary(std::shared_ptr<Expr>& expr)
+{
+    BinaryExpr* binary = static_cast<BinaryExpr*>(expr.get());
+    optimize(binary->left);
+    optimize(binary->right);
+
+    LiteralExpr* left = dynamic_cast<LiteralExpr*>(binary->left.get());
+    LiteralExpr* right = dynamic_cast<LiteralExpr*>(binary->right.get());
+    Value result;
+
+    if (left != nullptr && right != nullptr && fold(binary, left->value, right->value, result))
+    {
+        expr = std::make_shared<LiteralExpr>(result);
+        return;
+    }
+
+    // x * x gives what x ** 2 does, integers included, without a loop or pow()
+    if (level >= 2 && binary->op.type == STAR_STAR && right != nullptr && right->value.is_int() && right->value.as_int() == 2)
+        binary->kind = ExprKind::SQUARE;
+}
+
+// result is what every engine gives for the operation, false when they'd disagree or it'd throw
+bool Optimizer::fold(BinaryExpr* expr, const Value& left, const Value& right, Value& result)
+{
+    bool numbers = left.is_number() && right.is_number();
+    bool equality = expr->op.type == EQUAL_EQUAL || expr->op.type == BANG_EQUAL;
+    bool concatenation = expr->op.type == PLUS && (left.is_string() || right.is_string()) && (left.is_string() || left.is_number()) && (right.is_string() || right.is_number());
+
+    if (!numbers && !equality && !concatenation)
+        return false;
+
+    result = interpreter.binary_operation(expr->op, left, right);
+    return true;
+}
+
+void Optimizer::optimize_unary(std::shared_ptr<Expr>& expr)
+{
+    UnaryExpr* unary = static_cast<UnaryExpr*>(expr.get());
+    optimize(unary->right);
+
+    LiteralExpr* right = dynamic_cast<LiteralExpr*>(unary->right.get());
+
+    if (right == nullptr)
+        return;
+
+    if (unary->op.type == BANG)
+        expr = std::make_shared<LiteralExpr>(!interpreter.is_truthy(right->value));
+    else if (unary->op.type == MINUS && right->value.is_number())
+        expr = std::make_shared<LiteralExpr>(num_negate(right->value));
+}
+
+// a known left side decides which side is the result
+void Optimizer::optimize_logical(std::shared_ptr<Expr>& expr)
+{
+    LogicalExpr* logical = static_cast<LogicalExpr*>(expr.get());
+    optimize(logical->left);
+    optimize(logical->right);
+
+    LiteralExpr* left = dynamic_cast<LiteralExpr*>(logical->left.get());
+
+    if (left == nullptr)
+        return;
+
+    bool truthy = interpreter.is_truthy(left->value);
+    bool short_circuits = logical->op.type == OR ? truthy : !truthy;
+
+    expr = short_circuits ? logical->left : logical->right;
+}
+
+// a local that is never assigned holds its initializer's value for as long as anything can read it
+void Optimizer::optimize_mut(std::shared_ptr<Expr>& expr)
+{
+    MutStmt* declaration = static_cast<MutExpr*>(expr.get())->declaration;
+
+    if (level < 2 || declaration == nullptr || declaration->initializer == nullptr)
+        return;
+
+    if (declaration->initializer->kind == ExprKind::LITERAL)
+        expr = std::make_shared<LiteralExpr>(static_cast<LiteralExpr*>(declaration->initializer.get())->value);
+}
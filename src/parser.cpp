@@ -8,6 +8,45 @@
 Parser::Parser(const std::vector<Token>& tokens)
     : tokens(tokens) {}
 
+// sets loop_depth while a loop or function body is parsed, and puts it back on every way out, errors included
+class LoopDepth
+{
+    int& depth;
+    int saved;
+
+    public:
+        LoopDepth(int& depth, int value)
+            : depth(depth), saved(depth)
+        {
+            depth = value;
+        }
+
+        ~LoopDepth()
+        {
+            depth = saved;
+        }
+
+        LoopDepth(const LoopDepth&) = delete;
+        LoopDepth& operator=(const LoopDepth&) = delete;
+};
+
+// runtime value of a NUMBER or STRING token
+static Value literal_value(const Token& token)
+{
+    if (token.type == NUMBER)
+    {
+        double number = std::any_cast<double>(token.literal);
+
+        // a literal without a fraction is an integer, unless it's too big for one
+        if (token.lexeme.find('.') == std::string::npos && number <= Value::MAX_INT)
+            return Value::integer(static_cast<int64_t>(number));
+
+        return number;
+    }
+
+    return std::any_cast<std::string>(token.literal);
+}
+
 std::vector<std::shared_ptr<Stmt>> Parser::parse()
 {
     std::vector<std::shared_ptr<Stmt>> statements;
@@ -102,74 +141,59 @@ std::shared_ptr<Stmt> Parser::if_statement()
 
 std::shared_ptr<Stmt> Parser::for_statement()
 {
-    try 
-    {
-        consume(LEFT_PAREN, "Expected '(' after 'for' statement");
-        std::shared_ptr<Stmt> initializer;
-
-        if (match(SEMICOLON)) // initializer omitted
-            initializer = nullptr;
-        else if (match(MUT)) // variable declaration
-            initializer = mut_declaration();
-        else // expression
-            initializer = expression_statement();
-
-        std::shared_ptr<Expr> condition = nullptr;
-        if (!check(SEMICOLON)) // clause not omitted
-            condition = expression();
-        consume(SEMICOLON, "Expected ';' after loop condition");
-        
-        std::shared_ptr<Expr> increment = nullptr;
-        if (!check(RIGHT_PAREN)) // clause not omitted
-            increment = expression();
-        consume(RIGHT_PAREN, "Expected ')' after 'for' clauses");
-
-        std::shared_ptr<Stmt> body = statement();
-        if (increment != nullptr)
-            // executes after the body in each iteration of the loop
-            // replace body with a block that contains the body with an expression statement that evaluates the increment
-            body = std::make_shared<BlockStmt>(std::vector<std::shared_ptr<Stmt>>{body, std::make_shared<ExpressionStmt>(increment)});
-
-        if (condition == nullptr)
-            // true if condition is omitted
-            condition = std::make_shared<LiteralExpr>(true);
-        body = std::make_shared<WhileStmt>(condition, body); // build for loop with while loop
-
-        if (initializer != nullptr) // runs once
-            // replace statement with a block that runs the initializer and execute the loop
-            body = std::make_shared<BlockStmt>(std::vector<std::shared_ptr<Stmt>>{initializer, body});
-
-        return body;
-    }
-    catch (...) // throw error for trying to use break outside a loop
+    consume(LEFT_PAREN, "Expected '(' after 'for' statement");
+    std::shared_ptr<Stmt> initializer;
+
+    if (match(SEMICOLON)) // initializer omitted
+        initializer = nullptr;
+    else if (match(MUT)) // variable declaration
+        initializer = mut_declaration();
+    else // expression
+        initializer = expression_statement();
+
+    std::shared_ptr<Expr> condition = nullptr;
+    if (!check(SEMICOLON)) // clause not omitted
+        condition = expression();
+    consume(SEMICOLON, "Expected ';' after loop condition");
+    
+    std::shared_ptr<Expr> increment = nullptr;
+    if (!check(RIGHT_PAREN)) // clause not omitted
+        increment = expression();
+    consume(RIGHT_PAREN, "Expected ')' after 'for' clauses");
+
+    std::shared_ptr<Stmt> body;
     {
-        loop_depth--;
-        throw;
+        LoopDepth loop(loop_depth, loop_depth + 1); // break is allowed in the body
+        body = statement();
     }
 
-    loop_depth--;
+    if (increment != nullptr)
+        // executes after the body in each iteration of the loop
+        // replace body with a block that contains the body with an expression statement that evaluates the increment
+        body = std::make_shared<BlockStmt>(std::vector<std::shared_ptr<Stmt>>{body, std::make_shared<ExpressionStmt>(increment)});
+
+    if (condition == nullptr)
+        // true if condition is omitted
+        condition = std::make_shared<LiteralExpr>(true);
+    body = std::make_shared<WhileStmt>(condition, body); // build for loop with while loop
+
+    if (initializer != nullptr) // runs once
+        // replace statement with a block that runs the initializer and execute the loop
+        body = std::make_shared<BlockStmt>(std::vector<std::shared_ptr<Stmt>>{initializer, body});
+
+    return body;
 }
 
 std::shared_ptr<Stmt> Parser::while_statement()
 {
-    try
-    {
-        loop_depth++;
-
-        consume(LEFT_PAREN, "Expected '(' after 'while' statement");
-        std::shared_ptr<Expr> condition = expression();
-        consume(RIGHT_PAREN, "Expected ')' after 'while' condition");
-        std::shared_ptr<Stmt> body = statement();
+    consume(LEFT_PAREN, "Expected '(' after 'while' statement");
+    std::shared_ptr<Expr> condition = expression();
+    consume(RIGHT_PAREN, "Expected ')' after 'while' condition");
 
-        return std::make_shared<WhileStmt>(condition, body);
-    }
-    catch (...) // throw error for trying to use break outside a loop
-    {
-        loop_depth--;
-        throw;
-    }
+    LoopDepth loop(loop_depth, loop_depth + 1); // break is allowed in the body
+    std::shared_ptr<Stmt> body = statement();
 
-    loop_depth--;
+    return std::make_shared<WhileStmt>(condition, body);
 }
 
 std::shared_ptr<Stmt> Parser::return_statement()
@@ -198,7 +222,7 @@ std::shared_ptr<Stmt> Parser::import_statement()
     Token keyword = previous();
     Token target = consume(STRING, "Expected filename after 'import'");
     consume(SEMICOLON, "Expected ';' after 'import' statement");
-    return std::make_shared<ImportStmt>(keyword, std::make_shared<LiteralExpr>(target.literal));
+    return std::make_shared<ImportStmt>(keyword, std::make_shared<LiteralExpr>(literal_value(target)));
 }
 
 std::shared_ptr<Stmt> Parser::expression_statement()
@@ -284,6 +308,8 @@ std::shared_ptr<FunctionExpr> Parser::function_body(std::string kind)
     consume(RIGHT_PAREN, "Expected ')' after parameters");
 
     consume(LEFT_BRACE, "Expected '{' before " + kind + " body");
+
+    LoopDepth loop(loop_depth, 0); // a break can't leave the function for a loop around it
     std::vector<std::shared_ptr<Stmt>> body = block();
 
     return std::make_shared<FunctionExpr>(std::move(parameters), std::move(body));
@@ -601,7 +627,7 @@ std::shared_ptr<Expr> Parser::primary()
         return std::make_shared<LiteralExpr>(nullptr);
         
     if (match(NUMBER, STRING))
-        return std::make_shared<LiteralExpr>(previous().literal);
+        return std::make_shared<LiteralExpr>(literal_value(previous()));
 
     if (match(IDENTIFIER))
         return std::make_shared<MutExpr>(previous());
@@ -0,0 +1,262 @@
+//------------------------------------//
+// Copyright 2024 Nam Nguyen
+// Licensed under Apache License v2.0
+//------------------------------------//
+
+#include "printer.hpp"
+#include "interpreter.hpp"
+
+AstPrinter::AstPrinter(Interpreter& interpreter)
+    : interpreter(interpreter) {}
+
+std::string AstPrinter::print(const std::vector<std::shared_ptr<Stmt>>& statements)
+{
+    std::string out;
+
+    for (const std::shared_ptr<Stmt>& statement : statements)
+        print(statement.get(), out);
+
+    return out;
+}
+
+static std::string parameters(const std::vector<Token>& parameters)
+{
+    std::string out = "(";
+
+    for (size_t i = 0; i < parameters.size(); i++)
+        out += (i > 0 ? " " : "") + parameters[i].lexeme;
+
+    return out + ")";
+}
+
+void AstPrinter::print(Stmt* stmt, std::string& out)
+{
+    switch (stmt->kind)
+    {
+        case StmtKind::BLOCK:
+        {
+            BlockStmt* block = static_cast<BlockStmt*>(stmt);
+            out += indent() + (block->scoped ? "block\n" : "block (unscoped)\n");
+
+            depth++;
+            out += print(block->statements);
+            depth--;
+            break;
+        }
+
+        case StmtKind::EXPRESSION:
+            out += indent() + print(static_cast<ExpressionStmt*>(stmt)->expression.get()) + "\n";
+            break;
+
+        case StmtKind::PRINT:
+            out += indent() + "print " + print(static_cast<PrintStmt*>(stmt)->expression.get()) + "\n";
+            break;
+
+        case StmtKind::MUT:
+        {
+            MutStmt* mut = static_cast<MutStmt*>(stmt);
+            out += indent() + "mut " + mut->name.lexeme;
+
+            if (mut->initializer != nullptr)
+                out += " " + print(mut->initializer.get());
+
+            out += "\n";
+            break;
+        }
+
+        case StmtKind::IF:
+        {
+            IfStmt* branch = static_cast<IfStmt*>(stmt);
+            out += indent() + "if " + print(branch->condition.get()) + "\n";
+            print_body(branch->then_branch.get(), out);
+
+            if (branch->else_branch != nullptr)
+            {
+                out += indent() + "else\n";
+                print_body(branch->else_branch.get(), out);
+            }
+            break;
+        }
+
+        case StmtKind::WHILE:
+        {
+            WhileStmt* loop = static_cast<WhileStmt*>(stmt);
+            out += indent() + "while " + print(loop->condition.get()) + "\n";
+            print_body(loop->body.get(), out);
+            break;
+        }
+
+        case StmtKind::FUNCTION:
+        {
+            FunctionStmt* function = static_cast<FunctionStmt*>(stmt);
+            out += indent() + "fun " + function->name.lexeme + " " + parameters(function->fn->parameters) + "\n";
+
+            depth++;
+            out += print(function->fn->body);
+            depth--;
+            break;
+        }
+
+        case StmtKind::RETURN:
+        {
+            ReturnStmt* ret = static_cast<ReturnStmt*>(stmt);
+            out += indent() + "return";
+
+            if (ret->value != nullptr)
+                out += " " + print(ret->value.get());
+
+            out += "\n";
+            break;
+        }
+
+        case StmtKind::BREAK:
+            out += indent() + "break\n";
+            break;
+
+        case StmtKind::CLASS:
+        {
+            ClassStmt* klass = static_cast<ClassStmt*>(stmt);
+            out += indent() + "class " + klass->name.lexeme;
+
+            if (klass->superclass != nullptr)
+                out += " : " + klass->superclass->name.lexeme;
+
+            out += "\n";
+
+            depth++;
+            for (const std::shared_ptr<FunctionStmt>& method : klass->methods)
+                print(method.get(), out);
+            depth--;
+            break;
+        }
+
+        case StmtKind::IMPORT:
+            out += indent() + "import " + print(static_cast<ImportStmt*>(stmt)->target.get()) + "\n";
+            break;
+    }
+}
+
+// the statement an if or a loop runs, one level in
+void AstPrinter::print_body(Stmt* stmt, std::string& out)
+{
+    depth++;
+    print(stmt, out);
+    depth--;
+}
+
+std::string AstPrinter::indent()
+{
+    return std::string(depth * 4, ' ');
+}
+
+std::string AstPrinter::print(Expr* expr)
+{
+    if (expr->kind == ExprKind::SQUARE) // what the optimizer made of x ** 2
+        return "(square " + print(static_cast<BinaryExpr*>(expr)->left.get()) + ")";
+
+    switch (generic_kind(expr->kind))
+    {
+        case ExprKind::ASSIGN:
+        {
+            AssignExpr* assign = static_cast<AssignExpr*>(expr);
+            return "(= " + assign->name.lexeme + " " + print(assign->value.get()) + ")";
+        }
+
+        case ExprKind::BINARY:
+        {
+            BinaryExpr* binary = static_cast<BinaryExpr*>(expr);
+            return "(" + binary->op.lexeme + " " + print(binary->left.get()) + " " + print(binary->right.get()) + ")";
+        }
+
+        case ExprKind::GROUPING:
+            return "(group " + print(static_cast<GroupingExpr*>(expr)->expression.get()) + ")";
+
+        case ExprKind::LITERAL:
+        {
+            const Value& value = static_cast<LiteralExpr*>(expr)->value;
+            return value.is_string() ? "\"" + value.as_string() + "\"" : interpreter.stringify(value);
+        }
+
+        case ExprKind::UNARY:
+        {
+            UnaryExpr* unary = static_cast<UnaryExpr*>(expr);
+            return "(" + unary->op.lexeme + " " + print(unary->right.get()) + ")";
+        }
+
+        case ExprKind::MUT:
+            return static_cast<MutExpr*>(expr)->name.lexeme;
+
+        case ExprKind::LOGICAL:
+        {
+            LogicalExpr* logical = static_cast<LogicalExpr*>(expr);
+            return "(" + logical->op.lexeme + " " + print(logical->left.get()) + " " + print(logical->right.get()) + ")";
+        }
+
+        case ExprKind::CALL:
+        {
+            CallExpr* call = static_cast<CallExpr*>(expr);
+            std::string out = "(call " + print(call->callee.get());
+
+            for (const std::shared_ptr<Expr>& argument : call->arguments)
+                out += " " + print(argument.get());
+
+            return out + ")";
+        }
+
+        case ExprKind::FUNCTION:
+        {
+            // the body goes on the lines below, one level in from the statement it's part of
+            FunctionExpr* function = static_cast<FunctionExpr*>(expr);
+            std::string out = "(fun " + parameters(function->parameters) + "\n";
+
+            depth++;
+            out += print(function->body);
+            depth--;
+
+            return out + indent() + ")";
+        }
+
+        case ExprKind::GET:
+        {
+            GetExpr* get = static_cast<GetExpr*>(expr);
+            return "(. " + print(get->object.get()) + " " + get->name.lexeme + ")";
+        }
+
+        case ExprKind::SET:
+        {
+            SetExpr* set = static_cast<SetExpr*>(expr);
+            return "(= (. " + print(set->object.get()) + " " + set->name.lexeme + ") " + print(set->value.get()) + ")";
+        }
+
+        case ExprKind::THIS:
+            return "this";
+
+        case ExprKind::SUPER:
+            return "(. super " + static_cast<SuperExpr*>(expr)->method.lexeme + ")";
+
+        case ExprKind::LIST:
+        {
+            ListExpr* list = static_cast<ListExpr*>(expr);
+            std::string out = "(list";
+
+            for (const std::shared_ptr<Expr>& element : list->elements)
+                out += " " + print(element.get());
+
+            return out + ")";
+        }
+
+        case ExprKind::SUBSCRIPT:
+        {
+            SubscriptExpr* subscript = static_cast<SubscriptExpr*>(expr);
+            std::string out = "([] " + print(subscript->name.get()) + " " + print(subscript->index.get());
+
+            if (subscript->value != nullptr)
+                out += " " + print(subscript->value.get());
+
+            return out + ")";
+        }
+
+        default:
+            return "?";
+    }
+}
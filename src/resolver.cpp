@@ -5,8 +5,8 @@
 
 #include "resolver.hpp"
 
-Resolver::Resolver(Interpreter& interpreter, std::string& executed_path)
-    : interpreter(interpreter), executed_path(executed_path) {}
+Resolver::Resolver(std::string& executed_path)
+    : executed_path(executed_path) {}
 
 void Resolver::resolve(const std::vector<std::shared_ptr<Stmt>>& statements)
 {
@@ -15,102 +15,117 @@ void Resolver::resolve(const std::vector<std::shared_ptr<Stmt>>& statements)
 }
 
 
-std::any Resolver::visitAssignExpr(std::shared_ptr<AssignExpr> expr)
+Value Resolver::visitAssignExpr(std::shared_ptr<AssignExpr> expr)
 {
     resolve(expr->value);
-    resolve_local(expr, expr->name);
+
+    if (LocalVariable* variable = resolve_local(expr->binding, expr->name))
+        variable->assigned = true;
+
     return {};
 }
 
-std::any Resolver::visitBinaryExpr(std::shared_ptr<BinaryExpr> expr)
+Value Resolver::visitBinaryExpr(std::shared_ptr<BinaryExpr> expr)
 {
     resolve(expr->left);
     resolve(expr->right);
     return {};
 }
 
-std::any Resolver::visitGroupingExpr(std::shared_ptr<GroupingExpr> expr)
+Value Resolver::visitGroupingExpr(std::shared_ptr<GroupingExpr> expr)
 {
     resolve(expr->expression);
     return {};
 }
 
-std::any Resolver::visitLiteralExpr(std::shared_ptr<LiteralExpr> expr)
+Value Resolver::visitLiteralExpr(std::shared_ptr<LiteralExpr> expr)
 {
     return {};
 }
 
-std::any Resolver::visitUnaryExpr(std::shared_ptr<UnaryExpr> expr)
+Value Resolver::visitUnaryExpr(std::shared_ptr<UnaryExpr> expr)
 {
     resolve(expr->right);
     return {};
 }
 
-std::any Resolver::visitMutExpr(std::shared_ptr<MutExpr> expr)
+Value Resolver::visitMutExpr(std::shared_ptr<MutExpr> expr)
 {
     if (!scopes.empty())
     {
         auto& current_scope = scopes.back();
         auto element = current_scope.find(expr->name.lexeme);
 
-        if (element != current_scope.end() && element->second == false)
+        if (element != current_scope.end() && !element->second.defined)
             Error::error(expr->name, "Can't read local variable in its initializer");
 
     }
-    resolve_local(expr, expr->name);
+
+    if (LocalVariable* variable = resolve_local(expr->binding, expr->name))
+        variable->reads.push_back(expr.get());
+
     return {};
 }
 
-std::any Resolver::visitLogicalExpr(std::shared_ptr<LogicalExpr> expr)
+Value Resolver::visitLogicalExpr(std::shared_ptr<LogicalExpr> expr)
 {
     resolve(expr->left);
     resolve(expr->right);
     return {};
 }
 
-std::any Resolver::visitCallExpr(std::shared_ptr<CallExpr> expr)
+Value Resolver::visitCallExpr(std::shared_ptr<CallExpr> expr)
 {
     resolve(expr->callee);
 
     for (const std::shared_ptr<Expr>& argument : expr->arguments)
         resolve(argument);
 
+    // a global named after a builtin like len is almost always that builtin, the engines check it is
+    if (expr->callee->kind == ExprKind::MUT)
+    {
+        MutExpr* callee = static_cast<MutExpr*>(expr->callee.get());
+
+        if (callee->binding.depth < 0)
+            expr->intrinsic = find_intrinsic(callee->name.lexeme, expr->arguments.size());
+    }
+
     return {};
 }
 
-std::any Resolver::visitFunctionExpr(std::shared_ptr<FunctionExpr> expr)
+Value Resolver::visitFunctionExpr(std::shared_ptr<FunctionExpr> expr)
 {
     resolve_function(expr, FunctionType::FUNCTION);
     return {};
 }
 
-std::any Resolver::visitGetExpr(std::shared_ptr<GetExpr> expr)
+Value Resolver::visitGetExpr(std::shared_ptr<GetExpr> expr)
 {
     resolve(expr->object);
     return {};
 }
 
-std::any Resolver::visitSetExpr(std::shared_ptr<SetExpr> expr)
+Value Resolver::visitSetExpr(std::shared_ptr<SetExpr> expr)
 {
     resolve(expr->value);
     resolve(expr->object);
     return {};
 }
 
-std::any Resolver::visitThisExpr(std::shared_ptr<ThisExpr> expr)
+Value Resolver::visitThisExpr(std::shared_ptr<ThisExpr> expr)
 {
     if (current_class == ClassType::NONE)
     {
         Error::error(expr->keyword, "Can't use 'this' outside of a class");
         return {};
     }
-    resolve_local(expr, expr->keyword);
+    resolve_local(expr->binding, expr->keyword);
 
     return {};
 }
 
 
-std::any Resolver::visitSuperExpr(std::shared_ptr<SuperExpr> expr)
+Value Resolver::visitSuperExpr(std::shared_ptr<SuperExpr> expr)
 {
     // check if we're currently in a scope where super is allowed
     if (current_class == ClassType::NONE)
@@ -118,18 +133,23 @@ std::any Resolver::visitSuperExpr(std::shared_ptr<SuperExpr> expr)
     else if (current_class != ClassType::SUBCLASS)
         Error::error(expr->keyword, "Can't use 'super' in a class with no superclass");
 
-    resolve_local(expr, expr->keyword);
+    resolve_local(expr->binding, expr->keyword);
+
+    // the "this" of the same class, in the scope right inside the one holding "super"
+    if (expr->binding.depth >= 0)
+        bind(expr->this_binding, scopes.size() - expr->binding.depth, "this");
+
     return {};
 }
 
-std::any Resolver::visitListExpr(std::shared_ptr<ListExpr> expr)
+Value Resolver::visitListExpr(std::shared_ptr<ListExpr> expr)
 {
     for (std::shared_ptr<Expr> element : expr->elements)
         resolve(element);
     return {};
 }
 
-std::any Resolver::visitSubscriptExpr(std::shared_ptr<SubscriptExpr> expr)
+Value Resolver::visitSubscriptExpr(std::shared_ptr<SubscriptExpr> expr)
 {
     resolve(expr->name);
     resolve(expr->index);
@@ -140,29 +160,46 @@ std::any Resolver::visitSubscriptExpr(std::shared_ptr<SubscriptExpr> expr)
     return {};
 }
 
-std::any Resolver::visitBlockStmt(std::shared_ptr<BlockStmt> stmt)
+Value Resolver::visitBlockStmt(std::shared_ptr<BlockStmt> stmt)
 {
+    // a block without declarations of its own, like most loop bodies or the one a for loop's
+    // increment is added in, gets no scope, so running it doesn't create an environment
+    stmt->scoped = std::any_of(stmt->statements.begin(), stmt->statements.end(), [](const std::shared_ptr<Stmt>& statement)
+    {
+        return statement->kind == StmtKind::MUT || statement->kind == StmtKind::FUNCTION || statement->kind == StmtKind::CLASS;
+    });
+
+    if (!stmt->scoped)
+    {
+        resolve(stmt->statements);
+        return {};
+    }
+
     begin_scope();
     resolve(stmt->statements);
-    end_scope();
+    stmt->slot_count = scopes.back().size();
+    end_scope(&stmt->cells);
     return {};
 }
 
-std::any Resolver::visitExpressionStmt(std::shared_ptr<ExpressionStmt> stmt)
+Value Resolver::visitExpressionStmt(std::shared_ptr<ExpressionStmt> stmt)
 {
     resolve(stmt->expression);
     return {};
 }
 
-std::any Resolver::visitPrintStmt(std::shared_ptr<PrintStmt> stmt)
+Value Resolver::visitPrintStmt(std::shared_ptr<PrintStmt> stmt)
 {
     resolve(stmt->expression);
     return {};
 }
 
-std::any Resolver::visitMutStmt(std::shared_ptr<MutStmt> stmt)
+Value Resolver::visitMutStmt(std::shared_ptr<MutStmt> stmt)
 {
-    declare(stmt->name);
+    stmt->slot = declare(stmt->name);
+
+    if (stmt->slot >= 0)
+        scopes.back().at(stmt->name.lexeme).declaration = stmt.get();
 
     if (stmt->initializer != nullptr)
         resolve(stmt->initializer);
@@ -171,7 +208,7 @@ std::any Resolver::visitMutStmt(std::shared_ptr<MutStmt> stmt)
     return {};
 }
 
-std::any Resolver::visitIfStmt(std::shared_ptr<IfStmt> stmt)
+Value Resolver::visitIfStmt(std::shared_ptr<IfStmt> stmt)
 {
     resolve(stmt->condition);
     resolve(stmt->then_branch);
@@ -182,23 +219,23 @@ std::any Resolver::visitIfStmt(std::shared_ptr<IfStmt> stmt)
     return {};
 }
 
-std::any Resolver::visitWhileStmt(std::shared_ptr<WhileStmt> stmt)
+Value Resolver::visitWhileStmt(std::shared_ptr<WhileStmt> stmt)
 {
     resolve(stmt->condition);
     resolve(stmt->body);
     return {};
 }
 
-std::any Resolver::visitFunctionStmt(std::shared_ptr<FunctionStmt> stmt)
+Value Resolver::visitFunctionStmt(std::shared_ptr<FunctionStmt> stmt)
 {
-    declare(stmt->name);
+    stmt->slot = declare(stmt->name);
     define(stmt->name);
 
     resolve_function(stmt->fn, FunctionType::FUNCTION);
     return {};
 }
 
-std::any Resolver::visitReturnStmt(std::shared_ptr<ReturnStmt> stmt)
+Value Resolver::visitReturnStmt(std::shared_ptr<ReturnStmt> stmt)
 {
     if (current_func == FunctionType::NONE)
         Error::error(stmt->keyword, "Can't return from top-level code");
@@ -208,22 +245,25 @@ std::any Resolver::visitReturnStmt(std::shared_ptr<ReturnStmt> stmt)
         if (current_func == FunctionType::INITIALIZER)
             Error::error(stmt->keyword, "Can't return a value from an initializer");
         resolve(stmt->value);
+
+        // nothing is left to do in this function once the call returns, so the callee can take over its frame
+        stmt->tail = stmt->value->kind == ExprKind::CALL && (current_func == FunctionType::FUNCTION || current_func == FunctionType::METHOD);
     }
 
     return {};
 }
 
-std::any Resolver::visitBreakStmt(std::shared_ptr<BreakStmt> stmt)
+Value Resolver::visitBreakStmt(std::shared_ptr<BreakStmt> stmt)
 {
     return {};
 }
 
-std::any Resolver::visitClassStmt(std::shared_ptr<ClassStmt> stmt)
+Value Resolver::visitClassStmt(std::shared_ptr<ClassStmt> stmt)
 {
     ClassType enclosing_class = current_class;
     current_class = ClassType::CLASS;
 
-    declare(stmt->name);
+    stmt->slot = declare(stmt->name);
     define(stmt->name);
 
     if (stmt->superclass != nullptr && stmt->name.lexeme == stmt->superclass->name.lexeme)
@@ -238,11 +278,11 @@ std::any Resolver::visitClassStmt(std::shared_ptr<ClassStmt> stmt)
     if (stmt->superclass != nullptr)
     {
         begin_scope();
-        scopes.back()["super"] = true;
+        scopes.back()["super"] = LocalVariable{true, 0};
     }
 
     begin_scope();
-    scopes.back()["this"] = true;
+    scopes.back()["this"] = LocalVariable{true, 0};
     for (std::shared_ptr<FunctionStmt> method : stmt->methods)
     {
         FunctionType declaration = FunctionType::METHOD;
@@ -262,9 +302,9 @@ std::any Resolver::visitClassStmt(std::shared_ptr<ClassStmt> stmt)
     return {};
 }
 
-std::any Resolver::visitImportStmt(std::shared_ptr<ImportStmt> stmt)
+Value Resolver::visitImportStmt(std::shared_ptr<ImportStmt> stmt)
 {
-    std::string target = std::any_cast<std::string>(stmt->target->value);
+    std::string target = stmt->target->value.as_string();
     bool is_core = false;
 
     if (target.find("core:") != 0)
@@ -304,6 +344,7 @@ void Resolver::resolve_function(std::shared_ptr<FunctionExpr> fn, FunctionType t
 {
     FunctionType enclosing_func = current_func;
     current_func = type;
+    functions.push_back({fn.get(), scopes.size(), type == FunctionType::METHOD || type == FunctionType::INITIALIZER});
 
     begin_scope();
     for (const Token& param : fn->parameters)
@@ -312,48 +353,148 @@ void Resolver::resolve_function(std::shared_ptr<FunctionExpr> fn, FunctionType t
         define(param);
     }
     resolve(fn->body);
-    end_scope();
+    fn->slot_count = scopes.back().size();
+    end_scope(&fn->cells);
 
+    functions.pop_back();
     current_func = enclosing_func;
 }
 
-void Resolver::resolve_local(std::shared_ptr<Expr> expr, const Token& name)
+// the local name binds to, null for a global
+LocalVariable* Resolver::resolve_local(Binding& binding, const Token& name)
 {
+    int found = -1;
+
     for (int i = scopes.size() - 1; i >= 0; i--)
     {
         if (scopes[i].find(name.lexeme) != scopes[i].end())
-        {
-            interpreter.resolve(expr, scopes.size() - i - 1);
-        }
+            found = i;
+    }
+
+    if (found < 0)
+    {
+        binding.slot = global_slot(name.lexeme);
+        return nullptr;
     }
+
+    bind(binding, found, name.lexeme);
+    return &scopes[found].at(name.lexeme);
 }
 
-void Resolver::declare(const Token& name)
+// binds to name in scope, as an upvalue when the scope belongs to an enclosing function
+void Resolver::bind(Binding& binding, size_t scope, const std::string& name)
 {
-    if (scopes.empty())
+    LocalVariable& variable = scopes[scope].at(name);
+
+    binding.depth = scopes.size() - scope - 1;
+    binding.slot = variable.slot;
+
+    if (scope >= functions.back().first_scope)
+    {
+        variable.uses.push_back(&binding);
+        return;
+    }
+
+    // a method reads its own "this" from the receiver it's called with, nothing is captured
+    if (functions.back().is_method && scope == functions.back().first_scope - 1)
+    {
+        binding.receiver = true;
         return;
+    }
+
+    variable.captured = true;
+    binding.upvalue = capture(functions.size() - 1, scope, variable.slot);
+}
+
+// index of the upvalue the function at level reaches slot of scope through, enclosing functions
+// between the two get an upvalue for it as well
+int Resolver::capture(size_t level, size_t scope, int slot)
+{
+    const FunctionScope& function = functions[level];
+    const FunctionScope& enclosing = functions[level - 1];
+    Capture capture{Capture::LOCAL};
+
+    if (enclosing.is_method && scope == enclosing.first_scope - 1)
+    {
+        capture.kind = Capture::THIS;
+    }
+    else if (scope < enclosing.first_scope)
+    {
+        capture.kind = Capture::UPVALUE;
+        capture.index = this->capture(level - 1, scope, slot);
+    }
+    else
+    {
+        // methods are created before their "this" scope exists
+        capture.depth = function.first_scope - (function.is_method ? 2 : 1) - scope;
+        capture.slot = slot;
+    }
+
+    std::vector<Capture>& captures = function.fn->captures;
+    auto found = std::find(captures.begin(), captures.end(), capture);
+
+    if (found != captures.end())
+        return found - captures.begin();
+
+    captures.push_back(capture);
+    return captures.size() - 1;
+}
+
+// returns the slot of the new local, or -1 for a global
+int Resolver::declare(const Token& name)
+{
+    if (scopes.empty())
+        return -1;
     
-    std::map<std::string, bool>& scope = scopes.back();
+    std::map<std::string, LocalVariable>& scope = scopes.back();
 
-    if (scope.find(name.lexeme) != scope.end())
+    auto element = scope.find(name.lexeme);
+    if (element != scope.end())
+    {
         Error::error(name, "Already a variable with this name in this scope");
-    scope[name.lexeme] = false;
+        element->second.defined = false;
+        return element->second.slot;
+    }
+
+    int slot = scope.size();
+    scope[name.lexeme] = LocalVariable{false, slot};
+    return slot;
 }
 
 void Resolver::define(const Token& name)
 {
     if (scopes.empty())
         return;
-    scopes.back()[name.lexeme] = true;
+    scopes.back()[name.lexeme].defined = true;
 }
 
 void Resolver::begin_scope()
 {
-    scopes.push_back(std::map<std::string, bool>{});
+    scopes.push_back(std::map<std::string, LocalVariable>{});
 }
 
-void Resolver::end_scope()
+// cells receives the slots of the scope's captured locals
+void Resolver::end_scope(std::vector<int>* cells)
 {
+    for (auto& [name, variable] : scopes.back())
+    {
+        // the optimizer can read its initializer instead of the variable
+        if (variable.declaration != nullptr && !variable.assigned)
+        {
+            for (MutExpr* read : variable.reads)
+                read->declaration = variable.declaration;
+        }
+
+        if (!variable.captured)
+            continue;
+
+        for (Binding* use : variable.uses)
+            use->cell = true;
+
+        if (cells != nullptr)
+            cells->push_back(variable.slot);
+    }
+
     scopes.pop_back();
 }
 
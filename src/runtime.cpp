@@ -0,0 +1,309 @@
+//------------------------------------//
+// Copyright 2024 Nam Nguyen
+// Licensed under Apache License v2.0
+//------------------------------------//
+
+#include "runtime.hpp"
+#include "stack.hpp"
+
+Ref<AotFunction> AotFunction::bind(const Value& receiver)
+{
+    Ref<AotFunction> bound = new AotFunction(name, arity, code, closure);
+    bound->receiver = receiver;
+    bound->superclass = superclass;
+    bound->is_initializer = is_initializer;
+    return bound;
+}
+
+AotClass::AotClass(std::string name, Ref<AotClass> superclass)
+    : Object(ObjectType::AOT_CLASS), name(std::move(name)), superclass(std::move(superclass))
+{
+    if (this->superclass != nullptr)
+    {
+        methods = this->superclass->methods;
+        initializer = this->superclass->initializer;
+    }
+}
+
+AotFunction* AotClass::find_method(const std::string& name)
+{
+    auto element = methods.find(name);
+    return element != methods.end() ? element->second.get() : nullptr;
+}
+
+const Token& Runtime::token(TokenType type, int line)
+{
+    auto element = tokens.find({type, line});
+
+    if (element == tokens.end())
+        element = tokens.emplace(std::make_pair(type, line), Token(type, "", nullptr, line)).first;
+
+    return element->second;
+}
+
+void Runtime::error(int line, const std::string& message)
+{
+    throw RuntimeError(token(IDENTIFIER, line), message);
+}
+
+void Runtime::undefined(const char* name, int line)
+{
+    error(line, "Undefined variable: '" + std::string(name) + "'");
+}
+
+void Runtime::check_arity(int arity, int count, int line)
+{
+    if (count != arity)
+        error(line, "Expected " + std::to_string(arity) + " arguments but got " + std::to_string(count));
+}
+
+void Runtime::native(const char* name, Value& global, bool& defined)
+{
+    Value* found = interpreter.globals->global(global_slot(name));
+
+    if (found != nullptr)
+    {
+        global = *found;
+        defined = true;
+    }
+}
+
+int Runtime::run(void (*script)(), size_t max_stack)
+{
+    int status = 0;
+    this->max_stack = max_stack;
+
+    // compiled calls nest C++ calls too, the script gets the stack the interpreter would give it
+    run_on_script_stack(max_stack, [&](const char* limit)
+    {
+        native_limit = limit;
+
+        try
+        {
+            script();
+        }
+        catch (RuntimeError& error)
+        {
+            Error::runtime_error(error);
+            status = 3;
+        }
+
+        // the program's globals are destroyed on this stack too
+        exit(status);
+    });
+
+    return status;
+}
+
+Value Runtime::binary(TokenType op, const Value& left, const Value& right, int line)
+{
+    return interpreter.binary_operation(token(op, line), left, right);
+}
+
+Value Runtime::negate(const Value& value, int line)
+{
+    interpreter.check_num_operand(token(MINUS, line), value);
+    return num_negate(value);
+}
+
+Value Runtime::call(const Value& callee, Value* arguments, int count, int line)
+{
+    if (callee.is_object(ObjectType::AOT_FUNCTION))
+    {
+        AotFunction* function = callee.as<AotFunction>();
+        check_arity(function->arity, count, line);
+
+        CallDepth call(*this, line);
+        return function->code(function, function->receiver, arguments);
+    }
+
+    if (callee.is_object(ObjectType::AOT_CLASS))
+    {
+        AotClass* klass = callee.as<AotClass>();
+        Value instance = new AotInstance(klass);
+        AotFunction* initializer = klass->initializer;
+
+        check_arity(initializer != nullptr ? initializer->arity : 0, count, line);
+
+        if (initializer != nullptr)
+        {
+            CallDepth call(*this, line);
+            initializer->code(initializer, instance, arguments);
+        }
+
+        return instance;
+    }
+
+    // natives, and the errors for anything that can't be called
+    return interpreter.call(token(RIGHT_PAREN, line), callee, std::span<Value>(arguments, count));
+}
+
+Value Runtime::invoke(AotFunction* method, const Value& receiver, Value* arguments, int count, int line)
+{
+    check_arity(method->arity, count, line);
+
+    CallDepth call(*this, line);
+    return method->code(method, receiver, arguments);
+}
+
+AotFunction* Runtime::lookup(const Value& object, const std::string& name, Value& callee, int line)
+{
+    if (!object.is_object(ObjectType::AOT_INSTANCE))
+        error(line, "Only instances have properties");
+
+    AotInstance* instance = object.as<AotInstance>();
+    auto element = instance->fields.find(name);
+
+    if (element != instance->fields.end())
+    {
+        callee = element->second;
+        return nullptr;
+    }
+
+    AotFunction* method = instance->klass->find_method(name);
+
+    if (method == nullptr)
+        error(line, "Undefined property '" + name + "'");
+
+    return method;
+}
+
+Value Runtime::get(const Value& object, const std::string& name, int line)
+{
+    Value callee;
+    AotFunction* method = lookup(object, name, callee, line);
+
+    if (method != nullptr)
+        return method->bind(object);
+
+    return callee;
+}
+
+void Runtime::expect_instance(const Value& object, int line)
+{
+    if (!object.is_object(ObjectType::AOT_INSTANCE))
+        error(line, "Only instances have fields");
+}
+
+void Runtime::set(const Value& object, const std::string& name, const Value& value)
+{
+    object.as<AotInstance>()->fields[name] = value;
+}
+
+Value Runtime::super_method(const Value& superclass, const Value& receiver, const std::string& name, int line)
+{
+    AotFunction* method = superclass.as<AotClass>()->find_method(name);
+
+    if (method == nullptr)
+        error(line, "Undefined property '" + name + "'");
+
+    return method->bind(receiver);
+}
+
+Value Runtime::list(std::initializer_list<Value> elements)
+{
+    Ref<ListType> list = new ListType();
+    list->elements.assign(elements.begin(), elements.end());
+    return list;
+}
+
+Value Runtime::subscript(const Value& list, const Value& index, int line)
+{
+    ListType* target = subscript_target(list, index, line);
+    int position = num_index(index);
+
+    if (position >= target->get_length() || position < 0)
+        return nullptr;
+
+    return target->get_element_at(position);
+}
+
+ListType* Runtime::subscript_target(const Value& list, const Value& index, int line)
+{
+    if (!list.is_object(ObjectType::LIST))
+        error(line, "Only lists can be subscripted");
+
+    if (!index.is_number())
+        error(line, "Index should be of type int");
+
+    return list.as<ListType>();
+}
+
+void Runtime::subscript_store(ListType* list, const Value& index, const Value& value, int line)
+{
+    if (!list->set_element_at(num_index(index), value))
+        error(line, "Index out of range");
+}
+
+Value Runtime::make_class(const char* name)
+{
+    return new AotClass(name, nullptr);
+}
+
+Value Runtime::make_class(const char* name, const Value& superclass, int line)
+{
+    if (!superclass.is_object(ObjectType::AOT_CLASS))
+        error(line, "Superclass must be a class");
+
+    return new AotClass(name, superclass.as<AotClass>());
+}
+
+void Runtime::add_method(const Value& klass, const char* name, AotFunction* method)
+{
+    AotClass* owner = klass.as<AotClass>();
+
+    if (owner->superclass != nullptr)
+        method->superclass = owner->superclass;
+
+    method->is_initializer = std::string(name) == "init";
+    owner->methods[name] = method;
+
+    if (method->is_initializer)
+        owner->initializer = method;
+}
+
+std::string Runtime::stringify(const Value& value)
+{
+    if (!value.is_object())
+        return interpreter.stringify(value);
+
+    switch (value.as_object()->type)
+    {
+        case ObjectType::AOT_FUNCTION:
+        {
+            const std::string& name = value.as<AotFunction>()->name;
+            return name != "" ? "<func " + name + ">" : "<func lambda>";
+        }
+
+        case ObjectType::AOT_CLASS:
+            return value.as<AotClass>()->name;
+
+        case ObjectType::AOT_INSTANCE:
+            return value.as<AotInstance>()->klass->name + " instance";
+
+        case ObjectType::LIST:
+        {
+            std::string result = "[";
+            std::vector<Value>& elements = value.as<ListType>()->elements;
+
+            for (size_t i = 0; i < elements.size(); i++)
+            {
+                if (i > 0)
+                    result.append(", ");
+
+                result.append(stringify(elements[i]));
+            }
+
+            result.append("]");
+            return result;
+        }
+
+        default:
+            return interpreter.stringify(value);
+    }
+}
+
+void Runtime::print(const Value& value)
+{
+    std::cout << stringify(value) + "\n";
+}
@@ -0,0 +1,26 @@
+//------------------------------------//
+// Copyright 2024 Nam Nguyen
+// Licensed under Apache License v2.0
+//------------------------------------//
+
+#include "shape.hpp"
+
+static uint32_t next_id = 1; // 0 marks an unused cache entry
+
+Shape::Shape() : id(next_id++)
+{
+}
+
+Shape* Shape::add(Symbol name)
+{
+    std::unique_ptr<Shape>& next = transitions[name];
+
+    if (next == nullptr)
+    {
+        next = std::make_unique<Shape>();
+        next->names = names;
+        next->names.push_back(name);
+    }
+
+    return next.get();
+}
@@ -0,0 +1,70 @@
+//------------------------------------//
+// Copyright 2024 Nam Nguyen
+// Licensed under Apache License v2.0
+//------------------------------------//
+
+#include <algorithm>
+#include <sys/mman.h>
+#include <pthread.h>
+
+#include "stack.hpp"
+
+// native stack reserved for each script call, a plain call takes about 1KB on the tree-walker
+static constexpr size_t STACK_PER_CALL = 4096;
+// kept free below the limit, for natives and whatever runs between two calls
+static constexpr size_t STACK_MARGIN = 1 << 20;
+// a low limit still gets room for natives and the C++ library, whatever --max-stack says
+static constexpr size_t MIN_RESERVED_CALLS = 1 << 16;
+// left unmapped below the stack, glibc adds no guard to a stack it didn't allocate, so
+// without one an overflow would write into whatever mapping sits below ours
+static constexpr size_t STACK_GUARD = 1 << 16;
+// past this many calls the reservation is capped, the interpreter still stops at its own limit
+static constexpr size_t MAX_RESERVED_CALLS = 1 << 24;
+
+struct ScriptThread
+{
+    const std::function<void(const char*)>* body;
+    const char* limit;
+};
+
+static void* run_thread(void* argument)
+{
+    ScriptThread* thread = static_cast<ScriptThread*>(argument);
+    (*thread->body)(thread->limit);
+    return nullptr;
+}
+
+void run_on_script_stack(size_t max_calls, const std::function<void(const char* limit)>& body)
+{
+    size_t size = STACK_GUARD + std::clamp(max_calls, MIN_RESERVED_CALLS, MAX_RESERVED_CALLS) * STACK_PER_CALL + STACK_MARGIN;
+    void* mapping = mmap(nullptr, size, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS | MAP_NORESERVE, -1, 0);
+
+    if (mapping == MAP_FAILED)
+    {
+        body(nullptr);
+        return;
+    }
+
+    if (mprotect(mapping, STACK_GUARD, PROT_NONE) != 0)
+    {
+        munmap(mapping, size);
+        body(nullptr);
+        return;
+    }
+
+    char* stack = static_cast<char*>(mapping) + STACK_GUARD;
+    ScriptThread script{&body, stack + STACK_MARGIN};
+    pthread_attr_t attributes;
+    pthread_t thread;
+
+    pthread_attr_init(&attributes);
+    pthread_attr_setstack(&attributes, stack, size - STACK_GUARD);
+
+    if (pthread_create(&thread, &attributes, run_thread, &script) == 0)
+        pthread_join(thread, nullptr);
+    else
+        body(nullptr);
+
+    pthread_attr_destroy(&attributes);
+    munmap(mapping, size);
+}
@@ -0,0 +1,39 @@
+//------------------------------------//
+// Copyright 2024 Nam Nguyen
+// Licensed under Apache License v2.0
+//------------------------------------//
+
+#include <unordered_map>
+#include <vector>
+
+#include "symbol.hpp"
+
+Symbol intern(const std::string& name)
+{
+    static std::unordered_map<std::string, Symbol> symbols;
+    auto element = symbols.try_emplace(name, static_cast<Symbol>(symbols.size())).first;
+    return element->second;
+}
+
+// a function so the table exists before the interpreter, itself a global, defines its natives
+static std::vector<std::string>& global_names()
+{
+    static std::vector<std::string> names;
+    return names;
+}
+
+int global_slot(const std::string& name)
+{
+    static std::unordered_map<std::string, int> slots;
+    auto [element, added] = slots.try_emplace(name, static_cast<int>(slots.size()));
+
+    if (added)
+        global_names().push_back(name);
+
+    return element->second;
+}
+
+const std::string& global_name(int slot)
+{
+    return global_names()[slot];
+}
@@ -0,0 +1,1079 @@
+//------------------------------------//
+// Copyright 2024 Nam Nguyen
+// Licensed under Apache License v2.0
+//------------------------------------//
+
+#include <algorithm>
+#include <cstddef>
+#include <exception>
+#include <set>
+
+#include "trace.hpp"
+#include "assembler.hpp"
+#include "interpreter.hpp"
+
+// what the native code hands back to LoopTrace::run, the callout helper returns the same codes
+enum TraceStatus : int
+{
+    TRACE_CONTINUE = 0, // a callout finished normally
+    TRACE_NOT_ENTERED,
+    TRACE_LOOP_DONE, // the condition came out false or a callout broke out of the loop
+    TRACE_RETURN,
+    TRACE_ERROR,
+    TRACE_SIDE_EXIT
+};
+
+// handed to the native code in rdi, it keeps it in rbx
+struct TraceState
+{
+    Value** variables; // address of every TraceVariable
+    LoopTrace* trace;
+    Interpreter* interpreter;
+    Environment** environments; // the loop's, then one for each block
+    std::exception_ptr* error;
+    int exit;
+};
+
+using TraceEntry = int (*)(TraceState* state);
+
+// does anything in the statement capture the environment it runs in
+static bool creates_closures(Expr* expr);
+
+static bool creates_closures(Stmt* stmt)
+{
+    if (stmt == nullptr)
+        return false;
+
+    switch (stmt->kind)
+    {
+        case StmtKind::BLOCK:
+            for (const std::shared_ptr<Stmt>& inner : static_cast<BlockStmt*>(stmt)->statements)
+            {
+                if (creates_closures(inner.get()))
+                    return true;
+            }
+            return false;
+
+        case StmtKind::EXPRESSION: return creates_closures(static_cast<ExpressionStmt*>(stmt)->expression.get());
+        case StmtKind::PRINT: return creates_closures(static_cast<PrintStmt*>(stmt)->expression.get());
+        case StmtKind::MUT: return creates_closures(static_cast<MutStmt*>(stmt)->initializer.get());
+        case StmtKind::RETURN: return creates_closures(static_cast<ReturnStmt*>(stmt)->value.get());
+
+        case StmtKind::IF:
+        {
+            IfStmt* branch = static_cast<IfStmt*>(stmt);
+            return creates_closures(branch->condition.get()) || creates_closures(branch->then_branch.get())
+                || creates_closures(branch->else_branch.get());
+        }
+
+        case StmtKind::WHILE:
+        {
+            WhileStmt* loop = static_cast<WhileStmt*>(stmt);
+            return creates_closures(loop->condition.get()) || creates_closures(loop->body.get());
+        }
+
+        case StmtKind::BREAK:
+            return false;
+
+        default: // functions, classes and imports
+            return true;
+    }
+}
+
+static bool creates_closures(Expr* expr)
+{
+    if (expr == nullptr)
+        return false;
+
+    switch (generic_kind(expr->kind))
+    {
+        case ExprKind::ASSIGN: return creates_closures(static_cast<AssignExpr*>(expr)->value.get());
+        case ExprKind::GROUPING: return creates_closures(static_cast<GroupingExpr*>(expr)->expression.get());
+        case ExprKind::UNARY: return creates_closures(static_cast<UnaryExpr*>(expr)->right.get());
+        case ExprKind::GET: return creates_closures(static_cast<GetExpr*>(expr)->object.get());
+
+        case ExprKind::BINARY:
+        {
+            BinaryExpr* binary = static_cast<BinaryExpr*>(expr);
+            return creates_closures(binary->left.get()) || creates_closures(binary->right.get());
+        }
+
+        case ExprKind::LOGICAL:
+        {
+            LogicalExpr* logical = static_cast<LogicalExpr*>(expr);
+            return creates_closures(logical->left.get()) || creates_closures(logical->right.get());
+        }
+
+        case ExprKind::SET:
+        {
+            SetExpr* set = static_cast<SetExpr*>(expr);
+            return creates_closures(set->object.get()) || creates_closures(set->value.get());
+        }
+
+        case ExprKind::SUBSCRIPT:
+        {
+            SubscriptExpr* subscript = static_cast<SubscriptExpr*>(expr);
+            return creates_closures(subscript->name.get()) || creates_closures(subscript->index.get())
+                || creates_closures(subscript->value.get());
+        }
+
+        case ExprKind::CALL:
+        {
+            CallExpr* call = static_cast<CallExpr*>(expr);
+
+            if (creates_closures(call->callee.get()))
+                return true;
+
+            return std::any_of(call->arguments.begin(), call->arguments.end(),
+                [](const std::shared_ptr<Expr>& argument) { return creates_closures(argument.get()); });
+        }
+
+        case ExprKind::LIST:
+        {
+            const std::vector<std::shared_ptr<Expr>>& elements = static_cast<ListExpr*>(expr)->elements;
+
+            return std::any_of(elements.begin(), elements.end(),
+                [](const std::shared_ptr<Expr>& element) { return creates_closures(element.get()); });
+        }
+
+        case ExprKind::FUNCTION:
+            return true;
+
+        default:
+            return false;
+    }
+}
+
+// whether a block in stmt has locals a closure captures. LoopTrace::run reuses block environments and
+// makes no cells, such a loop is never traced even if creates_closures() missed the closure
+static bool has_cells(Stmt* stmt)
+{
+    if (stmt == nullptr)
+        return false;
+
+    switch (stmt->kind)
+    {
+        case StmtKind::BLOCK:
+        {
+            BlockStmt* block = static_cast<BlockStmt*>(stmt);
+
+            if (!block->cells.empty())
+                return true;
+
+            return std::any_of(block->statements.begin(), block->statements.end(),
+                [](const std::shared_ptr<Stmt>& inner) { return has_cells(inner.get()); });
+        }
+
+        case StmtKind::IF:
+        {
+            IfStmt* branch = static_cast<IfStmt*>(stmt);
+            return has_cells(branch->then_branch.get()) || has_cells(branch->else_branch.get());
+        }
+
+        case StmtKind::WHILE:
+            return has_cells(static_cast<WhileStmt*>(stmt)->body.get());
+
+        default:
+            return false;
+    }
+}
+
+int LoopTrace::callout(TraceState* state, int index)
+{
+    // exceptions can't unwind through the native frame, they're rethrown by run()
+    try
+    {
+        const Callout& callout = state->trace->callouts[index];
+        Interpreter& interpreter = *state->interpreter;
+
+        interpreter.environment = state->environments[callout.scope + 1];
+        ExecResult result = interpreter.execute(callout.stmt);
+
+        if (result == ExecResult::BREAK)
+            return TRACE_LOOP_DONE;
+
+        if (result == ExecResult::RETURN)
+            return TRACE_RETURN;
+
+        return TRACE_CONTINUE;
+    }
+    catch (...)
+    {
+        *state->error = std::current_exception();
+        return TRACE_ERROR;
+    }
+}
+
+bool LoopTrace::run(Interpreter& interpreter, ExecResult& result)
+{
+    Environment* loop_environment = interpreter.environment;
+
+    // block environments are made once per entry and reused by every iteration, the body makes no closures
+    std::vector<std::unique_ptr<Environment>> block_environments;
+    std::vector<Environment*> environments{loop_environment};
+
+    for (const Block& block : blocks)
+    {
+        block_environments.push_back(std::make_unique<Environment>(environments[block.parent + 1], nullptr, block.block->slot_count));
+        environments.push_back(block_environments.back().get());
+    }
+
+    std::vector<Value*> addresses(variables.size());
+
+    for (size_t i = 0; i < variables.size(); i++)
+    {
+        const TraceVariable& variable = variables[i];
+
+        switch (variable.place)
+        {
+            case TraceVariable::INNER:
+                addresses[i] = &environments[variable.scope + 1]->slots[variable.slot];
+                break;
+
+            case TraceVariable::OUTER:
+                addresses[i] = &loop_environment->ancestor(variable.scope)->slots[variable.slot];
+
+                if (variable.cell)
+                    addresses[i] = &addresses[i]->as<Cell>()->value;
+                break;
+
+            case TraceVariable::UPVALUE:
+                addresses[i] = &(*interpreter.upvalues)[variable.slot]->value;
+                break;
+
+            case TraceVariable::GLOBAL:
+            {
+                Value* global = interpreter.globals->global(variable.slot);
+
+                if (global == nullptr)
+                {
+                    exits_taken++;
+                    return false;
+                }
+
+                addresses[i] = global;
+                break;
+            }
+        }
+    }
+
+    std::exception_ptr error;
+    TraceState state{addresses.data(), this, &interpreter, environments.data(), &error, -1};
+    int status = reinterpret_cast<TraceEntry>(code.memory)(&state);
+
+    interpreter.environment = loop_environment; // callouts move it
+
+    switch (status)
+    {
+        case TRACE_NOT_ENTERED:
+            exits_taken++;
+            return false;
+
+        case TRACE_LOOP_DONE:
+            result = ExecResult::BREAK;
+            return true;
+
+        case TRACE_RETURN:
+            result = ExecResult::RETURN;
+            return true;
+
+        case TRACE_ERROR:
+            std::rethrow_exception(error);
+
+        default:
+            break;
+    }
+
+    // side exit, the interpreter finishes the iteration from where the trace left it
+    exits_taken++;
+    result = ExecResult::NORMAL;
+
+    for (const TraceFrame& frame : exits[state.exit])
+    {
+        interpreter.environment = environments[frame.scope + 1];
+
+        for (const std::shared_ptr<Stmt>* stmt = frame.next; stmt != frame.end; stmt++)
+        {
+            result = interpreter.execute(stmt->get());
+
+            if (result != ExecResult::NORMAL)
+            {
+                interpreter.environment = loop_environment;
+                return true;
+            }
+        }
+    }
+
+    interpreter.environment = loop_environment;
+    return true;
+}
+
+#ifdef NBL_JIT
+
+// Emits the recorded ops as one native loop. Variables live unboxed in xmm6 to xmm15
+// and are only boxed back into their Values around callouts and on the way out:
+//   rbx  the TraceState
+//   r12  the variables' addresses
+//   xmm0 to xmm5 scratch for expressions
+class TraceEmitter : Assembler
+{
+    private:
+        static constexpr int SCRATCH = 6;
+        static constexpr uint64_t QNAN = 0x7ffc000000000000; // see Value
+        static constexpr int32_t INT_TAG = 0x7ffd; // top 16 bits of an integer Value
+
+        LoopTrace& trace;
+        Expr* condition;
+        const std::vector<TraceRecorder::Op>& ops;
+        const std::map<Expr*, int>& bound;
+        std::set<int> written;
+
+        struct Stub
+        {
+            std::vector<size_t> jumps;
+            std::set<int> write_back;
+            int exit;
+        };
+
+        std::vector<Stub> stubs;
+        std::vector<size_t> leave_jumps; // eax already holds the status
+
+        static int reg(int variable) { return SCRATCH + variable; }
+
+        // sse instruction on two xmm registers, reg is the destination
+        void sse(uint8_t prefix, uint8_t opcode, int reg, int rm)
+        {
+            emit({prefix});
+
+            if (reg >= 8 || rm >= 8)
+                emit({static_cast<uint8_t>(0x40 | (reg >= 8 ? 4 : 0) | (rm >= 8 ? 1 : 0))});
+
+            emit({0x0F, opcode, static_cast<uint8_t>(0xC0 | (reg & 7) << 3 | (rm & 7))});
+        }
+
+        void move(int to, int from) { if (to != from) sse(0xF2, 0x10, to, from); } // movsd
+        void movq_from_rax(int xmm) { emit({0x66, static_cast<uint8_t>(xmm >= 8 ? 0x4C : 0x48), 0x0F, 0x6E, static_cast<uint8_t>(0xC0 | (xmm & 7) << 3)}); }
+
+        void load_constant(int xmm, double number)
+        {
+            uint64_t bits;
+            std::memcpy(&bits, &number, 8);
+            emit({0x48, 0xB8}); emit64(bits); // mov rax, imm64
+            movq_from_rax(xmm);
+        }
+
+        void address(int variable)
+        {
+            emit({0x49, 0x8B, 0x84, 0x24}); emit32(8 * variable); // mov rax, [r12 + 8 * variable]
+        }
+
+        // unboxes a variable into its register, jumping to fail when it isn't a number,
+        // integers are converted and the loop works on doubles
+        void unbox(int variable, std::vector<size_t>& fail)
+        {
+            int xmm = reg(variable);
+            address(variable);
+            emit({0x48, 0x8B, 0x00}); // mov rax, [rax]
+            emit({0x48, 0x89, 0xC2}); // mov rdx, rax
+            emit({0x48, 0xC1, 0xEA, 0x30}); // shr rdx, 48
+            emit({0x81, 0xFA}); emit32(INT_TAG); // cmp edx, INT_TAG
+            size_t not_int = jump({0x0F, 0x85}); // jne not_int
+            emit({0x48, 0xC1, 0xE0, 0x10}); // shl rax, 16
+            emit({0x48, 0xC1, 0xF8, 0x10}); // sar rax, 16, sign extends the payload
+            emit({0xF2, static_cast<uint8_t>(xmm >= 8 ? 0x4C : 0x48), 0x0F, 0x2A, static_cast<uint8_t>(0xC0 | (xmm & 7) << 3)}); // cvtsi2sd xmm, rax
+            size_t done = jump({0xE9});
+
+            patch(not_int, code.size());
+            emit({0x48, 0x89, 0xC2}); // mov rdx, rax
+            emit({0x48, 0xB9}); emit64(QNAN); // mov rcx, QNAN
+            emit({0x48, 0x21, 0xCA}); // and rdx, rcx
+            emit({0x48, 0x39, 0xCA}); // cmp rdx, rcx
+            fail.push_back(jump({0x0F, 0x84})); // je fail
+            movq_from_rax(xmm);
+            patch(done, code.size());
+        }
+
+        // a double is its own Value, so boxing is a plain store
+        void box(int variable)
+        {
+            int xmm = reg(variable);
+            address(variable);
+            emit({0xF2});
+
+            if (xmm >= 8)
+                emit({0x44});
+
+            emit({0x0F, 0x11, static_cast<uint8_t>((xmm & 7) << 3)}); // movsd [rax], xmm
+        }
+
+        void box_all(const std::set<int>& variables)
+        {
+            for (int variable : variables)
+                box(variable);
+        }
+
+        void leave_with(int status)
+        {
+            emit({0xB8}); emit32(status); // mov eax, status
+            leave_jumps.push_back(jump({0xE9}));
+        }
+
+        std::set<int> dirty(const std::set<int>& live)
+        {
+            std::set<int> result;
+            std::set_intersection(live.begin(), live.end(), written.begin(), written.end(), std::inserter(result, result.begin()));
+            return result;
+        }
+
+        Stub& stub(int exit, std::set<int> write_back)
+        {
+            stubs.push_back({{}, std::move(write_back), exit});
+            return stubs.back();
+        }
+
+        void find_writes(Expr* expr);
+        void number(Expr* expr, int target);
+        void branch(Expr* expr, bool when, std::vector<size_t>& targets);
+
+    public:
+        TraceEmitter(LoopTrace& trace, Expr* condition, const std::vector<TraceRecorder::Op>& ops, const std::map<Expr*, int>& bound)
+            : trace(trace), condition(condition), ops(ops), bound(bound) {}
+
+        bool compile();
+};
+
+void TraceEmitter::find_writes(Expr* expr)
+{
+    switch (generic_kind(expr->kind))
+    {
+        case ExprKind::ASSIGN:
+            written.insert(bound.at(expr));
+            find_writes(static_cast<AssignExpr*>(expr)->value.get());
+            return;
+
+        case ExprKind::GROUPING:
+            find_writes(static_cast<GroupingExpr*>(expr)->expression.get());
+            return;
+
+        case ExprKind::UNARY:
+            find_writes(static_cast<UnaryExpr*>(expr)->right.get());
+            return;
+
+        case ExprKind::BINARY:
+            find_writes(static_cast<BinaryExpr*>(expr)->left.get());
+            find_writes(static_cast<BinaryExpr*>(expr)->right.get());
+            return;
+
+        default:
+            return;
+    }
+}
+
+// only what TraceRecorder::numeric accepted gets here
+void TraceEmitter::number(Expr* expr, int target)
+{
+    switch (generic_kind(expr->kind))
+    {
+        case ExprKind::LITERAL:
+            load_constant(target, static_cast<LiteralExpr*>(expr)->value.as_number());
+            return;
+
+        case ExprKind::GROUPING:
+            number(static_cast<GroupingExpr*>(expr)->expression.get(), target);
+            return;
+
+        case ExprKind::MUT:
+            move(target, reg(bound.at(expr)));
+            return;
+
+        case ExprKind::ASSIGN:
+            number(static_cast<AssignExpr*>(expr)->value.get(), target);
+            move(reg(bound.at(expr)), target);
+            return;
+
+        case ExprKind::UNARY:
+            number(static_cast<UnaryExpr*>(expr)->right.get(), target);
+            emit({0x48, 0xB8}); emit64(0x8000000000000000); // mov rax, sign bit
+            movq_from_rax(target + 1);
+            sse(0x66, 0x57, target, target + 1); // xorpd
+            return;
+
+        default:
+            break;
+    }
+
+    BinaryExpr* binary = static_cast<BinaryExpr*>(expr);
+    Expr* right = binary->right.get();
+    int operand = target + 1;
+
+    number(binary->left.get(), target);
+
+    if (generic_kind(right->kind) == ExprKind::MUT)
+        operand = reg(bound.at(right));
+    else
+        number(right, operand);
+
+    switch (binary->op.type)
+    {
+        case PLUS: case PLUS_EQUAL: sse(0xF2, 0x58, target, operand); return; // addsd
+        case MINUS: case MINUS_EQUAL: sse(0xF2, 0x5C, target, operand); return; // subsd
+        case STAR: case STAR_EQUAL: sse(0xF2, 0x59, target, operand); return; // mulsd
+        default: sse(0xF2, 0x5E, target, operand); return; // divsd
+    }
+}
+
+// jumps to targets when expr evaluates to when, falls through otherwise
+void TraceEmitter::branch(Expr* expr, bool when, std::vector<size_t>& targets)
+{
+    switch (generic_kind(expr->kind))
+    {
+        case ExprKind::GROUPING:
+            branch(static_cast<GroupingExpr*>(expr)->expression.get(), when, targets);
+            return;
+
+        case ExprKind::LITERAL:
+            if (static_cast<LiteralExpr*>(expr)->value.as_bool() == when)
+                targets.push_back(jump({0xE9})); // jmp
+            return;
+
+        case ExprKind::UNARY:
+            branch(static_cast<UnaryExpr*>(expr)->right.get(), !when, targets);
+            return;
+
+        case ExprKind::LOGICAL:
+        {
+            LogicalExpr* logical = static_cast<LogicalExpr*>(expr);
+
+            if ((logical->op.type == OR) == when)
+            {
+                branch(logical->left.get(), when, targets);
+                branch(logical->right.get(), when, targets);
+                return;
+            }
+
+            std::vector<size_t> skip;
+            branch(logical->left.get(), !when, skip);
+            branch(logical->right.get(), when, targets);
+            patch_all(skip, code.size());
+            return;
+        }
+
+        default:
+            break;
+    }
+
+    BinaryExpr* binary = static_cast<BinaryExpr*>(expr);
+    TokenType op = binary->op.type;
+    Expr* right = binary->right.get();
+    int operand = 1;
+
+    number(binary->left.get(), 0);
+
+    if (generic_kind(right->kind) == ExprKind::MUT)
+        operand = reg(bound.at(right));
+    else
+        number(right, operand);
+
+    // same flags as the function JIT, NaN compares false
+    if (op == LESS || op == LESS_EQUAL)
+        sse(0x66, 0x2E, operand, 0); // ucomisd right, left
+    else
+        sse(0x66, 0x2E, 0, operand); // ucomisd left, right
+
+    switch (op)
+    {
+        case LESS: case GREATER:
+            targets.push_back(jump({0x0F, static_cast<uint8_t>(when ? 0x87 : 0x86)})); // ja / jbe
+            return;
+
+        case LESS_EQUAL: case GREATER_EQUAL:
+            targets.push_back(jump({0x0F, static_cast<uint8_t>(when ? 0x83 : 0x82)})); // jae / jb
+            return;
+
+        default:
+            break;
+    }
+
+    if ((op == EQUAL_EQUAL) == when)
+    {
+        size_t unordered = jump({0x0F, 0x8A}); // jp over
+        targets.push_back(jump({0x0F, 0x84})); // je
+        patch(unordered, code.size());
+    }
+    else
+    {
+        targets.push_back(jump({0x0F, 0x85})); // jne
+        targets.push_back(jump({0x0F, 0x8A})); // jp
+    }
+}
+
+bool TraceEmitter::compile()
+{
+    for (const TraceRecorder::Op& op : ops)
+    {
+        if (op.kind == TraceRecorder::OpKind::EVALUATE || op.kind == TraceRecorder::OpKind::DECLARE)
+            find_writes(op.expr);
+
+        if (op.kind == TraceRecorder::OpKind::DECLARE)
+            written.insert(op.variable);
+    }
+
+    // variables from outside the loop are live all the way round, locals of the body from their mut on
+    std::set<int> outer;
+
+    for (size_t i = 0; i < trace.variables.size(); i++)
+    {
+        if (trace.variables[i].place != TraceVariable::INNER)
+            outer.insert(i);
+    }
+
+    emit({0x55}); // push rbp
+    emit({0x48, 0x89, 0xE5}); // mov rbp, rsp
+    emit({0x53}); // push rbx
+    emit({0x41, 0x54}); // push r12
+    emit({0x48, 0x89, 0xFB}); // mov rbx, rdi
+    emit({0x4C, 0x8B, 0x67, static_cast<uint8_t>(offsetof(TraceState, variables))}); // mov r12, [rdi + variables]
+
+    // type guards are hoisted out of the loop, checked once here and again only after callouts
+    std::vector<size_t> not_entered;
+
+    for (int variable : outer)
+        unbox(variable, not_entered);
+
+    size_t header = code.size();
+    std::vector<size_t> done;
+    std::set<int> live = outer;
+
+    branch(condition, false, done);
+
+    for (const TraceRecorder::Op& op : ops)
+    {
+        switch (op.kind)
+        {
+            case TraceRecorder::OpKind::EVALUATE:
+                number(op.expr, 0);
+                break;
+
+            case TraceRecorder::OpKind::DECLARE:
+                number(op.expr, 0);
+                move(reg(op.variable), 0);
+                live.insert(op.variable);
+                break;
+
+            case TraceRecorder::OpKind::GUARD:
+                branch(op.expr, !op.expected, stub(op.exit, dirty(live)).jumps);
+                break;
+
+            case TraceRecorder::OpKind::CALLOUT:
+            {
+                box_all(dirty(live));
+                emit({0x48, 0x89, 0xDF}); // mov rdi, rbx
+                emit({0xBE}); emit32(op.callout); // mov esi, callout
+                call_absolute(reinterpret_cast<const void*>(&LoopTrace::callout));
+                emit({0x85, 0xC0}); // test eax, eax
+                leave_jumps.push_back(jump({0x0F, 0x85})); // jnz leave
+
+                if (op.declares != nullptr)
+                {
+                    auto declared = std::find(trace.variables.begin(), trace.variables.end(), *op.declares);
+
+                    if (declared != trace.variables.end())
+                        live.insert(declared - trace.variables.begin());
+                }
+
+                // the interpreter may have changed anything, its Values are the truth now
+                std::vector<size_t>& fail = stub(op.exit, {}).jumps;
+
+                for (int variable : live)
+                    unbox(variable, fail);
+                break;
+            }
+        }
+    }
+
+    patch(jump({0xE9}), header); // jmp header
+
+    patch_all(done, code.size());
+    box_all(dirty(outer));
+    leave_with(TRACE_LOOP_DONE);
+
+    for (const Stub& exit : stubs)
+    {
+        patch_all(exit.jumps, code.size());
+        box_all(exit.write_back);
+        emit({0xC7, 0x43, static_cast<uint8_t>(offsetof(TraceState, exit))}); emit32(exit.exit); // mov [rbx + exit], exit
+        leave_with(TRACE_SIDE_EXIT);
+    }
+
+    patch_all(not_entered, code.size());
+    leave_with(TRACE_NOT_ENTERED);
+
+    patch_all(leave_jumps, code.size());
+    emit({0x41, 0x5C}); // pop r12
+    emit({0x5B}); // pop rbx
+    emit({0x5D}); // pop rbp
+    emit({0xC3}); // ret
+
+    return install(trace.code);
+}
+
+#endif
+
+TraceRecorder::TraceRecorder(Interpreter& interpreter, WhileStmt* loop)
+    : interpreter(interpreter), loop(loop) {}
+
+TraceVariable TraceRecorder::place(const Token& name, const Binding& binding)
+{
+    if (binding.depth < 0)
+        return {TraceVariable::GLOBAL, 0, binding.slot};
+
+    if (binding.upvalue >= 0)
+        return {TraceVariable::UPVALUE, 0, binding.upvalue};
+
+    int at = scope;
+    int depth = binding.depth;
+
+    while (depth > 0 && at >= 0)
+    {
+        at = trace->blocks[at].parent;
+        depth--;
+    }
+
+    if (at >= 0)
+        return {TraceVariable::INNER, at, binding.slot};
+
+    return {TraceVariable::OUTER, depth, binding.slot, binding.cell};
+}
+
+int TraceRecorder::variable(const TraceVariable& variable)
+{
+    auto found = std::find(trace->variables.begin(), trace->variables.end(), variable);
+
+    if (found != trace->variables.end())
+        return found - trace->variables.begin();
+
+    trace->variables.push_back(variable);
+    return trace->variables.size() - 1;
+}
+
+bool TraceRecorder::is_number(const Token& name, const Binding& binding)
+{
+    if (binding.depth >= 0)
+        return interpreter.local(binding).is_number();
+
+    Value* global = interpreter.globals->global(binding.slot);
+    return global != nullptr && global->is_number();
+}
+
+// scratch registers the expression needs when it only ever sees numbers, 0 when it doesn't
+int TraceRecorder::numeric(Expr* expr, bool pure, std::vector<std::pair<Expr*, TraceVariable>>& uses)
+{
+    switch (generic_kind(expr->kind))
+    {
+        case ExprKind::LITERAL:
+            return static_cast<LiteralExpr*>(expr)->value.is_number() ? 1 : 0;
+
+        case ExprKind::GROUPING:
+            return numeric(static_cast<GroupingExpr*>(expr)->expression.get(), pure, uses);
+
+        case ExprKind::MUT:
+        {
+            MutExpr* mut = static_cast<MutExpr*>(expr);
+
+            if (!is_number(mut->name, mut->binding))
+                return 0;
+
+            uses.emplace_back(expr, place(mut->name, mut->binding));
+            return 1;
+        }
+
+        case ExprKind::ASSIGN:
+        {
+            AssignExpr* assign = static_cast<AssignExpr*>(expr);
+
+            if (pure || (assign->binding.depth < 0 && interpreter.globals->global(assign->binding.slot) == nullptr))
+                return 0;
+
+            uses.emplace_back(expr, place(assign->name, assign->binding));
+            return numeric(assign->value.get(), pure, uses);
+        }
+
+        case ExprKind::UNARY:
+        {
+            UnaryExpr* unary = static_cast<UnaryExpr*>(expr);
+
+            if (unary->op.type != MINUS)
+                return 0;
+
+            int right = numeric(unary->right.get(), pure, uses);
+            return right == 0 ? 0 : std::max(right, 2);
+        }
+
+        case ExprKind::BINARY:
+        {
+            BinaryExpr* binary = static_cast<BinaryExpr*>(expr);
+
+            switch (binary->op.type)
+            {
+                case PLUS: case PLUS_EQUAL: case MINUS: case MINUS_EQUAL:
+                case STAR: case STAR_EQUAL: case SLASH: case SLASH_EQUAL:
+                    break;
+                default:
+                    return 0;
+            }
+
+            int left = numeric(binary->left.get(), pure, uses);
+            int right = numeric(binary->right.get(), pure, uses);
+
+            if (left == 0 || right == 0)
+                return 0;
+
+            // a variable on the right is used straight from its register
+            if (generic_kind(binary->right->kind) == ExprKind::MUT)
+                return left;
+
+            return std::max(left, right + 1);
+        }
+
+        default:
+            return 0;
+    }
+}
+
+int TraceRecorder::condition(Expr* expr, std::vector<std::pair<Expr*, TraceVariable>>& uses)
+{
+    switch (generic_kind(expr->kind))
+    {
+        case ExprKind::GROUPING:
+            return condition(static_cast<GroupingExpr*>(expr)->expression.get(), uses);
+
+        case ExprKind::LITERAL:
+            return static_cast<LiteralExpr*>(expr)->value.is_bool() ? 1 : 0;
+
+        case ExprKind::UNARY:
+        {
+            UnaryExpr* unary = static_cast<UnaryExpr*>(expr);
+            return unary->op.type == BANG ? condition(unary->right.get(), uses) : 0;
+        }
+
+        case ExprKind::LOGICAL:
+        {
+            LogicalExpr* logical = static_cast<LogicalExpr*>(expr);
+            int left = condition(logical->left.get(), uses);
+            int right = condition(logical->right.get(), uses);
+
+            return left == 0 || right == 0 ? 0 : std::max(left, right);
+        }
+
+        case ExprKind::BINARY:
+        {
+            BinaryExpr* binary = static_cast<BinaryExpr*>(expr);
+
+            switch (binary->op.type)
+            {
+                case LESS: case LESS_EQUAL: case GREATER: case GREATER_EQUAL: case EQUAL_EQUAL: case BANG_EQUAL:
+                    break;
+                default:
+                    return 0;
+            }
+
+            int left = numeric(binary->left.get(), true, uses);
+            int right = numeric(binary->right.get(), true, uses);
+
+            if (left == 0 || right == 0)
+                return 0;
+
+            if (generic_kind(binary->right->kind) == ExprKind::MUT)
+                return left;
+
+            return std::max(left, right + 1);
+        }
+
+        default:
+            return 0;
+    }
+}
+
+// can the expression run natively, binds its variables if so
+bool TraceRecorder::native(Expr* expr, bool is_condition)
+{
+    std::vector<std::pair<Expr*, TraceVariable>> uses;
+    int registers = is_condition ? condition(expr, uses) : numeric(expr, false, uses);
+
+    if (registers == 0 || registers > 6)
+        return false;
+
+    std::vector<TraceVariable> fresh;
+
+    for (const auto& [node, variable] : uses)
+    {
+        if (std::find(trace->variables.begin(), trace->variables.end(), variable) == trace->variables.end()
+            && std::find(fresh.begin(), fresh.end(), variable) == fresh.end())
+            fresh.push_back(variable);
+    }
+
+    if (trace->variables.size() + fresh.size() > MAX_VARIABLES)
+        return false;
+
+    for (const auto& [node, variable] : uses)
+        bound[node] = this->variable(variable);
+
+    return true;
+}
+
+// where to pick up after leaving here, either at the current statement or after it
+int TraceRecorder::exit(bool rerun)
+{
+    std::vector<TraceFrame> frames;
+
+    for (auto position = positions.rbegin(); position != positions.rend(); position++)
+    {
+        bool innermost = position == positions.rbegin();
+        frames.push_back({innermost && rerun ? position->at : position->at + 1, position->end, position->scope});
+    }
+
+    trace->exits.push_back(std::move(frames));
+    return trace->exits.size() - 1;
+}
+
+ExecResult TraceRecorder::callout(Stmt* stmt, std::shared_ptr<TraceVariable> declares)
+{
+    Op op{OpKind::CALLOUT};
+    op.declares = std::move(declares);
+    op.callout = trace->callouts.size();
+    op.exit = exit(false);
+
+    trace->callouts.push_back({stmt, scope});
+    ops.push_back(op);
+
+    return interpreter.execute(stmt);
+}
+
+ExecResult TraceRecorder::record(const std::shared_ptr<Stmt>* begin, const std::shared_ptr<Stmt>* end)
+{
+    positions.push_back({end, begin, scope});
+
+    for (const std::shared_ptr<Stmt>* at = begin; at != end; at++)
+    {
+        positions.back().at = at;
+        ExecResult result = record(at->get());
+
+        if (result != ExecResult::NORMAL)
+            return result;
+    }
+
+    positions.pop_back();
+    return ExecResult::NORMAL;
+}
+
+ExecResult TraceRecorder::record(Stmt* stmt)
+{
+    switch (stmt->kind)
+    {
+        case StmtKind::BLOCK:
+        {
+            BlockStmt* block = static_cast<BlockStmt*>(stmt);
+            int outer = scope;
+
+            if (!block->scoped)
+                return record(block->statements.data(), block->statements.data() + block->statements.size());
+
+            trace->blocks.push_back({block, scope});
+            scope = trace->blocks.size() - 1;
+
+            Environment* previous = interpreter.environment;
+            Value* frame = interpreter.push_frame(block->slot_count);
+            Environment environment(previous, frame, block->slot_count);
+            interpreter.environment = &environment;
+
+            ExecResult result = record(block->statements.data(), block->statements.data() + block->statements.size());
+
+            interpreter.environment = previous;
+            interpreter.pop_frame(frame);
+            scope = outer;
+            return result;
+        }
+
+        case StmtKind::EXPRESSION:
+        {
+            Expr* expr = static_cast<ExpressionStmt*>(stmt)->expression.get();
+
+            if (!native(expr, false))
+                return callout(stmt);
+
+            ops.push_back({OpKind::EVALUATE, expr});
+            return interpreter.execute(stmt);
+        }
+
+        case StmtKind::MUT:
+        {
+            MutStmt* mut = static_cast<MutStmt*>(stmt);
+
+            if (scope < 0 || mut->slot < 0) // globals are defined by name
+                return callout(stmt);
+
+            TraceVariable local{TraceVariable::INNER, scope, mut->slot};
+            bool known = std::find(trace->variables.begin(), trace->variables.end(), local) != trace->variables.end();
+
+            if (mut->initializer == nullptr || (!known && trace->variables.size() >= MAX_VARIABLES) || !native(mut->initializer.get(), false))
+                return callout(stmt, std::make_shared<TraceVariable>(local));
+
+            Op op{OpKind::DECLARE, mut->initializer.get()};
+            op.variable = variable(local);
+            ops.push_back(op);
+            return interpreter.execute(stmt);
+        }
+
+        case StmtKind::IF:
+        {
+            IfStmt* branch = static_cast<IfStmt*>(stmt);
+
+            if (!native(branch->condition.get(), true))
+                return callout(stmt);
+
+            Op op{OpKind::GUARD, branch->condition.get()};
+            op.expected = interpreter.is_truthy(interpreter.evaluate(branch->condition.get()));
+            op.exit = exit(true); // the condition is pure, running the if again is safe
+            ops.push_back(op);
+
+            std::shared_ptr<Stmt>& taken = op.expected ? branch->then_branch : branch->else_branch;
+
+            if (taken == nullptr)
+                return ExecResult::NORMAL;
+
+            return record(&taken, &taken + 1);
+        }
+
+        default:
+            return callout(stmt);
+    }
+}
+
+ExecResult TraceRecorder::record()
+{
+    // the loop's condition was just checked by exec_while
+    if (creates_closures(loop->body.get()) || has_cells(loop->body.get()) || !native(loop->condition.get(), true))
+    {
+        loop->traceable = false;
+        return interpreter.execute(loop->body.get());
+    }
+
+    ExecResult result = record(&loop->body, &loop->body + 1);
+
+    // an iteration that left the loop isn't worth compiling, the next one that runs gets recorded
+    if (result != ExecResult::NORMAL)
+        return result;
+
+#ifdef NBL_JIT
+    bool has_native = std::any_of(ops.begin(), ops.end(), [](const Op& op) { return op.kind != OpKind::CALLOUT; });
+
+    if (has_native && TraceEmitter(*trace, loop->condition.get(), ops, bound).compile())
+    {
+        loop->trace = trace;
+        return result;
+    }
+#endif
+
+    loop->traceable = false;
+    return result;
+}
@@ -4,6 +4,9 @@
 //------------------------------------//
 
 #include "util.hpp"
+#include "aot.hpp"
+#include "optimizer.hpp"
+#include "printer.hpp"
 
 void run(const std::string& source, Interpreter& interpreter, std::string base_dir)
 {
@@ -16,15 +19,18 @@ void run(const std::string& source, Interpreter& interpreter, std::string base_d
     if (Error::has_error) // syntax error
         return;
 
-    Resolver resolver{interpreter, base_dir};
+    Resolver resolver{base_dir};
     resolver.resolve(statements);
 
     if (Error::has_error) // resolution error
         return;
 
-    interpreter.interpret(statements);
+    Optimizer{interpreter, interpreter.optimize_level}.optimize(statements);
+
+    if (interpreter.print_ast)
+        std::cerr << AstPrinter{interpreter}.print(statements);
 
-    // std::cout << AstPrinter{}.print(expression) + "\n";
+    interpreter.interpret(statements);
 }
 
 void run_file(const std::string& path, Interpreter& interpreter)
@@ -46,6 +52,24 @@ void run_file(const std::string& path, Interpreter& interpreter)
         exit(3);
 }
 
+// prints the script compiled to C++, see doc/aot.md
+void emit_file(const std::string& path, size_t max_stack)
+{
+    std::vector<std::shared_ptr<Stmt>> statements = AotCompiler::parse(path);
+
+    if (Error::has_error)
+        exit(2);
+
+    AotCompiler compiler;
+    compiler.max_stack = max_stack;
+    std::string source = compiler.compile(statements);
+
+    if (Error::has_error) // in an imported file
+        exit(2);
+
+    std::cout << source;
+}
+
 void run_prompt(Interpreter& interpreter)
 {
     std::string text;
@@ -72,7 +96,7 @@ void run_prompt(Interpreter& interpreter)
                 continue;
             }
             
-            Resolver resolver{interpreter, base_dir};
+            Resolver resolver{base_dir};
             resolver.resolve(std::any_cast<std::vector<std::shared_ptr<Stmt>>>(syntax));
 
             if (syntax.type() == typeid(std::vector<std::shared_ptr<Stmt>>))
@@ -0,0 +1,34 @@
+//------------------------------------//
+// Copyright 2024 Nam Nguyen
+// Licensed under Apache License v2.0
+//------------------------------------//
+
+#include <vector>
+
+#include "value.hpp"
+
+// a destructor that releases the last reference to another object queues it here instead of deleting
+// it right away, so a list of a million instances is freed in a loop rather than a million nested calls
+void destroy(Object* object)
+{
+    static bool destroying = false;
+    static std::vector<Object*>& pending = *new std::vector<Object*>(); // never freed, statics may release objects at exit
+
+    if (destroying)
+    {
+        pending.push_back(object);
+        return;
+    }
+
+    destroying = true;
+    delete object;
+
+    while (!pending.empty())
+    {
+        Object* next = pending.back();
+        pending.pop_back();
+        delete next;
+    }
+
+    destroying = false;
+}
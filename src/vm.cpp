@@ -0,0 +1,712 @@
+//------------------------------------//
+// Copyright 2024 Nam Nguyen
+// Licensed under Apache License v2.0
+//------------------------------------//
+
+#include "vm.hpp"
+#include "compiler.hpp"
+#include "interpreter.hpp"
+
+std::string VmClosure::to_string()
+{
+    return function->name != "" ? "<func " + function->name + ">" : "<func lambda>";
+}
+
+VM::VM(Interpreter& interpreter)
+    : interpreter(interpreter)
+{
+    for (const NativeDef& native : natives())
+        define_global(global_slot(native.name), new NblNative(native));
+
+    stack.reserve(1024);
+}
+
+void VM::interpret(const std::vector<std::shared_ptr<Stmt>>& statements)
+{
+    Compiler compiler;
+    Ref<VmFunction> script = compiler.compile_script(statements);
+
+    if (Error::has_error) // compile error
+        return;
+
+    try
+    {
+        execute_script(script);
+    }
+    catch (const RuntimeError& error)
+    {
+        Error::runtime_error(error);
+        reset();
+    }
+}
+
+std::string VM::interpret(const std::shared_ptr<Expr>& expr)
+{
+    Compiler compiler;
+    Ref<VmFunction> script = compiler.compile_expression(expr);
+
+    if (Error::has_error)
+        return "";
+
+    try
+    {
+        return stringify(execute_script(script));
+    }
+    catch (const RuntimeError& error)
+    {
+        Error::runtime_error(error);
+        reset();
+        return "";
+    }
+}
+
+Value VM::execute_script(Ref<VmFunction> script)
+{
+    Ref<VmClosure> closure = new VmClosure(std::move(script));
+
+    // scripts can be nested through imports, run until this one returns
+    size_t frame_floor = frames.size();
+    stack.push_back(closure);
+    call(closure, 0);
+    run(frame_floor);
+
+    Value result = std::move(stack.back());
+    stack.pop_back();
+    return result;
+}
+
+void VM::reset()
+{
+    stack.clear();
+    frames.clear();
+    open_upvalues.clear();
+}
+
+// a token on the line of the instruction being run, what errors and natives report at
+const Token& VM::current_token()
+{
+    CallFrame& frame = frames.back();
+    const Chunk& chunk = frame.closure->function->chunk;
+
+    error_token.line = chunk.lines[frame.ip - chunk.code.data() - 1];
+    return error_token;
+}
+
+void VM::runtime_error(const std::string& msg)
+{
+    throw RuntimeError(current_token(), msg);
+}
+
+
+#define READ_BYTE() (*frame->ip++)
+#define READ_SHORT() (frame->ip += 2, static_cast<uint16_t>((frame->ip[-2] << 8) | frame->ip[-1]))
+#define READ_CONSTANT() (frame->closure->function->chunk.constants[READ_SHORT()])
+#define READ_STRING() (READ_CONSTANT().as_string())
+
+// pops both operands and pushes the result of a numeric operator, one of the num_ functions
+#define NUMERIC_OP(operation) \
+    do \
+    { \
+        Value& a = stack[stack.size() - 2]; \
+        Value& b = stack.back(); \
+        if (!a.is_number() || !b.is_number()) \
+            runtime_error("Operands must be numbers"); \
+        Value result = operation(a, b); \
+        stack.pop_back(); \
+        stack.back() = std::move(result); \
+    } while (false)
+
+// like NUMERIC_OP, but anything other than two numbers gives nil, as Interpreter::binary_operation does for - * / %
+#define ARITHMETIC_OP(operation) \
+    do \
+    { \
+        Value& a = stack[stack.size() - 2]; \
+        Value& b = stack.back(); \
+        Value result = a.is_number() && b.is_number() ? operation(a, b) : Value(); \
+        stack.pop_back(); \
+        stack.back() = std::move(result); \
+    } while (false)
+
+void VM::run(size_t frame_floor)
+{
+    CallFrame* frame = &frames.back();
+
+    while (true)
+    {
+        uint8_t instruction = READ_BYTE();
+
+        switch (instruction)
+        {
+            case OP_CONSTANT:
+                stack.push_back(READ_CONSTANT());
+                break;
+
+            case OP_NIL: stack.push_back(nullptr); break;
+            case OP_TRUE: stack.push_back(true); break;
+            case OP_FALSE: stack.push_back(false); break;
+            case OP_POP: stack.pop_back(); break;
+
+            case OP_GET_LOCAL:
+                stack.push_back(stack[frame->base + READ_BYTE()]);
+                break;
+
+            case OP_SET_LOCAL:
+                stack[frame->base + READ_BYTE()] = stack.back();
+                break;
+
+            case OP_GET_GLOBAL:
+            {
+                uint16_t slot = READ_SHORT();
+
+                if (slot >= globals.size() || !globals[slot].defined)
+                    runtime_error("Undefined variable: '" + global_name(slot) + "'");
+
+                stack.push_back(globals[slot].value);
+                break;
+            }
+
+            case OP_DEFINE_GLOBAL:
+                define_global(READ_SHORT(), std::move(stack.back()));
+                stack.pop_back();
+                break;
+
+            case OP_SET_GLOBAL:
+            {
+                uint16_t slot = READ_SHORT();
+
+                if (slot >= globals.size() || !globals[slot].defined)
+                    runtime_error("Undefined variable: '" + global_name(slot) + "'");
+
+                globals[slot].value = stack.back();
+                break;
+            }
+
+            case OP_GET_UPVALUE:
+                stack.push_back(upvalue_value(*frame->closure->upvalues[READ_BYTE()]));
+                break;
+
+            case OP_SET_UPVALUE:
+                upvalue_value(*frame->closure->upvalues[READ_BYTE()]) = stack.back();
+                break;
+
+            case OP_GET_PROPERTY:
+            {
+                const std::string& name = READ_STRING();
+
+                if (!stack.back().is_object(ObjectType::VM_INSTANCE))
+                    runtime_error("Only instances have properties");
+
+                VmInstance* instance = stack.back().as<VmInstance>();
+                auto element = instance->fields.find(name);
+
+                if (element != instance->fields.end())
+                {
+                    stack.back() = element->second;
+                    break;
+                }
+
+                bind_method(instance->klass.get(), name);
+                break;
+            }
+
+            case OP_SET_PROPERTY:
+            {
+                const std::string& name = READ_STRING();
+                Value& object = stack[stack.size() - 2];
+
+                if (!object.is_object(ObjectType::VM_INSTANCE))
+                    runtime_error("Only instances have fields");
+
+                object.as<VmInstance>()->fields[name] = stack.back();
+                object = std::move(stack.back());
+                stack.pop_back();
+                break;
+            }
+
+            case OP_GET_SUPER:
+            {
+                const std::string& name = READ_STRING();
+                Value superclass = std::move(stack.back());
+                stack.pop_back();
+                bind_method(superclass.as<VmClass>(), name);
+                break;
+            }
+
+            case OP_GET_SUBSCRIPT:
+            {
+                Value& name = stack[stack.size() - 2];
+                Value& index = stack.back();
+
+                if (!name.is_object(ObjectType::LIST))
+                    runtime_error("Only lists can be subscripted");
+                if (!index.is_number())
+                    runtime_error("Index should be of type int");
+
+                Ref<ListType> list = name.as<ListType>();
+                int casted_index = num_index(index);
+                stack.pop_back();
+
+                if (casted_index >= list->get_length() || casted_index < 0)
+                    stack.back() = nullptr;
+                else
+                    stack.back() = list->get_element_at(casted_index);
+                break;
+            }
+
+            case OP_SET_SUBSCRIPT:
+            {
+                Value& name = stack[stack.size() - 3];
+                Value& index = stack[stack.size() - 2];
+
+                if (!name.is_object(ObjectType::LIST))
+                    runtime_error("Only lists can be subscripted");
+                if (!index.is_number())
+                    runtime_error("Index should be of type int");
+
+                if (!name.as<ListType>()->set_element_at(num_index(index), stack.back()))
+                    runtime_error("Index out of range");
+
+                name = std::move(stack.back());
+                stack.resize(stack.size() - 2);
+                break;
+            }
+
+            case OP_EQUAL:
+            {
+                bool equal = interpreter.is_equal(stack[stack.size() - 2], stack.back());
+                stack.pop_back();
+                stack.back() = equal;
+                break;
+            }
+
+            case OP_NOT_EQUAL:
+            {
+                bool equal = interpreter.is_equal(stack[stack.size() - 2], stack.back());
+                stack.pop_back();
+                stack.back() = !equal;
+                break;
+            }
+
+            case OP_GREATER: NUMERIC_OP(num_greater); break;
+            case OP_GREATER_EQUAL: NUMERIC_OP(num_greater_equal); break;
+            case OP_LESS: NUMERIC_OP(num_less); break;
+            case OP_LESS_EQUAL: NUMERIC_OP(num_less_equal); break;
+            case OP_SUBTRACT: ARITHMETIC_OP(num_subtract); break;
+            case OP_MULTIPLY: ARITHMETIC_OP(num_multiply); break;
+            case OP_DIVIDE: ARITHMETIC_OP(num_divide); break;
+            case OP_MODULO: ARITHMETIC_OP(num_modulo); break;
+            case OP_POWER: NUMERIC_OP(num_power); break;
+
+            case OP_ADD:
+            {
+                Value& a = stack[stack.size() - 2];
+                Value& b = stack.back();
+                Value result;
+
+                if (a.is_number() && b.is_number())
+                    result = num_add(a, b);
+                else if (a.is_string() && b.is_string())
+                    result = a.as_string() + b.as_string();
+                else if (a.is_string() && b.is_number())
+                    result = a.as_string() + interpreter.stringify(b);
+                else if (a.is_number() && b.is_string())
+                    result = interpreter.stringify(a) + b.as_string();
+                else
+                    runtime_error("Operands must be 2 numbers, 2 strings, or 1 number and 1 string");
+
+                stack.pop_back();
+                stack.back() = std::move(result);
+                break;
+            }
+
+            case OP_NOT:
+                stack.back() = !interpreter.is_truthy(stack.back());
+                break;
+
+            case OP_SQUARE:
+                if (!stack.back().is_number())
+                    runtime_error("Operands must be numbers");
+
+                stack.back() = num_multiply(stack.back(), stack.back());
+                break;
+
+            case OP_NEGATE:
+                if (!stack.back().is_number())
+                    runtime_error("Operand must be a number");
+
+                stack.back() = num_negate(stack.back());
+                break;
+
+            case OP_PRINT:
+                std::cout << stringify(stack.back()) + "\n";
+                stack.pop_back();
+                break;
+
+            case OP_JUMP:
+            {
+                uint16_t offset = READ_SHORT();
+                frame->ip += offset;
+                break;
+            }
+
+            case OP_JUMP_IF_FALSE:
+            {
+                uint16_t offset = READ_SHORT();
+                if (!interpreter.is_truthy(stack.back()))
+                    frame->ip += offset;
+                break;
+            }
+
+            case OP_LOOP:
+            {
+                uint16_t offset = READ_SHORT();
+                frame->ip -= offset;
+                break;
+            }
+
+            case OP_CALL:
+            {
+                int arg_count = READ_BYTE();
+                call_value(stack[stack.size() - arg_count - 1], arg_count);
+                frame = &frames.back();
+                break;
+            }
+
+            // a builtin runs on the stack without a call, unless its global now holds something else
+            case OP_INTRINSIC:
+            {
+                Intrinsic intrinsic = static_cast<Intrinsic>(READ_BYTE());
+                int arg_count = READ_BYTE();
+                size_t callee_slot = stack.size() - arg_count - 1;
+
+                if (is_intrinsic(stack[callee_slot], intrinsic))
+                {
+                    stack[callee_slot] = run_intrinsic(intrinsic, current_token(), std::span<Value>(stack.data() + callee_slot + 1, arg_count));
+                    stack.resize(callee_slot + 1);
+                }
+                else
+                {
+                    call_value(stack[callee_slot], arg_count);
+                    frame = &frames.back();
+                }
+
+                break;
+            }
+
+            case OP_TAIL_CALL:
+            {
+                int arg_count = READ_BYTE();
+                size_t callee_slot = stack.size() - arg_count - 1;
+                Value& callee = stack[callee_slot];
+
+                // a closure takes over the frame of the function returning its result, anything else is an OP_CALL
+                if (callee.is_object(ObjectType::VM_CLOSURE) && callee.as<VmClosure>()->function->arity == arg_count)
+                {
+                    size_t base = frame->base;
+                    Ref<VmClosure> closure = callee.as<VmClosure>();
+
+                    close_upvalues(base);
+                    std::move(stack.begin() + callee_slot, stack.end(), stack.begin() + base);
+                    stack.resize(base + arg_count + 1);
+                    frames.pop_back();
+                    call(std::move(closure), arg_count);
+                }
+                else
+                {
+                    call_value(callee, arg_count);
+                }
+
+                frame = &frames.back();
+                break;
+            }
+
+            case OP_INVOKE:
+            {
+                const std::string& name = READ_STRING();
+                int arg_count = READ_BYTE();
+                invoke(name, arg_count);
+                frame = &frames.back();
+                break;
+            }
+
+            case OP_CLOSURE:
+            {
+                Ref<VmClosure> closure = new VmClosure(READ_CONSTANT().as<VmFunction>());
+
+                for (int i = 0; i < closure->function->upvalue_count; i++)
+                {
+                    uint8_t is_local = READ_BYTE();
+                    uint8_t index = READ_BYTE();
+
+                    if (is_local)
+                        closure->upvalues.push_back(capture_upvalue(frame->base + index));
+                    else
+                        closure->upvalues.push_back(frame->closure->upvalues[index]);
+                }
+
+                stack.push_back(std::move(closure));
+                break;
+            }
+
+            case OP_CLOSE_UPVALUE:
+                close_upvalues(stack.size() - 1);
+                stack.pop_back();
+                break;
+
+            case OP_RETURN:
+            {
+                Value result = std::move(stack.back());
+                size_t base = frame->base;
+
+                close_upvalues(base);
+                frames.pop_back();
+                stack.resize(base);
+                stack.push_back(std::move(result));
+
+                if (frames.size() == frame_floor)
+                    return;
+
+                frame = &frames.back();
+                break;
+            }
+
+            case OP_CLASS:
+            {
+                stack.push_back(new VmClass(READ_STRING()));
+                break;
+            }
+
+            case OP_INHERIT:
+            {
+                Value& superclass = stack[stack.size() - 2];
+
+                if (!superclass.is_object(ObjectType::VM_CLASS))
+                    runtime_error("Superclass must be a class");
+
+                stack.back().as<VmClass>()->methods = superclass.as<VmClass>()->methods;
+                stack.pop_back();
+                break;
+            }
+
+            case OP_METHOD:
+            {
+                const std::string& name = READ_STRING();
+                stack[stack.size() - 2].as<VmClass>()->methods[name] = stack.back().as<VmClosure>();
+                stack.pop_back();
+                break;
+            }
+
+            case OP_LIST:
+            {
+                int count = READ_BYTE();
+                Ref<ListType> list = new ListType();
+
+                for (size_t i = stack.size() - count; i < stack.size(); i++)
+                    list->append(std::move(stack[i]));
+
+                stack.resize(stack.size() - count);
+                stack.push_back(std::move(list));
+                break;
+            }
+
+            case OP_IMPORT:
+            {
+                std::string target = READ_STRING();
+                run_file(target, interpreter); // re-enters interpret() with the imported statements
+                frame = &frames.back();
+                break;
+            }
+        }
+    }
+}
+
+#undef READ_BYTE
+#undef READ_SHORT
+#undef READ_CONSTANT
+#undef READ_STRING
+#undef NUMERIC_OP
+#undef ARITHMETIC_OP
+
+void VM::call_value(Value callee, int arg_count)
+{
+    size_t callee_slot = stack.size() - arg_count - 1;
+
+    if (!callee.is_object())
+        runtime_error("Can only call functions");
+
+    switch (callee.as_object()->type)
+    {
+        case ObjectType::VM_CLOSURE:
+            call(callee.as<VmClosure>(), arg_count);
+            return;
+
+        case ObjectType::VM_BOUND_METHOD:
+        {
+            VmBoundMethod* bound = callee.as<VmBoundMethod>();
+            stack[callee_slot] = bound->receiver;
+            call(bound->method, arg_count);
+            return;
+        }
+
+        case ObjectType::VM_CLASS:
+        {
+            VmClass* klass = callee.as<VmClass>();
+            stack[callee_slot] = new VmInstance(klass);
+
+            auto initializer = klass->methods.find("init");
+            if (initializer != klass->methods.end())
+                call(initializer->second, arg_count);
+            else if (arg_count != 0)
+                runtime_error("Expected 0 arguments but got " + std::to_string(arg_count));
+
+            return;
+        }
+
+        case ObjectType::NATIVE:
+        {
+            NblCallable* native = callee.as<NblCallable>();
+
+            if (!native->accepts(arg_count))
+                runtime_error(native->arity_error(arg_count));
+
+            Value result = native->call(interpreter, current_token(), std::span<Value>(stack.data() + callee_slot + 1, arg_count));
+
+            stack.resize(callee_slot);
+            stack.push_back(std::move(result));
+            return;
+        }
+
+        default:
+            runtime_error("Can only call functions");
+    }
+}
+
+void VM::call(Ref<VmClosure> closure, int arg_count)
+{
+    if (arg_count != closure->function->arity)
+        runtime_error("Expected " + std::to_string(closure->function->arity) + " arguments but got " + std::to_string(arg_count));
+
+    if (frames.size() > interpreter.max_stack) // the script itself has a frame too
+        runtime_error("Stack overflow");
+
+    const uint8_t* ip = closure->function->chunk.code.data();
+    frames.push_back(CallFrame{std::move(closure), ip, stack.size() - arg_count - 1});
+}
+
+std::shared_ptr<VmUpvalue> VM::capture_upvalue(size_t slot)
+{
+    auto element = open_upvalues.find(slot);
+
+    if (element != open_upvalues.end())
+        return element->second;
+
+    auto upvalue = std::make_shared<VmUpvalue>();
+    upvalue->slot = slot;
+    open_upvalues[slot] = upvalue;
+
+    return upvalue;
+}
+
+void VM::define_global(size_t slot, Value value)
+{
+    if (slot >= globals.size())
+        globals.resize(slot + 1);
+
+    globals[slot] = {std::move(value), true};
+}
+
+void VM::close_upvalues(size_t last)
+{
+    auto element = open_upvalues.lower_bound(last);
+
+    while (element != open_upvalues.end())
+    {
+        VmUpvalue& upvalue = *element->second;
+        upvalue.closed = stack[upvalue.slot];
+        upvalue.is_open = false;
+        element = open_upvalues.erase(element);
+    }
+}
+
+Value& VM::upvalue_value(VmUpvalue& upvalue)
+{
+    return upvalue.is_open ? stack[upvalue.slot] : upvalue.closed;
+}
+
+// the receiver stays in the callee's slot and becomes the method's slot 0, a field is called like any value
+void VM::invoke(const std::string& name, int arg_count)
+{
+    Value& receiver = stack[stack.size() - arg_count - 1];
+
+    if (!receiver.is_object(ObjectType::VM_INSTANCE))
+        runtime_error("Only instances have properties");
+
+    VmInstance* instance = receiver.as<VmInstance>();
+    auto field = instance->fields.find(name);
+
+    if (field != instance->fields.end())
+    {
+        Value callee = field->second;
+        receiver = callee;
+        call_value(std::move(callee), arg_count);
+        return;
+    }
+
+    auto method = instance->klass->methods.find(name);
+
+    if (method == instance->klass->methods.end())
+        runtime_error("Undefined property '" + name + "'");
+
+    call(method->second, arg_count);
+}
+
+void VM::bind_method(VmClass* klass, const std::string& name)
+{
+    auto method = klass->methods.find(name);
+
+    if (method == klass->methods.end())
+        runtime_error("Undefined property '" + name + "'");
+
+    stack.back() = new VmBoundMethod(stack.back(), method->second);
+}
+
+std::string VM::stringify(const Value& value)
+{
+    if (!value.is_object())
+        return interpreter.stringify(value);
+
+    switch (value.as_object()->type)
+    {
+        case ObjectType::VM_CLOSURE:
+            return value.as<VmClosure>()->to_string();
+
+        case ObjectType::VM_BOUND_METHOD:
+            return value.as<VmBoundMethod>()->method->to_string();
+
+        case ObjectType::VM_CLASS:
+            return value.as<VmClass>()->name;
+
+        case ObjectType::VM_INSTANCE:
+            return value.as<VmInstance>()->klass->name + " instance";
+
+        case ObjectType::LIST:
+        {
+            std::string result = "[";
+            std::vector<Value>& elements = value.as<ListType>()->elements;
+
+            for (auto i = elements.begin(); i != elements.end(); i++)
+            {
+                result.append(stringify(*i));
+
+                if (i + 1 != elements.end())
+                    result.append(", ");
+            }
+
+            result.append("]");
+            return result;
+        }
+
+        default:
+            return interpreter.stringify(value);
+    }
+}
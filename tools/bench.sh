@@ -5,6 +5,7 @@
 # Licensed under Apache License v2.0
 #------------------------------------#
 
+# any arguments are passed on to the interpreter, e.g. ./tools/bench.sh --engine=vm
 declare -A elapsed_times # associative array
 
 NBL_FILES=$(find benchmark -name '*.nbl')
@@ -13,7 +14,7 @@ for program in $NBL_FILES; do
     echo "Running benchmark: $program"
 
     # run and capture output
-    output=$(./bin/nimble "$program")
+    output=$(./bin/nimble "$@" "$program")
     
     # extract elapsed time
     elapsed_time=$(echo "$output" | grep 'Elapsed:' | awk '{print $2}')
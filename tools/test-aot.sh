@@ -0,0 +1,46 @@
+#!/bin/bash
+
+#------------------------------------#
+# Copyright 2024 Nam Nguyen
+# Licensed under Apache License v2.0
+#------------------------------------#
+
+# runs every test case compiled with --emit-c instead of interpreted, needs bin/libnimble.a
+failed=0; # number of failed cases
+build=$(mktemp -d);
+
+NBL_FILES=$(find tests -name '*.nbl');
+
+for nbl in $NBL_FILES; do
+    expected=${nbl}.expected;
+    program=$build/$(echo $nbl | tr / _);
+
+    echo "Compiling test case $nbl...";
+    if ! ./bin/nimble --emit-c $nbl > $program.cpp; then
+        # a syntax or resolution error, the compiler reports it the way the interpreter does
+        output=$program.cpp;
+    elif g++ -std=c++20 -Iinclude $program.cpp bin/libnimble.a -pthread -o $program; then
+        output=$program.out;
+        $program > $output;
+    else
+        echo "Test case $nbl didn't compile!";
+        failed=$((failed + 1));
+        continue;
+    fi;
+
+    if ! diff -u --color "$expected" $output; then
+        echo "Test case $nbl failed!";
+        failed=$((failed + 1));
+    fi;
+done;
+
+rm -rf $build;
+
+if [ $failed -eq 0 ]; then
+    echo;
+    echo "All test cases passed --emit-c";
+else
+    echo "Total failed test cases: $failed";
+fi;
+
+exit $failed
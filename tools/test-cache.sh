@@ -0,0 +1,32 @@
+#!/bin/bash
+
+#------------------------------------#
+# Copyright 2024 Nam Nguyen
+# Licensed under Apache License v2.0
+#------------------------------------#
+
+# runs the inline cache test cases with --cache-stats and checks the counts printed to stderr,
+# any arguments are passed on to the interpreter, e.g. ./tools/test-cache.sh --engine=closure
+failed=0; # number of failed cases
+
+NBL_FILES=$(find tests/cache -name '*.nbl');
+
+for nbl in $NBL_FILES; do
+    # get expected counts
+    expected=${nbl}.stats;
+
+    echo "Checking cache stats of $nbl...";
+    if ! ./bin/nimble --cache-stats "$@" $nbl 2>&1 >/dev/null | diff -u --color "$expected" -; then
+        echo "Cache stats of $nbl differ!";
+        failed=$((failed + 1)); # count failed cases
+    fi;
+done;
+
+if [ $failed -eq 0 ]; then
+    echo;
+    echo "All cache stats matched $*";
+else
+    echo "Total failed cache stats: $failed";
+fi;
+
+exit $failed
@@ -0,0 +1,32 @@
+#!/bin/bash
+
+#------------------------------------#
+# Copyright 2024 Nam Nguyen
+# Licensed under Apache License v2.0
+#------------------------------------#
+
+# runs the optimizer test cases with --print-ast-after-opt and checks the AST printed to stderr,
+# any arguments are passed on to the interpreter, e.g. ./tools/test-optimizer.sh -O1
+failed=0; # number of failed cases
+
+NBL_FILES=$(find tests/optimizer -name '*.nbl');
+
+for nbl in $NBL_FILES; do
+    # get expected AST
+    expected=${nbl}.ast;
+
+    echo "Checking optimized AST of $nbl...";
+    if ! ./bin/nimble --print-ast-after-opt "$@" $nbl 2>&1 >/dev/null | diff -u --color "$expected" -; then
+        echo "Optimized AST of $nbl differs!";
+        failed=$((failed + 1)); # count failed cases
+    fi;
+done;
+
+if [ $failed -eq 0 ]; then
+    echo;
+    echo "All optimized ASTs matched $*";
+else
+    echo "Total failed optimized ASTs: $failed";
+fi;
+
+exit $failed
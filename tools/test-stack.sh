@@ -0,0 +1,50 @@
+#!/bin/bash
+
+#------------------------------------#
+# Copyright 2024 Nam Nguyen
+# Licensed under Apache License v2.0
+#------------------------------------#
+
+# runs the stack test cases with a small --max-stack, their output has to end in a "Stack overflow"
+# error, any arguments are passed on to the interpreter, e.g. ./tools/test-stack.sh --engine=vm
+# with --emit-c each case is compiled with the limit instead and the program is run, needs bin/libnimble.a
+failed=0; # number of failed cases
+build=$(mktemp -d);
+
+NBL_FILES=$(find tests/stack -name '*.nbl');
+
+for nbl in $NBL_FILES; do
+    # get expected output with the small limit
+    expected=${nbl}.overflow;
+
+    echo "Running test case $nbl with --max-stack=100...";
+    if [ "$1" = "--emit-c" ]; then
+        program=$build/$(echo $nbl | tr / _);
+
+        if ! ./bin/nimble --max-stack=100 --emit-c $nbl > $program.cpp || ! g++ -std=c++20 -Iinclude $program.cpp bin/libnimble.a -pthread -o $program; then
+            echo "Test case $nbl didn't compile!";
+            failed=$((failed + 1));
+            continue;
+        fi;
+
+        run=$program;
+    else
+        run="./bin/nimble --max-stack=100 $* $nbl";
+    fi;
+
+    if ! $run | diff -u --color "$expected" -; then
+        echo "Test case $nbl failed with --max-stack=100!";
+        failed=$((failed + 1)); # count failed cases
+    fi;
+done;
+
+rm -rf $build;
+
+if [ $failed -eq 0 ]; then
+    echo;
+    echo "All stack test cases passed $*";
+else
+    echo "Total failed stack test cases: $failed";
+fi;
+
+exit $failed
@@ -5,6 +5,7 @@
 # Licensed under Apache License v2.0
 #------------------------------------#
 
+# any arguments are passed on to the interpreter, e.g. ./tools/test.sh --engine=vm
 failed=0; # number of failed cases
 
 NBL_FILES=$(find tests -name '*.nbl');
@@ -15,7 +16,7 @@ for nbl in $NBL_FILES; do
 
     # run and get difference between output and expected output
     echo "Running test case $nbl...";
-    if ! ./bin/nimble $nbl | diff -u --color "$expected" -; then
+    if ! ./bin/nimble "$@" $nbl | diff -u --color "$expected" -; then
         echo "Test case $nbl failed!";
         failed=$((failed + 1)); # count failed cases
     fi;
@@ -23,7 +24,7 @@ done;
 
 if [ $failed -eq 0 ]; then
     echo;
-    echo "All test cases passed";
+    echo "All test cases passed $*";
 else
     echo "Total failed test cases: $failed";
 fi;